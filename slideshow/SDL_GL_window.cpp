@@ -32,16 +32,38 @@ GLuint create_program() {
     )";
 
     // Fragment shader
+    // Each slot holds either packed RGB, a single luminance plane (grayscale jpg) or Y/Cb/Cr planes (YUV decode). 
+    // Images come either bottom-up (packed RGB, as GL expects) or top-down (planar data, V4L2 frames), uFlip turns the latter.
     const char* fragment_shader_src = R"(
         precision mediump float;
         varying vec2 vTexCoord;
         uniform sampler2D uTexture0;
         uniform sampler2D uTexture1;
+        uniform sampler2D uTextureCb0;
+        uniform sampler2D uTextureCb1;
+        uniform sampler2D uTextureCr0;
+        uniform sampler2D uTextureCr1;
+        uniform float uPlanes0; // 0.0 -> RGB, 1.0 -> luminance, 3.0 -> YCbCr
+        uniform float uPlanes1;
+        uniform float uFlip0; // 1.0 -> top-down image
+        uniform float uFlip1;
         uniform float uFade; // 0.0 -> only texture0, 1.0 -> only texture1
 
+        vec4 sample_slot(sampler2D tex, sampler2D cb, sampler2D cr, float planes, float flip) {
+            vec2 tc = vec2(vTexCoord.x, mix(vTexCoord.y, 1.0 - vTexCoord.y, flip));
+            if (planes < 0.5) return texture2D(tex, tc);
+
+            float y = texture2D(tex, tc).r;
+            if (planes < 1.5) return vec4(y, y, y, 1.0);
+
+            float u = texture2D(cb, tc).r - 0.5;
+            float v = texture2D(cr, tc).r - 0.5;
+            return vec4(y + 1.402 * v, y - 0.344136 * u - 0.714136 * v, y + 1.772 * u, 1.0); // JFIF full range
+        }
+
         void main() {
-            vec4 color1 = texture2D(uTexture0, vTexCoord);
-            vec4 color2 = texture2D(uTexture1, vTexCoord);
+            vec4 color1 = sample_slot(uTexture0, uTextureCb0, uTextureCr0, uPlanes0, uFlip0);
+            vec4 color2 = sample_slot(uTexture1, uTextureCb1, uTextureCr1, uPlanes1, uFlip1);
             gl_FragColor = mix(color1, color2, uFade);
         }
     )";
@@ -80,7 +102,13 @@ GLuint create_program() {
     return program;
 }
 
-GLuint create_texture(int w, int h) {
+#ifdef USE_RGB565
+    #define TEXTURE_PIXEL_TYPE GL_UNSIGNED_SHORT_5_6_5 // ImageLoader converts every frame to this, at the display size
+#else
+    #define TEXTURE_PIXEL_TYPE GL_UNSIGNED_BYTE
+#endif
+
+GLuint create_texture(int w, int h, GLenum type) {
     GLuint tex;
     glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
@@ -88,7 +116,7 @@ GLuint create_texture(int w, int h) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Allocate empty texture initially 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, type, nullptr);
 
     glBindTexture(GL_TEXTURE_2D, 0);
     return tex;
@@ -113,6 +141,7 @@ SDL_GL_window::SDL_GL_window() {
                         if (!first) oss << ",";
                         oss << ":" << pathStr;
                         first = false;
+                        input_devices.push_back(pathStr);
 #ifdef DEBUG
                         SDL_Log("Found input device: %s", pathStr.c_str());
 #endif
@@ -209,15 +238,30 @@ SDL_GL_window::SDL_GL_window() {
     glClearColor(0.0f, 0.0f, 0.0f, 1.00f);
 
     glActiveTexture(GL_TEXTURE0);
-    GLuint tex0 = create_texture(display_w, display_h);
+    GLuint tex0 = create_texture(display_w, display_h, TEXTURE_PIXEL_TYPE);
     glBindTexture(GL_TEXTURE_2D, tex0);
     glUniform1i(glGetUniformLocation(shaderProgram, "uTexture0"), 0); //set uniform uTexture0 to use texture unit 0, which has tex0 bound
 
     glActiveTexture(GL_TEXTURE1);
-    GLuint tex1 = create_texture(display_w, display_h);
+    GLuint tex1 = create_texture(display_w, display_h, TEXTURE_PIXEL_TYPE);
     glBindTexture(GL_TEXTURE_2D, tex1);
     glUniform1i(glGetUniformLocation(shaderProgram, "uTexture1"), 1); //set uniform uTexture1 to use texture unit 1, which has tex1 bound
 
+    // chroma planes for YUV decoded images, tex0 uses units 2 and 4, tex1 uses 3 and 5. 
+    // Sized on upload, until then they are never sampled.
+    const char* chroma_samplers[] = { "uTextureCb0", "uTextureCb1", "uTextureCr0", "uTextureCr1" };
+    for (int i = 0; i < 4; i++) {
+        glActiveTexture(GL_TEXTURE2 + i);
+        GLuint tex = create_texture(1, 1, GL_UNSIGNED_BYTE);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glUniform1i(glGetUniformLocation(shaderProgram, chroma_samplers[i]), 2 + i);
+    }
+
+    glUniform1f(glGetUniformLocation(shaderProgram, "uPlanes0"), 0.0f);
+    glUniform1f(glGetUniformLocation(shaderProgram, "uPlanes1"), 0.0f);
+    glUniform1f(glGetUniformLocation(shaderProgram, "uFlip0"), 0.0f);
+    glUniform1f(glGetUniformLocation(shaderProgram, "uFlip1"), 0.0f);
+
     uFade = glGetUniformLocation(shaderProgram, "uFade");
 }
 
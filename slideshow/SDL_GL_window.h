@@ -3,6 +3,9 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_opengles2.h>
 
+#include <string>
+#include <vector>
+
 
 class SDL_GL_window {
 public:
@@ -11,6 +14,10 @@ public:
 
     void render(float fade_amount);
     SDL_WindowID get_ID();
+    int get_display_width() { return display_w; }
+    int get_display_height() { return display_h; }
+    // the evdev devices SDL reads keys from
+    const std::vector<std::string> &get_input_devices() { return input_devices; }
 
 private:
     SDL_Window* window;
@@ -18,5 +25,6 @@ private:
     SDL_WindowID ID;
 
     int display_w, display_h;
+    std::vector<std::string> input_devices;
     GLint uFade;
 };
\ No newline at end of file
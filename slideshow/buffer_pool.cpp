@@ -0,0 +1,80 @@
+#include "buffer_pool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdlib>
+
+#include <SDL3/SDL.h>
+
+
+BufferPool::BufferPool(size_t size, int count) : 
+    buffer_size((size + sysconf(_SC_PAGESIZE) - 1) / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE)), //round up to whole pages
+    num_buffers(count > 0 ? count : 0), in_use(num_buffers, false) 
+{
+    if (num_buffers == 0 || buffer_size == 0) return;
+
+    // pages are only backed once written, so sizing for the worst case costs address space, not RAM
+    void *mem = mmap(nullptr, buffer_size * num_buffers, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        SDL_Log("Failed to map %d buffers of %zu bytes, falling back to the heap", num_buffers, buffer_size);
+        return;
+    }
+    region = (unsigned char*)mem;
+}
+
+BufferPool::~BufferPool() {
+    if (region) munmap(region, buffer_size * num_buffers);
+}
+
+
+unsigned char *BufferPool::acquire(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (region && size <= buffer_size) {
+        for (int i = 0; i < num_buffers; i++) {
+            if (!in_use[i]) {
+                in_use[i] = true;
+                stats.pool_acquires++;
+                stats.buffers_in_use++;
+                return region + i * buffer_size;
+            }
+        }
+    }
+
+    stats.heap_allocations++;
+#ifdef DEBUG
+    SDL_Log("buffer pool: %zu bytes requested, falling back to the heap", size);
+#endif
+    return (unsigned char*)malloc(size);
+}
+
+
+void BufferPool::release(unsigned char *buf) {
+    if (!buf) return;
+
+    if (region && buf >= region && buf < region + buffer_size * num_buffers) {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_use[(buf - region) / buffer_size] = false;
+        stats.buffers_in_use--;
+        return;
+    }
+    free(buf);
+}
+
+
+BufferPoolStats BufferPool::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+
+FileBuffer::~FileBuffer() {
+    if (!data) return;
+
+    if (pool) {
+        pool->release(data);
+    } else {
+        madvise(data, size, MADV_DONTNEED); // done with it, no need to keep the pages mapped in
+        munmap(data, size);
+    }
+}
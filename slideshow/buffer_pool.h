@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+
+struct BufferPoolStats {
+    unsigned long pool_acquires = 0;
+    unsigned long heap_allocations = 0; // requests the pool could not serve, should stay at 0 in steady state
+    int buffers_in_use = 0;
+};
+
+
+// Fixed set of equally sized, page aligned buffers carved out of one anonymous mapping at startup.
+// Requests that are too big, or that come when every buffer is taken, fall back to the heap and are counted.
+// Thread safe: buffers are filled on the worker thread and released wherever the last user drops them.
+class BufferPool {
+public:
+    BufferPool(size_t buffer_size, int num_buffers);
+    ~BufferPool();
+
+    unsigned char *acquire(size_t size);
+    void release(unsigned char *buf);
+
+    size_t get_buffer_size() { return buffer_size; }
+    BufferPoolStats get_stats();
+
+private:
+    std::mutex mutex;
+    const size_t buffer_size;
+    const int num_buffers;
+    unsigned char *region = nullptr;
+    std::vector<bool> in_use;
+
+    BufferPoolStats stats;
+};
+
+
+// Compressed file contents: a read only mapping of the file, or a copy in a pool buffer (or on the heap)
+struct FileBuffer {
+    FileBuffer(BufferPool *owner) : pool(owner) {}
+    FileBuffer(const FileBuffer&) = delete;
+    FileBuffer& operator=(const FileBuffer&) = delete;
+    ~FileBuffer();
+
+    unsigned char *data = nullptr;
+    size_t size = 0;
+    BufferPool *pool;   // nullptr if data is a mapping
+};
@@ -0,0 +1,164 @@
+#include "decoder_registry.h"
+#include "load_image.h"
+#include "test_jpeg.h"
+
+#include <algorithm>
+
+#include <SDL3/SDL.h>
+
+
+#define BENCHMARK_RUNS 5
+
+
+// Leave img as it was before a failed attempt, so the next decoder starts clean
+static void reset_image(DecodedImage &img) {
+    img.pixeldata = nullptr;
+    img.pixeldata_len = 0;
+    img.width = img.height = 0;
+    img.type = GL_UNSIGNED_BYTE;
+    img.num_planes = 0;
+    for (int i = 0; i < 3; i++) img.plane_w[i] = img.plane_h[i] = 0;
+    img.top_down = false;
+    img.dmabuf_fd = -1;
+    img.dmabuf_offset = 0;
+    img.dmabuf_pitch = 0;
+}
+
+
+bool DecoderRegistry::select() {
+    std::vector<std::pair<float, std::unique_ptr<ImageDecoder>>> working;
+    benchmarks.clear();
+
+    for (auto &decoder : decoders) {
+        DecoderBenchmark bench;
+        bench.name = decoder->name();
+
+        if (!decoder->init()) {
+            SDL_Log("%s decoder is not available", decoder->name());
+            benchmarks.push_back(bench);
+            continue;
+        }
+
+        if (!decoder->accepts(TEST_JPEG, sizeof(TEST_JPEG))) { // nothing to time it on, but no other decoder takes its files
+            SDL_Log("%s decoder: not timed, it does not read jpgs", decoder->name());
+            bench.works = true;
+            benchmarks.push_back(bench);
+            working.emplace_back(0.0f, std::move(decoder));
+            continue;
+        }
+
+        // one run to warm up (first use allocations, hardware power up), then the timed ones
+        Uint64 start = 0;
+        bench.works = true;
+        for (int run = 0; run <= BENCHMARK_RUNS && bench.works; run++) {
+            if (run == 1) start = SDL_GetPerformanceCounter();
+
+            DecodedImage img;
+            bench.works = decoder->decode(img, TEST_JPEG, sizeof(TEST_JPEG), "embedded test jpg", 0, 0);
+            if (bench.works) img.decoder = decoder.get(); // frees it
+            bench.works = bench.works && img.pixeldata && img.width == TEST_JPEG_WIDTH && img.height == TEST_JPEG_HEIGHT;
+        }
+
+        if (!bench.works) {
+            SDL_Log("%s decoder failed on the test image", decoder->name());
+            benchmarks.push_back(bench);
+            continue;
+        }
+
+        const float seconds = (SDL_GetPerformanceCounter() - start) / 1000000000.0f; //nanoseconds to seconds
+        bench.mpixels_per_s = (float)TEST_JPEG_WIDTH * TEST_JPEG_HEIGHT * BENCHMARK_RUNS / 1000000.0f / std::max(seconds, 1e-9f);
+        SDL_Log("%s decoder: %.1f Mpixel/s", decoder->name(), bench.mpixels_per_s);
+
+        benchmarks.push_back(bench);
+        working.emplace_back(bench.mpixels_per_s, std::move(decoder));
+    }
+
+    std::stable_sort(working.begin(), working.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    decoders.clear();
+    for (auto &w : working) decoders.push_back(std::move(w.second));
+
+    if (decoders.empty()) {
+        SDL_Log("No working image decoder");
+        return false;
+    }
+
+    SDL_Log("Using the %s decoder, %.1f Mpixel/s", decoders[0]->name(), working[0].first);
+    return true;
+}
+
+
+bool DecoderRegistry::decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) {
+    ImageDecoder *failed = nullptr;
+    bool transient = true;
+    last_failure_transient = false;
+    for (size_t i = 0; i < decoders.size(); i++) {
+        ImageDecoder *decoder = decoders[i].get();
+        if (!decoder->accepts(filebuf, filebuf_len)) continue;
+        if (failed) SDL_Log("%s failed on %s, trying %s", failed->name(), path.c_str(), decoder->name());
+
+        decoder->transient_failure = false;
+        if (decoder->decode(img, filebuf, filebuf_len, path, target_w, target_h)) {
+            img.decoder = decoder;
+            img.format = decoder->pixel_format();
+            if (failed) SDL_Log("%s decoded %s", decoder->name(), path.c_str());
+            return true;
+        }
+
+        reset_image(img);
+        failed = decoder;
+        transient = transient && decoder->transient_failure;
+    }
+    if (!failed) SDL_Log("No decoder reads %s", path.c_str());
+    last_failure_transient = failed && transient;
+    return false;
+}
+
+
+bool DecoderRegistry::can_scale(const unsigned char *filebuf, size_t filebuf_len) {
+    for (auto &decoder : decoders) {
+        if (decoder->accepts(filebuf, filebuf_len)) return decoder->can_scale();
+    }
+    return false;
+}
+
+
+bool DecoderRegistry::is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) {
+    for (auto &decoder : decoders) {
+        if (decoder->accepts(filebuf, filebuf_len)) return decoder->is_accelerated(filebuf, filebuf_len, target_w, target_h);
+    }
+    return false;
+}
+
+
+bool DecoderRegistry::check_header(const unsigned char *filebuf, size_t filebuf_len) {
+    for (auto &decoder : decoders) {
+        if (decoder->accepts(filebuf, filebuf_len) && decoder->check_header(filebuf, filebuf_len)) return true;
+    }
+    return false;
+}
+
+
+bool jpeg_header_ok(const unsigned char *p, size_t len) {
+    if (!is_jpeg(p, len)) return false;
+    bool has_frame = false;
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (p[pos] != 0xFF) { pos++; continue; } // garbage between segments, libjpeg skips it too
+        const unsigned char marker = p[pos + 1];
+        if (marker == 0xFF) { pos++; continue; } // fill byte
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) { pos += 2; continue; } // markers without a segment
+
+        const size_t segment = (p[pos + 2] << 8) | p[pos + 3];
+        if (segment < 2 || segment > len - pos - 2) return false; // cut short
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) { // SOFn
+            if (segment < 8) return false;
+            const int height = (p[pos + 5] << 8) | p[pos + 6], width = (p[pos + 7] << 8) | p[pos + 8];
+            if (width == 0 || height == 0) return false;
+            has_frame = true;
+        }
+        if (marker == 0xDA) return has_frame && pos + 2 + segment < len; // SOS, entropy coded data follows
+        if (marker == 0xD9) return false; // EOI before any scan
+        pos += 2 + segment;
+    }
+    return false;
+}
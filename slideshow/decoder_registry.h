@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include <SDL3/SDL_opengles2.h>
+
+
+struct DecodedImage;
+
+
+// One decoding backend (turbojpeg, stb, MMAL, V4L2, QOI). Several can be compiled in, see DecoderRegistry.
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() {}
+
+    virtual const char *name() = 0;
+    virtual bool init() = 0;
+
+    // Whether filebuf looks like a format this decoder reads, from its magic bytes. Others are not even tried on it.
+    virtual bool accepts(const unsigned char *filebuf, size_t filebuf_len) { return true; }
+
+    // Whether the headers of a file it accepts look readable, without decoding anything. false means decode() would fail.
+    virtual bool check_header(const unsigned char *filebuf, size_t filebuf_len) { return true; }
+
+    // Fill pixeldata, pixeldata_len, size and plane layout of img. target_w x target_h is a hint:
+    // decoders that can scale return the smallest size that still covers it, 0 means full size.
+    // Must not leave anything allocated on failure.
+    virtual bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) = 0;
+    virtual bool can_scale() { return false; } // honours target_w x target_h, so a small target decodes quicker
+    // decode() of filebuf runs on several cores or in hardware: quicker than libjpeg on one core, see USE_PREEMPTIBLE_DECODE
+    virtual bool is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) { return false; }
+    virtual void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) = 0;
+
+    virtual GLenum pixel_format() = 0; // of packed (num_planes == 0) images
+
+    // Set by decode() when it fails for a reason that is not the file's: out of memory, a device that does not answer.
+    // Such a file is tried again later instead of being quarantined. DecoderRegistry clears it before each decode().
+    bool transient_failure = false;
+};
+
+
+// SOI marker, for decoders that only read jpgs
+inline bool is_jpeg(const unsigned char *filebuf, size_t filebuf_len) {
+    return filebuf_len >= 3 && filebuf[0] == 0xFF && filebuf[1] == 0xD8 && filebuf[2] == 0xFF;
+}
+
+// Walks the markers of a jpg up to its first scan: a frame header with a size, every segment inside the file
+bool jpeg_header_ok(const unsigned char *filebuf, size_t filebuf_len);
+
+
+struct DecoderBenchmark {
+    std::string name;
+    bool works = false;
+    float mpixels_per_s = 0.0f;
+};
+
+
+// Every compiled in decoder, fastest first. A file goes to the first one that accepts it, and to the next one that
+// accepts it if that fails. The format is told by magic bytes, not by the file extension.
+// Not thread safe: select() once at startup, then decode() from one thread at a time.
+class DecoderRegistry {
+public:
+    void add(std::unique_ptr<ImageDecoder> decoder) { decoders.push_back(std::move(decoder)); }
+
+    // Init every decoder and time it on a small embedded jpg. Decoders that fail either are dropped,
+    // the rest is sorted by throughput. Decoders for other formats are only initialized, and go last.
+    // Returns false if none is left.
+    bool select();
+
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h);
+    // true if the last decode() failed, but every decoder that tried it failed transiently, see ImageDecoder
+    bool failed_transiently() { return last_failure_transient; }
+
+    // true if some decoder that accepts filebuf likes its headers, see ImageDecoder::check_header
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len);
+
+    // true if the decoder decode() tries first on filebuf can scale
+    bool can_scale(const unsigned char *filebuf, size_t filebuf_len);
+
+    // true if the decoder decode() tries first on filebuf is accelerated for it, see ImageDecoder::is_accelerated
+    bool is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h);
+
+    ImageDecoder *get_preferred() { return decoders.empty() ? nullptr : decoders[0].get(); }
+    const std::vector<DecoderBenchmark> &get_benchmarks() { return benchmarks; }
+
+private:
+    std::vector<std::unique_ptr<ImageDecoder>> decoders;
+    std::vector<DecoderBenchmark> benchmarks;
+    bool last_failure_transient = false;
+};
@@ -0,0 +1,248 @@
+#include "etc1.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+
+
+#define GL_ETC1_RGB8_OES_VALUE 0x8D64
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// intensity modifiers, the other two are the negated ones
+static const int MODIFIERS[8][2] = { {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183} };
+
+
+size_t etc1_size(int width, int height) { return (size_t)((width + 3) / 4) * ((height + 3) / 4) * ETC1_BLOCK_BYTES; }
+
+
+bool etc1_is_file(const std::string &path) {
+    const size_t dot = path.rfind('.');
+    if (dot == std::string::npos) return false;
+    const std::string ext = path.substr(dot);
+    return ext == ".pkm" || ext == ".ktx";
+}
+
+
+static unsigned int read_be16(const unsigned char *p) { return (p[0] << 8) | p[1]; }
+
+static uint32_t read_u32(const unsigned char *p, bool swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+
+static bool parse_pkm(const unsigned char *file, size_t file_len, Etc1Image &out) {
+    if (file_len < 16 || memcmp(file, "PKM ", 4) != 0) return false;
+    if (memcmp(file + 4, "10", 2) != 0 && memcmp(file + 4, "20", 2) != 0) return false;
+    if (read_be16(file + 6) != 0) return false; // ETC1_RGB_NO_MIPMAPS
+
+    out.width = read_be16(file + 12);
+    out.height = read_be16(file + 14);
+    out.top_down = true;
+    out.blocks = file + 16;
+    out.blocks_len = etc1_size(out.width, out.height);
+    return out.width > 0 && out.height > 0 && file_len >= 16 + out.blocks_len;
+}
+
+
+static bool parse_ktx(const unsigned char *file, size_t file_len, Etc1Image &out) {
+    if (file_len < 64 || memcmp(file, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) return false;
+    const uint32_t endianness = read_u32(file + 12, false);
+    if (endianness != 0x04030201 && endianness != 0x01020304) return false;
+    const bool swap = endianness != 0x04030201;
+
+    const uint32_t gl_type = read_u32(file + 16, swap), internal_format = read_u32(file + 28, swap);
+    const uint32_t width = read_u32(file + 36, swap), height = read_u32(file + 40, swap), depth = read_u32(file + 44, swap);
+    const uint32_t faces = read_u32(file + 52, swap), kv_bytes = read_u32(file + 60, swap);
+    if (gl_type != 0 || internal_format != GL_ETC1_RGB8_OES_VALUE || depth > 1 || faces != 1) return false;
+    if (width == 0 || height == 0 || width > 16384 || height > 16384 || kv_bytes > file_len - 64) return false;
+
+    // without a KTXorientation key the rows are in GL order, bottom first
+    out.top_down = false;
+    for (size_t pos = 64; pos + 4 <= 64 + kv_bytes; ) {
+        const uint32_t len = read_u32(file + pos, swap);
+        if (len > 64 + kv_bytes - pos - 4) break;
+        const char *kv = (const char*)file + pos + 4;
+        if (len > 15 && memcmp(kv, "KTXorientation", 15) == 0) // key including its terminator
+            out.top_down = memmem(kv + 15, len - 15, "T=d", 3) != nullptr;
+        pos += 4 + (len + 3) / 4 * 4;
+    }
+
+    const size_t level0 = 64 + kv_bytes;
+    if (file_len < level0 + 4) return false;
+    out.width = width;
+    out.height = height;
+    out.blocks = file + level0 + 4;
+    out.blocks_len = etc1_size(width, height);
+    return read_u32(file + level0, swap) >= out.blocks_len && file_len - level0 - 4 >= out.blocks_len;
+}
+
+
+bool etc1_parse(const unsigned char *file, size_t file_len, Etc1Image &out) {
+    return parse_pkm(file, file_len, out) || parse_ktx(file, file_len, out);
+}
+
+
+
+// Encoder: one 4x4 block is two 2x4 or 4x2 halves, each with a base color and a modifier table.
+// Every pixel picks one of the four modifiers of its half, added to all three channels of the base color.
+
+struct HalfFit {
+    int error = INT_MAX;
+    int table = 0;
+    unsigned int indices[8] = {0}; // 2 bit modifier index per pixel of the half
+};
+
+static inline int clamp255(int v) { return v < 0 ? 0 : v > 255 ? 255 : v; }
+
+// Best table and modifiers for the 8 pixels of a half with an expanded base color
+static HalfFit fit_half(const unsigned char *pixels[8], const int base[3]) {
+    HalfFit best;
+    for (int t = 0; t < 8; t++) {
+        const int mods[4] = { MODIFIERS[t][0], MODIFIERS[t][1], -MODIFIERS[t][0], -MODIFIERS[t][1] };
+        HalfFit fit;
+        fit.error = 0;
+        fit.table = t;
+        for (int i = 0; i < 8; i++) {
+            int best_err = INT_MAX;
+            for (int m = 0; m < 4; m++) {
+                int err = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int d = clamp255(base[c] + mods[m]) - pixels[i][c];
+                    err += d * d;
+                }
+                if (err < best_err) { best_err = err; fit.indices[i] = m; }
+            }
+            fit.error += best_err;
+            if (fit.error >= best.error) break;
+        }
+        if (fit.error < best.error) best = fit;
+    }
+    return best;
+}
+
+
+static inline int expand4(int c) { return (c << 4) | c; }
+static inline int expand5(int c) { return (c << 3) | (c >> 2); }
+
+
+// pixel (x, y) of the block belongs to half (flip ? y >= 2 : x >= 2), halves list their pixels in the same order
+static void encode_block(const unsigned char *block[16], unsigned char out[8]) { // block[y*4 + x]
+    uint64_t best_bits = 0;
+    int best_error = INT_MAX;
+
+    for (int flip = 0; flip < 2; flip++) {
+        const unsigned char *pixels[2][8];
+        int xy[2][8][2];
+        int count[2] = {0, 0};
+        int sum[2][3] = {{0}};
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                const int h = flip ? y >= 2 : x >= 2;
+                const int i = count[h]++;
+                pixels[h][i] = block[y*4 + x];
+                xy[h][i][0] = x;
+                xy[h][i][1] = y;
+                for (int c = 0; c < 3; c++) sum[h][c] += block[y*4 + x][c];
+            }
+        }
+
+        for (int differential = 0; differential < 2; differential++) {
+            int q[2][3], base[2][3];
+            bool valid = true;
+            for (int c = 0; c < 3; c++) {
+                for (int h = 0; h < 2; h++) {
+                    const int max = differential ? 31 : 15;
+                    q[h][c] = (sum[h][c] * max + 255 * 4) / (255 * 8); // rounded average
+                }
+                if (differential) {
+                    const int delta = q[1][c] - q[0][c];
+                    if (delta < -4 || delta > 3) valid = false;
+                }
+                for (int h = 0; h < 2; h++) base[h][c] = differential ? expand5(q[h][c]) : expand4(q[h][c]);
+            }
+            if (!valid) continue;
+
+            const HalfFit fits[2] = { fit_half(pixels[0], base[0]), fit_half(pixels[1], base[1]) };
+            const int error = fits[0].error + fits[1].error;
+            if (error >= best_error) continue;
+
+            uint64_t bits = 0;
+            for (int c = 0; c < 3; c++) {
+                const int shift = 59 - 8*c; // R at the top, then G and B
+                if (differential) {
+                    bits |= (uint64_t)q[0][c] << shift;
+                    bits |= (uint64_t)((q[1][c] - q[0][c]) & 7) << (shift - 3);
+                } else {
+                    bits |= (uint64_t)q[0][c] << (shift + 1);
+                    bits |= (uint64_t)q[1][c] << (shift - 3);
+                }
+            }
+            bits |= (uint64_t)fits[0].table << 37;
+            bits |= (uint64_t)fits[1].table << 34;
+            bits |= (uint64_t)differential << 33;
+            bits |= (uint64_t)flip << 32;
+
+            // index bits are column major, most significant bits in the upper 16. Table order is +a, +b, -a, -b,
+            // the block encodes them as 00, 01, 10, 11 too: msb = negative, lsb = large.
+            for (int h = 0; h < 2; h++) {
+                for (int i = 0; i < 8; i++) {
+                    const int bit = xy[h][i][0] * 4 + xy[h][i][1];
+                    const unsigned int index = fits[h].indices[i];
+                    bits |= (uint64_t)(index >> 1) << (16 + bit);
+                    bits |= (uint64_t)(index & 1) << bit;
+                }
+            }
+
+            best_error = error;
+            best_bits = bits;
+        }
+    }
+
+    for (int i = 0; i < 8; i++) out[i] = (unsigned char)(best_bits >> (56 - 8*i)); // big endian
+}
+
+
+void etc1_encode(const unsigned char *rgb, int width, int height, unsigned char *out) {
+    const size_t pitch = (size_t)width * 3;
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            const unsigned char *block[16];
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) // pad partial blocks by repeating the last row and column
+                    block[y*4 + x] = rgb + std::min(by + y, height - 1) * pitch + std::min(bx + x, width - 1) * 3;
+            }
+            encode_block(block, out);
+            out += ETC1_BLOCK_BYTES;
+        }
+    }
+}
+
+
+bool etc1_write_pkm(const std::string &path, const unsigned char *blocks, int width, int height) {
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535) return false;
+
+    unsigned char header[16] = { 'P', 'K', 'M', ' ', '1', '0', 0, 0 };
+    const int padded_w = (width + 3) / 4 * 4, padded_h = (height + 3) / 4 * 4;
+    const int sizes[4] = { padded_w, padded_h, width, height };
+    for (int i = 0; i < 4; i++) {
+        header[8 + 2*i] = sizes[i] >> 8;
+        header[9 + 2*i] = sizes[i] & 0xFF;
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+    const size_t len = etc1_size(width, height);
+    bool written = fwrite(header, 1, sizeof(header), f) == sizeof(header) && fwrite(blocks, 1, len, f) == len;
+    written = fclose(f) == 0 && written;
+    if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
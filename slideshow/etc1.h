@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+// ETC1 (GL_OES_compressed_ETC1_RGB8_texture): 4x4 pixel blocks of 8 bytes, half a byte per pixel.
+// The GPU samples it as is, there is nothing to decode on the CPU.
+#define ETC1_BLOCK_BYTES 8
+
+struct Etc1Image {
+    int width = 0, height = 0;          // visible size, the blocks cover it rounded up to multiples of 4
+    bool top_down = true;               // first block row is the top of the picture
+    const unsigned char *blocks = nullptr; // points into the file
+    size_t blocks_len = 0;
+};
+
+size_t etc1_size(int width, int height);
+
+// Find the first level of a .pkm (version 1.0/2.0, ETC1) or .ktx (version 1, GL_ETC1_RGB8_OES) file in memory.
+// Returns false for anything else, including a truncated file.
+bool etc1_parse(const unsigned char *file, size_t file_len, Etc1Image &out);
+
+// true if path has one of the extensions above
+bool etc1_is_file(const std::string &path);
+
+// Compress packed top-down RGB rows (width*3 bytes apart) into etc1_size(width, height) bytes at out.
+// Tries both block flips and both color modes with every modifier table, too slow for the display loop: meant
+// for the offline encoder, see etc1_encode.cpp.
+void etc1_encode(const unsigned char *rgb, int width, int height, unsigned char *out);
+
+// Write blocks as a .pkm file, through a temporary file so a reader never sees half of it
+bool etc1_write_pkm(const std::string &path, const unsigned char *blocks, int width, int height);
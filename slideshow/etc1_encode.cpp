@@ -0,0 +1,104 @@
+// Offline encoder: writes an ETC1 .pkm next to every jpg of a folder, decoded at the size the slideshow would decode
+// it for the given display. The slideshow then shows the .pkm instead of the jpg, without decoding anything.
+// Run it again after adding photos, jpgs that already have an up to date .pkm are skipped.
+//
+//   etc1_encode <folder> <display width> <display height>
+
+#include "etc1.h"
+
+#include <turbojpeg.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+
+// same choice as the turbojpeg loader: the smallest scaling factor that still covers the display
+static void scaled_size(int target_w, int target_h, int &width, int &height) {
+    int num_factors;
+    tjscalingfactor *factors = tjGetScalingFactors(&num_factors);
+    int best_w = width, best_h = height;
+    for (int i = 0; factors && i < num_factors; i++) {
+        int w = TJSCALED(width, factors[i]), h = TJSCALED(height, factors[i]);
+        if (w >= target_w && h >= target_h && w < best_w) { best_w = w; best_h = h; }
+    }
+    width = best_w;
+    height = best_h;
+}
+
+
+static bool encode_file(tjhandle tj, const std::string &jpg_path, const std::string &pkm_path, int target_w, int target_h) {
+    std::ifstream file(jpg_path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::vector<unsigned char> jpg(file.tellg());
+    file.seekg(0, std::ios::beg);
+    if (!file.read((char*)jpg.data(), jpg.size())) return false;
+
+    int width, height, subsamp, colorspace;
+    if (tjDecompressHeader3(tj, jpg.data(), jpg.size(), &width, &height, &subsamp, &colorspace) != 0) {
+        printf("%s: %s\n", jpg_path.c_str(), tjGetErrorStr());
+        return false;
+    }
+    scaled_size(target_w, target_h, width, height);
+
+    std::vector<unsigned char> rgb((size_t)width * height * 3);
+    if (tjDecompress2(tj, jpg.data(), jpg.size(), rgb.data(), width, 0, height, TJPF_RGB, TJFLAG_ACCURATEDCT) != 0) {
+        printf("%s: %s\n", jpg_path.c_str(), tjGetErrorStr());
+        return false;
+    }
+
+    std::vector<unsigned char> blocks(etc1_size(width, height));
+    etc1_encode(rgb.data(), width, height, blocks.data());
+    return etc1_write_pkm(pkm_path, blocks.data(), width, height);
+}
+
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        printf("usage: %s <folder> <display width> <display height>\n", argv[0]);
+        return 1;
+    }
+    const std::string folder = argv[1];
+    const int target_w = atoi(argv[2]), target_h = atoi(argv[3]);
+
+    namespace fs = std::filesystem;
+    std::vector<fs::path> jpgs;
+    try {
+        for (const auto &entry : fs::directory_iterator(folder)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".jpg") jpgs.push_back(entry.path());
+        }
+    } catch (const fs::filesystem_error &e) {
+        printf("Filesystem error: %s\n", e.what());
+        return 1;
+    }
+
+    tjhandle tj = tjInitDecompress();
+    int encoded = 0, skipped = 0, failed = 0;
+    for (const auto &jpg : jpgs) {
+        fs::path pkm = jpg;
+        pkm.replace_extension(".pkm");
+        std::error_code ec;
+        if (fs::exists(pkm, ec) && fs::last_write_time(pkm, ec) >= fs::last_write_time(jpg, ec)) {
+            skipped++;
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        if (!encode_file(tj, jpg.string(), pkm.string(), target_w, target_h)) {
+            printf("failed: %s\n", jpg.c_str());
+            failed++;
+            continue;
+        }
+        const float s = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+        printf("%s in %.2fs\n", pkm.c_str(), s);
+        encoded++;
+    }
+    tjDestroy(tj);
+
+    printf("%d encoded, %d up to date, %d failed\n", encoded, skipped, failed);
+    return failed ? 1 : 0;
+}
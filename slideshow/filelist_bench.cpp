@@ -0,0 +1,109 @@
+// File list cost per fade: fills a temporary folder with hard links to one jpg, then times what the slideshow does at
+// the end of every fade, a full scan with load_file_list() as before and update_file_list() with the changes inotify
+// reported: none, and then the given number of files added and as many removed. Every time is the average of a few
+// runs. Once without the catalog and once with it in the folder like by default: an update that changes something
+// rewrites it.
+//
+//   filelist_bench <jpg> [files] [changes]
+//
+// Opens the same window, the display size is the decode target.
+
+#include "SDL_GL_window.h"
+#include "load_image.h"
+
+#include <filesystem>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+
+#define DEFAULT_FILES 50000
+#define DEFAULT_CHANGES 20
+#define RUNS 10
+
+
+static float ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string file_name(const std::string &folder, const char *prefix, int i) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%s%05d.jpg", prefix, i);
+    return folder + name;
+}
+
+
+// The scan and the updates with one catalog setting, false if listing failed
+static bool measure(const char *what, SDL_GL_window &window, const std::string &folder, const std::string &catalog, const char *jpg, int changes) {
+    namespace fs = std::filesystem;
+    ImageCacheConfig cache_config = { 0, 0, 0 };
+    SidecarConfig sidecar_config = { "", 0 };
+    ImageLoader loader(folder, window.get_display_width(), window.get_display_height(), cache_config, sidecar_config, 0, "", catalog, "");
+    if (!loader.init_is_successful()) return false;
+    while (loader.listing_in_background()) { // the scan at startup
+        loader.update_file_list();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool ok = true;
+    std::error_code ec;
+    float scan_ms = 0, unchanged_ms = 0, added_ms = 0, removed_ms = 0;
+    for (int run = 0; run < RUNS && ok; run++) {
+        auto start = std::chrono::steady_clock::now();
+        ok = loader.load_file_list();
+        scan_ms += ms_since(start);
+
+        start = std::chrono::steady_clock::now();
+        ok = ok && loader.update_file_list();
+        unchanged_ms += ms_since(start);
+
+        for (int i = 0; i < changes && !ec; i++) fs::create_hard_link(jpg, file_name(folder, "new", i), ec);
+        start = std::chrono::steady_clock::now();
+        ok = ok && !ec && loader.update_file_list();
+        added_ms += ms_since(start);
+
+        for (int i = 0; i < changes; i++) fs::remove(file_name(folder, "new", i), ec);
+        start = std::chrono::steady_clock::now();
+        ok = ok && !ec && loader.update_file_list();
+        removed_ms += ms_since(start);
+    }
+    if (!ok) return false;
+    printf("%s: load_file_list() %.2f ms, update_file_list() %.4f ms with nothing changed, %.2f ms for %d added, %.2f ms for %d removed\n",
+           what, scan_ms / RUNS, unchanged_ms / RUNS, added_ms / RUNS, changes, removed_ms / RUNS, changes);
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <jpg> [files] [changes]\n", argv[0]);
+        return 1;
+    }
+    const int files = argc > 2 ? atoi(argv[2]) : DEFAULT_FILES;
+    const int changes = argc > 3 ? atoi(argv[3]) : DEFAULT_CHANGES;
+    if (files < changes || files < 1) return 1;
+
+    namespace fs = std::filesystem;
+    char folder_template[] = "/tmp/filelist_bench.XXXXXX";
+    if (!mkdtemp(folder_template)) return 1;
+    const std::string folder = folder_template;
+    std::error_code ec;
+    for (int i = 0; i < files && !ec; i++) fs::create_hard_link(argv[1], file_name(folder, "img", i), ec);
+    if (ec) {
+        printf("cannot fill %s: %s\n", folder.c_str(), ec.message().c_str());
+        fs::remove_all(folder, ec);
+        return 1;
+    }
+
+    SDL_GL_window window;
+    printf("%d files in %s, %d changes\n", files, folder.c_str(), changes);
+    const bool ok = measure("no catalog", window, folder, "", argv[1], changes) &&
+                    measure("catalog", window, folder, folder + "/.catalog", argv[1], changes);
+
+    fs::remove_all(folder, ec);
+    if (!ok) printf("listing failed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Files arriving in and leaving one folder (not its subfolders), from inotify. A file only arrives once it is
+// complete: when the program writing it closes it (IN_CLOSE_WRITE), it is renamed into the folder (IN_MOVED_TO) or
+// it is a hard link to an existing file, so a copy in progress is never seen half written. Not thread safe.
+class FolderWatcher {
+public:
+    struct Change {
+        bool added;         // false: deleted or moved away
+        std::string name;   // inside the folder
+    };
+
+    // Watching starts here, call it before scanning the folder so nothing that arrives meanwhile is missed
+    FolderWatcher(const std::string &folder);
+    ~FolderWatcher();
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    // Append the changes since the last call to changes, without blocking.
+    // Returns false if some were lost: queue overflow, the folder was removed or unmounted, or it cannot be watched
+    // at all. The folder has to be scanned again then, watching starts over (if it can) before returning.
+    bool read_changes(std::vector<Change> &changes);
+
+private:
+    bool add_watch();
+    bool is_hard_link(const char *name) const;
+
+private:
+    const std::string folder;
+    int fd = -1;
+    int wd = -1;
+};
@@ -0,0 +1,74 @@
+#include "idle_wait.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+
+IdleWait::IdleWait(const std::vector<std::string> &input_devices) {
+    const char *driver = SDL_GetCurrentVideoDriver();
+    sdl_wait = !driver || (strcmp(driver, "kmsdrm") != 0 && strcmp(driver, "rpi") != 0);
+    if (sdl_wait) return;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        SDL_Log("Cannot wait with epoll (%s), polling for events instead", strerror(errno));
+        sdl_wait = true;
+        return;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    for (const auto &device : input_devices) {
+        const int fd = open(device.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue; // SDL cannot read it either
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0) input_fds.push_back(fd);
+        else close(fd);
+    }
+    SDL_AddEventWatch(on_event, this);
+}
+
+
+IdleWait::~IdleWait() {
+    if (wake_fd >= 0) SDL_RemoveEventWatch(on_event, this);
+    for (int fd : input_fds) close(fd);
+    if (wake_fd >= 0) close(wake_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+
+// Called by SDL_PushEvent on the thread that pushes. Input events come from SDL_PumpEvents on the GL thread, which
+// is not waiting then, only the ones from other threads (SDL_EVENT_USER and up) need to wake it.
+bool SDLCALL IdleWait::on_event(void *userdata, SDL_Event *event) {
+    if (event->type >= SDL_EVENT_USER) {
+        const uint64_t one = 1;
+        if (write(((IdleWait*)userdata)->wake_fd, &one, sizeof(one)) < 0) {} // already pending if the counter is full
+    }
+    return true;
+}
+
+
+void IdleWait::drain(int fd) {
+    char buf[1024];
+    while (read(fd, buf, sizeof(buf)) > 0) {}
+}
+
+
+void IdleWait::wait(int timeout_ms) {
+    wakeups++;
+    if (sdl_wait) {
+        SDL_WaitEventTimeout(nullptr, timeout_ms);
+        return;
+    }
+    // an event pushed while the loop was busy leaves the eventfd set, the worst that does is one extra pass
+    epoll_event events[8];
+    const int count = epoll_wait(epoll_fd, events, 8, timeout_ms); // EINTR: a signal, stop_requested is checked next
+    for (int i = 0; i < count; i++) drain(events[i].data.fd);
+}
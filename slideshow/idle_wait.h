@@ -0,0 +1,39 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Blocks the main loop until there is something to do: a key, an event the loader pushed (a decoded image), or a
+// timeout for the next state change. SDL3 only blocks in SDL_WaitEventTimeout on video drivers that can wait natively
+// (X11, Wayland). On KMSDRM and RPI it polls every millisecond instead, so there the input devices and a wakeup eventfd
+// are waited on with epoll. The devices are opened a second time for that, SDL still reads the events from its own fds.
+// The GL thread waits, any thread can push an SDL event to end the wait.
+class IdleWait {
+public:
+    // input_devices: the evdev devices SDL reads, see SDL_GL_window. Call after SDL_Init.
+    IdleWait(const std::vector<std::string> &input_devices);
+    ~IdleWait();
+    IdleWait(const IdleWait&) = delete;
+    IdleWait& operator=(const IdleWait&) = delete;
+
+    // timeout_ms < 0 waits until something happens. The SDL events are left in the queue.
+    void wait(int timeout_ms);
+
+    // times wait() returned, for DEBUG stats
+    uint64_t get_wakeups() { return wakeups; }
+
+private:
+    static bool SDLCALL on_event(void *userdata, SDL_Event *event);
+    void drain(int fd);
+
+private:
+    bool sdl_wait = true;   // the video driver blocks by itself
+    int epoll_fd = -1;
+    int wake_fd = -1;       // eventfd, written for every event SDL_PushEvent gets from another thread
+    std::vector<int> input_fds;
+    uint64_t wakeups = 0;
+};
@@ -0,0 +1,101 @@
+#include "image_cache.h"
+
+#include <algorithm>
+#include <climits>
+
+
+DecodedImagePtr ImageCache::find_decoded(const std::string &path) {
+    auto it = decoded.find(path);
+    return it != decoded.end() ? it->second.img : nullptr;
+}
+
+
+FileBufferPtr ImageCache::find_raw(const std::string &path) {
+    auto it = raw.find(path);
+    return it != raw.end() ? it->second : nullptr;
+}
+
+
+int ImageCache::rank_of(const std::vector<std::string> &wanted, const std::string &path) {
+    auto pos = std::find(wanted.begin(), wanted.end(), path);
+    return pos != wanted.end() ? std::distance(wanted.begin(), pos) : INT_MAX;
+}
+
+
+// Evict the lowest ranking entry of one tier, but never anything ranking higher than rank
+template <typename Map, typename SizeOf>
+bool ImageCache::evict_lower(Map &map, const std::vector<std::string> &wanted, int rank, SizeOf size_of) {
+    auto worst = map.end();
+    int worst_rank = rank;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        int r = rank_of(wanted, it->first);
+        if (r > worst_rank) { worst = it; worst_rank = r; }
+    }
+    if (worst == map.end()) return false;
+
+    bytes_used -= size_of(worst->second);
+    map.erase(worst);
+    return true;
+}
+
+
+bool ImageCache::insert_decoded(const std::string &path, DecodedImagePtr img, size_t bytes) {
+    if (cfg.decoded_frames <= 0 || bytes > cfg.budget_bytes || has_decoded(path)) return false;
+
+    auto size_of = [](const DecodedEntry &e) { return e.bytes; };
+    const int rank = rank_of(wanted_decoded, path);
+    while ((int)decoded.size() >= cfg.decoded_frames || bytes_used + bytes > cfg.budget_bytes) {
+        if (!evict_lower(decoded, wanted_decoded, rank, size_of)) return false;
+    }
+
+    decoded[path] = DecodedEntry{img, bytes};
+    bytes_used += bytes;
+    return true;
+}
+
+
+bool ImageCache::insert_raw(const std::string &path, FileBufferPtr buf) {
+    if (cfg.raw_neighbors <= 0 || buf->size > cfg.budget_bytes || has_raw(path)) return false;
+
+    auto size_of = [](const FileBufferPtr &b) { return b->size; };
+    const int rank = rank_of(wanted_raw, path);
+    while (bytes_used + buf->size > cfg.budget_bytes) {
+        if (!evict_lower(raw, wanted_raw, rank, size_of)) return false;
+    }
+
+    raw[path] = buf;
+    bytes_used += buf->size;
+    return true;
+}
+
+
+void ImageCache::retain(const std::vector<std::string> &decoded_window, const std::vector<std::string> &raw_window) {
+    wanted_decoded = decoded_window;
+    wanted_raw = raw_window;
+
+    for (auto it = decoded.begin(); it != decoded.end();) {
+        if (rank_of(wanted_decoded, it->first) == INT_MAX) {
+            bytes_used -= it->second.bytes;
+            it = decoded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = raw.begin(); it != raw.end();) {
+        if (rank_of(wanted_raw, it->first) == INT_MAX) {
+            bytes_used -= it->second->size;
+            it = raw.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+ImageCacheStats ImageCache::get_stats() {
+    stats.bytes_used = bytes_used;
+    stats.raw_entries = raw.size();
+    stats.decoded_entries = decoded.size();
+    return stats;
+}
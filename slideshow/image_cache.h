@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+
+#include "buffer_pool.h"
+
+
+struct DecodedImage;
+using DecodedImagePtr = std::shared_ptr<DecodedImage>;
+using FileBufferPtr = std::shared_ptr<const FileBuffer>;
+
+
+struct ImageCacheConfig {
+    size_t budget_bytes;    // hard limit for compressed + decoded entries together
+    int raw_neighbors;      // K: compressed files kept on each side of the current image
+    int decoded_frames;     // M: fully decoded frames kept around the current image
+};
+
+struct ImageCacheStats {
+    unsigned long decoded_hits = 0;
+    unsigned long raw_hits = 0;
+    unsigned long misses = 0;
+    size_t bytes_used = 0;
+    int raw_entries = 0;
+    int decoded_entries = 0;
+};
+
+
+// Two tier cache of neighboring images: the compressed file contents and the decoded frames, keyed by path.
+// Not thread safe, the owner must serialize access.
+class ImageCache {
+public:
+    ImageCache(const ImageCacheConfig &config) : cfg(config) {}
+
+    DecodedImagePtr find_decoded(const std::string &path);
+    FileBufferPtr find_raw(const std::string &path);
+
+    // Return false (and cache nothing) if the entry does not fit the budget
+    bool insert_decoded(const std::string &path, DecodedImagePtr img, size_t bytes);
+    bool insert_raw(const std::string &path, FileBufferPtr buf);
+
+    bool has_decoded(const std::string &path) { return decoded.count(path) != 0; }
+    bool has_raw(const std::string &path) { return raw.count(path) != 0; }
+
+    // Drop every entry that is not listed. Wanted lists are in priority order, a new entry
+    // that does not fit may evict entries of the same tier that rank lower.
+    void retain(const std::vector<std::string> &wanted_decoded, const std::vector<std::string> &wanted_raw);
+
+    void count_decoded_hit() { stats.decoded_hits++; }
+    void count_raw_hit() { stats.raw_hits++; }
+    void count_miss() { stats.misses++; }
+    ImageCacheStats get_stats();
+
+    const ImageCacheConfig cfg;
+
+private:
+    int rank_of(const std::vector<std::string> &wanted, const std::string &path);
+    template <typename Map, typename SizeOf>
+    bool evict_lower(Map &map, const std::vector<std::string> &wanted, int rank, SizeOf size_of);
+
+private:
+    struct DecodedEntry {
+        DecodedImagePtr img;
+        size_t bytes;
+    };
+
+    std::unordered_map<std::string, DecodedEntry> decoded;
+    std::unordered_map<std::string, FileBufferPtr> raw;
+    size_t bytes_used = 0;
+
+    std::vector<std::string> wanted_decoded, wanted_raw;
+
+    ImageCacheStats stats;
+};
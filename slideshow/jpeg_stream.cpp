@@ -0,0 +1,82 @@
+#include "jpeg_stream.h"
+
+#include <algorithm>
+
+#include <SDL3/SDL.h>
+
+
+JpegStream::JpegStream() {
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = on_error;
+    jpeg_create_decompress(&cinfo);
+}
+
+JpegStream::~JpegStream() {
+    jpeg_destroy_decompress(&cinfo); // also fine halfway through, the rows left are never decoded
+}
+
+
+void JpegStream::on_error(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    SDL_Log("libjpeg: %s", message);
+    longjmp(((Error*)cinfo->err)->jump, 1);
+}
+
+
+bool JpegStream::open(const unsigned char *jpg, size_t jpg_len, int target_w, int target_h) {
+    if (started || failed) return false;
+    if (jpg_len < 3 || jpg[0] != 0xFF || jpg[1] != 0xD8) return false; // not a jpg, left to the decoders
+    if (setjmp(err.jump)) {
+        failed = true;
+        return false;
+    }
+
+    jpeg_mem_src(&cinfo, (unsigned char*)jpg, jpg_len);
+    jpeg_read_header(&cinfo, TRUE);
+    if (jpeg_has_multiple_scans(&cinfo)) return false; // see above
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) return false; // no RGB conversion for these
+
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+
+    // let the IDCT do the downscaling: the smallest of 1/8 .. 8/8 that still covers the display
+    cinfo.scale_denom = 8;
+    cinfo.scale_num = 8;
+    for (int num = 1; target_w > 0 && target_h > 0 && num < 8; num++) {
+        cinfo.scale_num = num;
+        jpeg_calc_output_dimensions(&cinfo);
+        if ((int)cinfo.output_width >= target_w && (int)cinfo.output_height >= target_h) break;
+        cinfo.scale_num = 8;
+    }
+
+    jpeg_start_decompress(&cinfo);
+    if (cinfo.output_components != 3) return false;
+
+    started = true;
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    return true;
+}
+
+
+int JpegStream::read_rows(unsigned char *dst, int max_rows) {
+    if (!started || failed) return -1;
+    if (setjmp(err.jump)) {
+        failed = true;
+        return -1;
+    }
+
+    const size_t pitch = (size_t)width * 3;
+    const int first = rows_done, end = std::min(height, rows_done + max_rows);
+    JSAMPROW row_pointers[16];
+    while (rows_done < end) {
+        const int n = std::min(16, end - rows_done);
+        for (int i = 0; i < n; i++) row_pointers[i] = dst + (size_t)(rows_done - first + i) * pitch;
+        const int got = jpeg_read_scanlines(&cinfo, row_pointers, n);
+        if (got <= 0) break; // cannot happen with a memory source, truncated files are padded with gray
+        rows_done += got;
+    }
+    return rows_done - first;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdio>
+#include <cstddef>
+#include <csetjmp>
+#include <jpeglib.h>
+#include <jerror.h>
+
+
+// Decodes a jpg with libjpeg a band of rows at a time, so the whole frame never exists in memory.
+// Rows come out top-down as packed RGB, with the settings the turbojpeg loader uses (fast IDCT, no fancy upsampling).
+// Only single scan jpgs are streamed: libjpeg keeps every coefficient of a progressive one in memory,
+// which costs more than the decoded frame.
+// Not thread safe, but it may be opened on one thread and read on another.
+class JpegStream {
+public:
+    JpegStream();
+    ~JpegStream();
+    JpegStream(const JpegStream&) = delete;
+    JpegStream& operator=(const JpegStream&) = delete;
+
+    // Read the header and pick the smallest IDCT scaling that still covers target_w x target_h, like the turbojpeg loader.
+    // jpg must stay valid as long as the stream. Returns false if it cannot be streamed, nothing is decoded then.
+    bool open(const unsigned char *jpg, size_t jpg_len, int target_w, int target_h);
+
+    int get_width() { return width; }
+    int get_height() { return height; }
+    int get_rows_done() { return rows_done; }
+
+    // Decode up to max_rows more rows into dst, width*3 bytes apart.
+    // Returns how many, 0 once every row is out, -1 on a corrupt file (the stream is done then).
+    int read_rows(unsigned char *dst, int max_rows);
+    // After a failure: libjpeg ran out of memory, the file may well be fine
+    bool out_of_memory() { return failed && err.pub.msg_code == JERR_OUT_OF_MEMORY; }
+
+private:
+    struct Error {
+        struct jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+    static void on_error(j_common_ptr cinfo);
+
+    struct jpeg_decompress_struct cinfo;
+    Error err;
+    bool started = false, failed = false;
+    int width = 0, height = 0;
+    int rows_done = 0;
+};
@@ -0,0 +1,102 @@
+// Decode and upload time, and peak memory: loads the images of a folder in turn like arrow keys with nothing cached or
+// prefetched, and reports the time from the request to the image being in its texture, the upload part of it, and the
+// peak RSS of the process. Build it with an option on and off and compare, e.g. RPI_USE_YUV_DECODE, RPI_USE_MMAP_READ or
+// RPI_USE_STREAMING_DECODE.
+//
+//   load_bench <folder> [loads] [cold]
+//
+// cold: drop the images from the page cache before every load, so the file is read from the drive like after a reboot.
+// Otherwise they are read from memory after the first pass through the folder.
+// IMG_DECODE_THREADS as for the slideshow. Opens the same window, the display size is the decode target.
+
+#include "SDL_GL_window.h"
+#include "load_image.h"
+
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#define DEFAULT_LOADS 20
+
+
+// Only clean pages that are not mapped are dropped, which is every image the loader is done with
+static void drop_page_cache(const char *folder) {
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(folder, ec)) {
+        if (!entry.is_regular_file()) continue;
+        int fd = open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <folder> [loads] [cold]\n", argv[0]);
+        return 1;
+    }
+    const int loads = argc > 2 ? atoi(argv[2]) : DEFAULT_LOADS;
+    const bool cold = argc > 3 && strcmp(argv[3], "cold") == 0;
+    const char* env_decode_threads = getenv("IMG_DECODE_THREADS");
+    const int decode_threads = env_decode_threads != nullptr ? atoi(env_decode_threads) : 0;
+
+    SDL_GL_window window;
+    ImageCacheConfig cache_config = { 0, 0, 0 };
+    SidecarConfig sidecar_config = { "", 0 };
+    ImageLoader loader(argv[1], window.get_display_width(), window.get_display_height(), cache_config, sidecar_config, decode_threads, "", "", "");
+    if (!loader.init_is_successful()) return 1;
+    loader.set_upload_budget(0); // one glTexImage2D in one update()
+
+#ifdef USE_YUV_DECODE
+    const char *pixels = "Y/Cb/Cr planes";
+#else
+    const char *pixels = "RGB";
+#endif
+#ifdef USE_MMAP_READ
+    const char *reads = "mmap";
+#else
+    const char *reads = "read()";
+#endif
+#ifdef USE_STREAMING_DECODE
+    const char *decodes = "streamed";
+#else
+    const char *decodes = "whole frames";
+#endif
+    printf("%s, %s, %s, %s page cache, display %dx%d, %d loads\n", pixels, reads, decodes, cold ? "cold" : "warm",
+           window.get_display_width(), window.get_display_height(), loads);
+
+    float total_ms = 0, upload_ms = 0, max_ms = 0;
+    for (int i = 0; i < loads; i++) {
+        if (cold) drop_page_cache(argv[1]);
+        const auto start = std::chrono::steady_clock::now();
+        loader.load_next_image(LoadPriority::USER);
+        while (!loader.new_image_has_been_loaded()) {
+            const auto update_start = std::chrono::steady_clock::now();
+            if (!loader.update()) {
+                printf("loading failed\n");
+                return 1;
+            }
+            upload_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - update_start).count(); // ~0 until the decode is done
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        loader.switch_active_texture();
+        total_ms += ms;
+        if (ms > max_ms) max_ms = ms;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    if (loads) printf("request to loaded: %.1f ms average, %.1f max, of which upload %.1f ms average (%d loads)\n", total_ms / loads, max_ms, upload_ms / loads, loads);
+    printf("peak RSS %.1f MB\n", usage.ru_maxrss / 1024.0f);
+    return 0;
+}
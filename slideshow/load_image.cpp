@@ -1,20 +1,33 @@
 #include "load_image.h"
 
-#include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <unordered_map>
+#include <chrono>
 #include <cstddef>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_opengles2.h>
 
 
 
-bool _init_img_loader();
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height);
-void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len);
-void _loader_cleanup();
+// Loaders allocate their output through these, so it comes from the pool owned by ImageLoader
+static BufferPool *g_pixel_pool = nullptr;
 
+static unsigned char *_alloc_pixeldata(size_t len) { return g_pixel_pool ? g_pixel_pool->acquire(len) : (unsigned char*)malloc(len); }
+static void _release_pixeldata(unsigned char *pixeldata) { 
+    if (g_pixel_pool) g_pixel_pool->release(pixeldata); 
+    else free(pixeldata);
+}
+
+// Every enabled backend is compiled in, DecoderRegistry picks between them at runtime
 #ifdef USE_STB_IMAGE
     #include <loader_stb.cpp>
 #endif
@@ -27,9 +40,39 @@ void _loader_cleanup();
 #ifdef USE_V4L2
     #include <loader_v4l2.cpp>
 #endif
+#ifdef USE_QOI
+    #include <loader_qoi.cpp>
+#endif
+
+#if defined(USE_YUV_DECODE) && !defined(USE_TURBO_JPEG)
+    #error "USE_YUV_DECODE is only supported by the turbojpeg loader"
+#endif
+
+#ifdef USE_V4L2
+    #include <SDL3/SDL_egl.h>
+    #include <cstring>
+#endif
 
-#if !defined(LOADER_GL_PIXEL_FORMAT) 
-    #define LOADER_GL_PIXEL_FORMAT GL_RGB
+#if defined(USE_STREAMING_DECODE) || defined(USE_PREEMPTIBLE_DECODE)
+    #include "jpeg_stream.h"
+#endif
+
+#ifdef USE_RGB565
+    #include "rgb565.h"
+#endif
+
+#include "etc1.h"
+
+#ifndef GL_ETC1_RGB8_OES
+    #define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#if defined(USE_RGB565) && defined(USE_YUV_DECODE)
+    #error "USE_RGB565 needs packed RGB frames, it does not work with USE_YUV_DECODE"
+#endif
+
+#if defined(USE_PREEMPTIBLE_DECODE) && defined(USE_YUV_DECODE)
+    #error "USE_PREEMPTIBLE_DECODE decodes to packed RGB rows, it does not work with USE_YUV_DECODE"
 #endif
 
 
@@ -51,94 +94,932 @@ void _loader_cleanup();
 #endif
 
 
-bool load_image(const std::string& path, GLenum texture_unit) { 
-    std::vector<unsigned char> filebuf;
+#ifdef USE_STREAMING_DECODE
+#define STREAM_BAND_ROWS 32 // rows decoded and uploaded at a time, 180KB for a 1920 wide image
+
+// A jpg being decoded a band at a time, rows come out the way the texture stores them
+struct ImageStream {
+    JpegStream jpg;
+#ifdef USE_RGB565
+    std::unique_ptr<Rgb565Converter> rgb565; // resamples to the display size on the way
+    std::vector<unsigned char> band;         // decoded rows band_first .. band_first + band_rows - 1
+    int band_first = 0, band_rows = 0;
+    int width = 0, height = 0, next_row = 0; // of the output
+#endif
+
+    // Up to max_rows more rows into dst. Returns how many, 0 once every row is out, -1 on a corrupt jpg.
+    int read_rows(unsigned char *dst, int max_rows);
+};
+
+
+int ImageStream::read_rows(unsigned char *dst, int max_rows) {
+#ifdef USE_RGB565
+    const size_t src_pitch = (size_t)jpg.get_width() * 3;
+    int rows = 0;
+    while (rows < max_rows && next_row < height) {
+        const int src_row = rgb565->src_row(next_row);
+        if (src_row >= band_first + band_rows) { // rows only move forward, the band before is not needed anymore
+            band_first += band_rows;
+            band_rows = jpg.read_rows(band.data(), STREAM_BAND_ROWS);
+            if (band_rows <= 0) return -1;
+            continue;
+        }
+        rgb565->convert_row(band.data() + (src_row - band_first) * src_pitch, next_row, (uint16_t*)dst + (size_t)rows * width);
+        rows++;
+        next_row++;
+    }
+    return rows;
+#else
+    return jpg.read_rows(dst, max_rows);
+#endif
+}
+#endif
+
+
+DecodedImage::DecodedImage() = default; // here, where ImageStream is a complete type
+
+DecodedImage::~DecodedImage() { 
+    if (!mapping && decoder) decoder->free_pixeldata(pixeldata, pixeldata_len); 
+}
+
+
+// Runs on the worker thread, no GL calls allowed here.
+// Plain POSIX io into a pooled buffer, an ifstream would allocate its own buffer on every open.
+static FileBufferPtr read_file(const std::string& path, BufferPool &pool) { 
+    #ifdef DEBUG
+        ScopedTimer timer("read file"); 
+    #endif
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SDL_Log("Failed to open %s", path.c_str());
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        SDL_Log("Failed to stat %s", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    auto buf = std::make_shared<FileBuffer>(&pool);
+    buf->size = st.st_size;
+    buf->data = pool.acquire(buf->size);
+
+    size_t done = 0;
+    while (buf->data && done < buf->size) {
+        ssize_t n = read(fd, buf->data + done, buf->size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fd);
+
+    if (!buf->data || done != buf->size) {
+        SDL_Log("Failed to read %s", path.c_str());
+        return nullptr;
+    }
+    return buf;
+}
+
+
+#ifdef USE_MMAP_READ
+// Runs on the worker thread, no GL calls allowed here.
+// Maps the file read only and hands the mapping straight to the decoder: no copy and no buffer at all.
+// readahead: start pulling the whole file in right away, for prefetched files that are not decoded yet.
+static FileBufferPtr map_file(const std::string& path, BufferPool &pool, bool readahead) { 
+    #ifdef DEBUG
+        ScopedTimer timer("mapped file"); 
+    #endif
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SDL_Log("Failed to open %s", path.c_str());
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        SDL_Log("Failed to stat %s", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file referenced
+    if (mem == MAP_FAILED) {
+        SDL_Log("Failed to map %s, reading it instead", path.c_str());
+        return read_file(path, pool);
+    }
+
+    madvise(mem, st.st_size, readahead ? MADV_WILLNEED : MADV_SEQUENTIAL);
+
+    auto buf = std::make_shared<FileBuffer>(nullptr);
+    buf->data = (unsigned char*)mem;
+    buf->size = st.st_size;
+    return buf;
+}
+#endif
+
+
+static FileBufferPtr load_file(const std::string& path, BufferPool &pool, bool readahead) {
+#ifdef USE_MMAP_READ
+    return map_file(path, pool, readahead);
+#else
+    return read_file(path, pool);
+#endif
+}
+
+
+// Runs on the worker thread, no GL calls allowed here
+static bool decode_file(DecoderRegistry &decoders, const FileBuffer &filebuf, const std::string& path, int target_w, int target_h, DecodedImagePtr &img_out) { 
+    auto img = std::make_shared<DecodedImage>();
 
     {
         #ifdef DEBUG
-            ScopedTimer timer("read file"); 
+            ScopedTimer timer("decoded image"); 
         #endif
 
-        std::ifstream file(path, std::ios::binary | std::ios::ate);
-        if (!file) {
-            SDL_Log("Failed to open %s", path.c_str());
+        if (!decoders.decode(*img, filebuf.data, filebuf.size, path, target_w, target_h)) {
             return false;
         }
+    }
 
-        const auto size = file.tellg();
-        filebuf.resize(size);
+    if (!img->pixeldata || img->width <= 0 || img->height <= 0) {
+        SDL_Log("Invalid decoded data for GL upload ptr:%p w:%d h:%d", img->pixeldata, img->width, img->height);
+        return false;
+    }
 
-        file.seekg(0, std::ios::beg);
-        if (!file.read((char*)filebuf.data(), size)) {
-            SDL_Log("Failed to read %s", path.c_str());
-            return false;
+    img->path = path;
+    img_out = img;
+    return true;
+}
+
+
+#ifdef USE_RGB565
+// Runs on the worker thread. Packed frames become RGB565 at exactly width x height, so they always fit the display
+// sized textures. Planar frames and DMABUF frames the GPU imports as they are stay untouched.
+static void convert_to_rgb565(DecodedImagePtr &img, int width, int height) {
+    const DecodedImage &src = *img;
+    if (src.num_planes != 0 || src.dmabuf_fd >= 0 || src.type != GL_UNSIGNED_BYTE) return;
+
+    #ifdef DEBUG
+        ScopedTimer timer("converted to RGB565"); 
+    #endif
+
+    // the converted frame lives in the pixel pool, the mapping hands it back there
+    auto buf = std::make_shared<FileBuffer>(g_pixel_pool);
+    buf->size = (size_t)width * height * 2;
+    buf->data = g_pixel_pool->acquire(buf->size);
+    if (!buf->data) return;
+
+    // bottom-up frames are converted as they are, row 0 of both is the bottom
+    Rgb565Converter(src.width, src.height, src.format == GL_RGBA ? 4 : 3, width, height).convert(src.pixeldata, (uint16_t*)buf->data);
+
+    auto out = std::make_shared<DecodedImage>();
+    out->mapping = buf;
+    out->pixeldata = buf->data;
+    out->pixeldata_len = buf->size;
+    out->width = width;
+    out->height = height;
+    out->format = GL_RGB;
+    out->type = GL_UNSIGNED_SHORT_5_6_5;
+    out->top_down = src.top_down;
+    out->path = src.path;
+    img = out; // the decoded frame goes back to its decoder
+}
+#endif
+
+
+#ifdef USE_PREEMPTIBLE_DECODE
+#define PREEMPT_BAND_ROWS 16 // rows decoded between two looks at the preempt flag
+
+// A background jpg decode that a user request can interrupt between two bands of rows.
+// An interrupted one is parked, and goes on from the same row if its image is still wanted.
+struct DecodeJob {
+    std::string path;
+    FileBufferPtr source;   // the jpg, read by jpg
+    JpegStream jpg;
+    FileBufferPtr pixels;   // packed RGB rows, top-down, in the pixel pool
+};
+
+enum class BandDecode { DONE, FAILED, NO_MEMORY, PREEMPTED, UNSUPPORTED };
+
+
+// Runs on the worker thread. Decodes path with libjpeg, same output size and settings as the turbojpeg loader, and
+// resumes the parked job if it is for path. Stops when *preempt is set (null: never), the job is parked then,
+// replacing the one that was. UNSUPPORTED: not a jpg libjpeg can decode by rows, nothing was done. FAILED: the jpg is
+// corrupt, NO_MEMORY: it may be fine.
+static BandDecode decode_bands(std::unique_ptr<DecodeJob> &parked, const std::string &path, const FileBufferPtr &buf, int target_w, int target_h, 
+                               const std::atomic<bool> *preempt, DecodedImagePtr &img_out) {
+    std::unique_ptr<DecodeJob> job;
+    if (parked && parked->path == path) {
+        job = std::move(parked);
+#ifdef DEBUG
+        SDL_Log("resuming the decode of %s at row %d", path.c_str(), job->jpg.get_rows_done());
+#endif
+    } else {
+        job = std::make_unique<DecodeJob>();
+        job->path = path;
+        job->source = buf;
+        if (!job->jpg.open(buf->data, buf->size, target_w, target_h)) return BandDecode::UNSUPPORTED;
+
+        auto pixels = std::make_shared<FileBuffer>(g_pixel_pool);
+        pixels->size = (size_t)job->jpg.get_width() * job->jpg.get_height() * 3;
+        pixels->data = g_pixel_pool->acquire(pixels->size);
+        if (!pixels->data) {
+            SDL_Log("Out of memory");
+            return BandDecode::NO_MEMORY;
         }
+        job->pixels = pixels;
     }
 
-    int width = 0, height = 0;
-    unsigned char* pixeldata = nullptr;
-    size_t pixeldata_len = 0;    
+    #ifdef DEBUG
+        ScopedTimer timer("decoded bands"); 
+    #endif
+    const size_t pitch = (size_t)job->jpg.get_width() * 3;
+    while (job->jpg.get_rows_done() < job->jpg.get_height()) {
+        if (preempt && *preempt) {
+#ifdef DEBUG
+            SDL_Log("interrupted the decode of %s at row %d of %d", path.c_str(), job->jpg.get_rows_done(), job->jpg.get_height());
+#endif
+            parked = std::move(job);
+            return BandDecode::PREEMPTED;
+        }
+        if (job->jpg.read_rows(job->pixels->data + job->jpg.get_rows_done() * pitch, PREEMPT_BAND_ROWS) <= 0) {
+            SDL_Log("Failed to decode %s", path.c_str());
+            return job->jpg.out_of_memory() ? BandDecode::NO_MEMORY : BandDecode::FAILED;
+        }
+    }
 
-    {
+    auto img = std::make_shared<DecodedImage>();
+    img->mapping = job->pixels;
+    img->pixeldata = job->pixels->data;
+    img->pixeldata_len = job->pixels->size;
+    img->width = job->jpg.get_width();
+    img->height = job->jpg.get_height();
+    img->format = GL_RGB;
+    img->top_down = true;
+    img->path = path;
+    img_out = img;
+    return BandDecode::DONE;
+}
+#endif
+
+
+#ifdef USE_STREAMING_DECODE
+// Runs on the worker thread. Only reads the header, the rows are decoded while uploading (or writing a sidecar).
+static bool open_stream(const FileBufferPtr &buf, const std::string& path, int target_w, int target_h, DecodedImagePtr &img_out) {
+    auto img = std::make_shared<DecodedImage>();
+    img->source = buf;
+    img->stream = std::make_unique<ImageStream>();
+    JpegStream &jpg = img->stream->jpg;
+    if (!jpg.open(buf->data, buf->size, target_w, target_h)) return false;
+
+    img->width = jpg.get_width();
+    img->height = jpg.get_height();
+    img->format = GL_RGB;
+#ifdef USE_RGB565
+    ImageStream &stream = *img->stream;
+    stream.rgb565 = std::make_unique<Rgb565Converter>(img->width, img->height, 3, target_w, target_h);
+    stream.band.resize((size_t)img->width * 3 * STREAM_BAND_ROWS);
+    stream.width = img->width = target_w;
+    stream.height = img->height = target_h;
+    img->type = GL_UNSIGNED_SHORT_5_6_5;
+#endif
+    img->top_down = true; // rows come out in file order
+    img->path = path;
+    img_out = img;
+    return true;
+}
+#endif
+
+
+// Runs on the worker thread. A pre-encoded ETC1 file is uploaded straight from buf, see etc1_encode.cpp.
+static bool open_etc1(const FileBufferPtr &buf, const std::string& path, DecodedImagePtr &img_out) {
+    Etc1Image etc1;
+    if (!etc1_parse(buf->data, buf->size, etc1)) {
+        SDL_Log("%s is not an ETC1 texture", path.c_str());
+        return false;
+    }
+
+    auto img = std::make_shared<DecodedImage>();
+    img->mapping = buf;
+    img->pixeldata = (unsigned char*)etc1.blocks;
+    img->pixeldata_len = etc1.blocks_len;
+    img->width = etc1.width;
+    img->height = etc1.height;
+    img->format = GL_ETC1_RGB8_OES;
+    img->top_down = etc1.top_down;
+    img->path = path;
+    img_out = img;
+    return true;
+}
+
+
+static bool is_compressed(const DecodedImage &img) { return img.format == GL_ETC1_RGB8_OES; }
+
+
+static bool is_streamed(const DecodedImage &img) {
+#ifdef USE_STREAMING_DECODE
+    return img.stream != nullptr;
+#else
+    return false;
+#endif
+}
+
+
+static void push_loaded_event(Uint32 type) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    SDL_PushEvent(&event);
+}
+
+
+// The image on screen before the last restart, empty if unknown
+static std::string read_last_shown(const std::string &file) {
+    if (file.empty()) return "";
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return "";
+    char buf[4096];
+    ssize_t len = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+    if (len <= 0) return "";
+    std::string path(buf, len);
+    size_t end = path.find('\n');
+    return end == std::string::npos ? "" : path.substr(0, end); // no newline: cut short by a power loss
+}
+
+
+// Overwritten in place, not replaced: only creating it changes the mtime of the folder, which the catalog is told about
+static void write_last_shown(const std::string &file, const std::string &path, Catalog &catalog) {
+    if (file.empty() || path.empty()) return;
+    int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        const int64_t before = catalog.before_own_write();
+        fd = open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        catalog.after_own_write(before);
+    }
+    if (fd < 0) return;
+    const std::string line = path + "\n";
+    if (pwrite(fd, line.data(), line.size(), 0) == (ssize_t)line.size()) {
+        if (ftruncate(fd, line.size()) != 0) SDL_Log("Cannot truncate %s: %s", file.c_str(), strerror(errno));
+    }
+    close(fd);
+}
+
+
+// Runs on the worker thread without the mutex held.
+// A valid sidecar is mapped as is, otherwise the jpg is decoded from buf (read here if null).
+// Files that fail to decode are quarantined, and skipped without reading them from then on.
+// preemptible: background work, see decode_image.
+bool ImageLoader::read_image(const std::string &path, FileBufferPtr buf, DecodedImagePtr &img, bool preemptible) {
+    if (quarantine.contains(path)) return false;
+    if (sidecars.enabled() && !etc1_is_file(path)) {
         #ifdef DEBUG
-            ScopedTimer timer("decoded image"); 
+            ScopedTimer timer("mapped sidecar");
         #endif
+        if (sidecars.load(path, img)) return true;
+    }
 
-        if (!_load_image(pixeldata, pixeldata_len, filebuf, path, width, height)) {
-            _free_pixeldata(pixeldata, pixeldata_len);
-            return false;
+    if (!buf) buf = load_file(path, file_pool, false);
+    if (!buf) return false; // removed, or the drive is gone for now: not the file's fault
+    if (decode_image(path, buf, img, preemptible)) return true;
+    quarantine_if_broken(path);
+    return false;
+}
+
+
+// Worker thread, after decode_image failed on path. Only a file that is corrupt or not an image at all is
+// quarantined: an interrupted decode goes on later, one that ran out of memory is tried again the next time.
+void ImageLoader::quarantine_if_broken(const std::string &path) {
+    if (is_parked(path)) return;
+    if (decode_failed_transiently) {
+        SDL_Log("Could not decode %s for now, trying it again later", path.c_str());
+        return;
+    }
+    quarantine.add(path);
+}
+
+
+#define PREVIEW_DIVISOR 8 // previews cover 1/8 of the display size, turbojpeg then decodes most photos at 1/8 scale
+
+// Runs on the worker thread without the mutex held. Decodes a small copy of path to show while the full frame is
+// decoded. Returns false if that would not be quicker: the file has a sidecar, is ETC1 or its decoder cannot scale.
+// buf is read here if null, so the full decode can reuse it.
+bool ImageLoader::read_preview(const std::string &path, FileBufferPtr &buf, DecodedImagePtr &img) {
+    if (etc1_is_file(path) || (sidecars.enabled() && sidecars.is_fresh(path)) || quarantine.contains(path)) return false;
+    if (!buf) buf = load_file(path, file_pool, false);
+    if (!buf || !decoders.check_header(buf->data, buf->size) || !decoders.can_scale(buf->data, buf->size)) return false;
+
+    // not streamed, a small frame is decoded in one go
+    if (!decode_file(decoders, *buf, path, display_w / PREVIEW_DIVISOR, display_h / PREVIEW_DIVISOR, img)) return false;
+#ifdef USE_RGB565
+    convert_to_rgb565(img, display_w, display_h); // scaled up like every frame, the textures keep their size and format
+#endif
+    img->preview = true;
+#ifdef DEBUG
+    SDL_Log("preview of %s at %dx%d", path.c_str(), img->width, img->height);
+#endif
+    return true;
+}
+
+
+// Runs on the worker thread without the mutex held. Decodes a frame of path and describes the image in the catalog,
+// with the time the decode took unless it was resumed or is streamed.
+bool ImageLoader::decode_image(const std::string &path, const FileBufferPtr &buf, DecodedImagePtr &img, bool preemptible) {
+    const auto start = std::chrono::steady_clock::now();
+    const bool resumed = is_parked(path);
+    if (!decode_frame(path, buf, img, preemptible)) return false;
+    const auto decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    catalog.describe(path, buf->data, buf->size, resumed || is_streamed(*img) || is_compressed(*img) ? 0 : decode_us);
+    return true;
+}
+
+
+// jpgs libjpeg can stream are only opened, see JpegStream, ETC1 files are not decoded at all.
+// preemptible: jpgs are decoded a band of rows at a time and the decode stops early, returning false, when a USER
+// request comes in. is_parked(path) tells that apart from a failure. A later call for the same path goes on from there.
+// Not for jpgs the selected decoder splits across the cores or hands to the hardware, those are done sooner in one go.
+// A failure that is not the file's fault, like running out of memory, sets decode_failed_transiently.
+bool ImageLoader::decode_frame(const std::string &path, const FileBufferPtr &buf, DecodedImagePtr &img, bool preemptible) {
+    decode_failed_transiently = false;
+    if (etc1_is_file(path)) return etc1_supported && open_etc1(buf, path, img);
+    if (!decoders.check_header(buf->data, buf->size)) { // half written, or not an image at all: do not even start
+        SDL_Log("Cannot read the headers of %s", path.c_str());
+        return false;
+    }
+#ifdef USE_STREAMING_DECODE
+    if (stream_jpgs && open_stream(buf, path, display_w, display_h, img)) return true;
+#endif
+#ifdef USE_PREEMPTIBLE_DECODE
+    if (is_parked(path) || (preemptible && !decoders.is_accelerated(buf->data, buf->size, display_w, display_h))) {
+        const BandDecode status = decode_bands(parked_job, path, buf, display_w, display_h, preemptible ? &preempt : nullptr, img);
+        decode_failed_transiently = status == BandDecode::NO_MEMORY;
+        if (status == BandDecode::FAILED || status == BandDecode::NO_MEMORY || status == BandDecode::PREEMPTED) return false;
+        if (status == BandDecode::DONE) {
+    #ifdef USE_RGB565
+            convert_to_rgb565(img, display_w, display_h);
+    #endif
+            return true;
         }
     }
+#endif
+    if (!decode_file(decoders, *buf, path, display_w, display_h, img)) {
+        decode_failed_transiently = decoders.failed_transiently();
+        return false;
+    }
+#ifdef USE_RGB565
+    convert_to_rgb565(img, display_w, display_h);
+#endif
+    return true;
+}
+
+
+// Worker thread only. true if a background decode of path was interrupted and waits to go on.
+bool ImageLoader::is_parked(const std::string &path) {
+#ifdef USE_PREEMPTIBLE_DECODE
+    return parked_job && parked_job->path == path;
+#else
+    return false;
+#endif
+}
+
+
+static bool store_sidecar(SidecarCache &sidecars, const std::string &path, DecodedImage &img) {
+    if (is_compressed(img)) return false; // uploaded straight from the file already
+#ifdef USE_STREAMING_DECODE
+    if (img.stream) return sidecars.store(path, img, [&](unsigned char *rows, int max_rows) { return img.stream->read_rows(rows, max_rows); });
+#endif
+    return sidecars.store(path, img);
+}
+
+
+static size_t decoded_size(const DecodedImage &img) {
+    return img.pixeldata_len ? img.pixeldata_len : (size_t)img.width * img.height * 4; // not every loader reports its allocation
+}
+
+
+static int bytes_per_pixel(GLenum format, GLenum type) { 
+    if (type == GL_UNSIGNED_SHORT_5_6_5) return 2;
+    return format == GL_RGBA ? 4 : format == GL_RGB ? 3 : 1; 
+}
+
+// Packed pixels are a single plane in img.format and img.type, planar images are luminance planes back to back
+static GLenum plane_format(const DecodedImage &img) { return img.num_planes == 0 ? img.format : GL_LUMINANCE; }
+static GLenum plane_type(const DecodedImage &img) { return img.num_planes == 0 ? img.type : GL_UNSIGNED_BYTE; }
+static int plane_count(const DecodedImage &img) { return img.num_planes == 0 ? 1 : img.num_planes; }
+static int plane_width(const DecodedImage &img, int i) { return img.num_planes == 0 ? img.width : img.plane_w[i]; }
+static int plane_height(const DecodedImage &img, int i) { return img.num_planes == 0 ? img.height : img.plane_h[i]; }
+static size_t plane_offset(const DecodedImage &img, int plane) {
+    size_t offset = 0;
+    for (int i = 0; i < plane; i++) offset += (size_t)plane_width(img, i) * plane_height(img, i) * bytes_per_pixel(plane_format(img), plane_type(img));
+    return offset;
+}
+
+
+// tell the shader how to sample a slot
+static void set_slot_layout(const DecodedImage &img, int slot) {
+    GLint program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glUniform1f(glGetUniformLocation(program, slot == 0 ? "uPlanes0" : "uPlanes1"), (float)img.num_planes);
+    glUniform1f(glGetUniformLocation(program, slot == 0 ? "uFlip0" : "uFlip1"), img.top_down ? 1.0f : 0.0f);
+}
+
+
+#ifdef USE_V4L2
+#define DRM_FORMAT_ABGR8888 0x34324241 // fourcc "AB24": R, G, B, A in memory, same layout as V4L2 RGBA32
+
+// Frames that carry a DMABUF become the storage of the texture through an EGLImage, nothing is uploaded
+struct DmabufImporter {
+    bool probed = false;
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLCREATEIMAGEKHRPROC create_image = nullptr;
+    PFNEGLDESTROYIMAGEKHRPROC destroy_image = nullptr;
+    PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture = nullptr;
+};
+static DmabufImporter g_dmabuf;
+
+
+// Runs on the GL thread, checks the extensions once
+static bool dmabuf_import_supported() {
+    if (g_dmabuf.probed) return g_dmabuf.image_target_texture != nullptr;
+    g_dmabuf.probed = true;
+
+    EGLDisplay display = SDL_EGL_GetCurrentDisplay();
+    auto query_string = (PFNEGLQUERYSTRINGPROC)SDL_EGL_GetProcAddress("eglQueryString");
+    const char *egl_extensions = display != EGL_NO_DISPLAY && query_string ? query_string(display, EGL_EXTENSIONS) : nullptr;
+    const char *gl_extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (!egl_extensions || !strstr(egl_extensions, "EGL_EXT_image_dma_buf_import") || !gl_extensions || !strstr(gl_extensions, "GL_OES_EGL_image")) {
+        SDL_Log("DMABUF import is not supported, V4L2 frames will be uploaded");
+        return false;
+    }
+
+    g_dmabuf.display = display;
+    g_dmabuf.create_image = (PFNEGLCREATEIMAGEKHRPROC)SDL_EGL_GetProcAddress("eglCreateImageKHR");
+    g_dmabuf.destroy_image = (PFNEGLDESTROYIMAGEKHRPROC)SDL_EGL_GetProcAddress("eglDestroyImageKHR");
+    if (g_dmabuf.create_image && g_dmabuf.destroy_image)
+        g_dmabuf.image_target_texture = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)SDL_GL_GetProcAddress("glEGLImageTargetTexture2DOES");
+    return g_dmabuf.image_target_texture != nullptr;
+}
+
+
+// Runs on the GL thread. Returns the EGLImage now backing the texture of slot, nullptr if img has to be uploaded.
+static void *import_dmabuf(const DecodedImage &img, int slot) {
+    if (img.dmabuf_fd < 0 || img.num_planes != 0 || img.format != GL_RGBA || !dmabuf_import_supported()) return nullptr;
+
+    const EGLint attribs[] = {
+        EGL_WIDTH, img.width,
+        EGL_HEIGHT, img.height,
+        EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_ABGR8888,
+        EGL_DMA_BUF_PLANE0_FD_EXT, img.dmabuf_fd,
+        EGL_DMA_BUF_PLANE0_OFFSET_EXT, (EGLint)img.dmabuf_offset,
+        EGL_DMA_BUF_PLANE0_PITCH_EXT, img.dmabuf_pitch,
+        EGL_NONE
+    };
+    EGLImageKHR image = g_dmabuf.create_image(g_dmabuf.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+    if (image == EGL_NO_IMAGE_KHR) {
+        SDL_Log("Failed to import the DMABUF of %s, uploading it", img.path.c_str());
+        return nullptr;
+    }
+
+    while (glGetError() != GL_NO_ERROR) {}
+    glActiveTexture(GL_TEXTURE0 + slot);
+    g_dmabuf.image_target_texture(GL_TEXTURE_2D, (GLeglImageOES)image);
+    if (glGetError() != GL_NO_ERROR) {
+        SDL_Log("Failed to bind the DMABUF of %s, uploading it", img.path.c_str());
+        g_dmabuf.destroy_image(g_dmabuf.display, image);
+        return nullptr;
+    }
+    return image;
+}
+#endif
+
+
+static void log_peak_rss(const DecodedImage &img) {
+    #ifdef DEBUG
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        SDL_Log("peak RSS %ld KB, %dx%d in %d planes, %zu bytes", usage.ru_maxrss, img.width, img.height, img.num_planes, img.pixeldata_len);
+    #endif
+}
 
+
+#ifdef USE_STREAMING_DECODE
+static std::vector<unsigned char> g_stream_band; // GL thread only, the one band of a streamed image that is in memory
+
+// Runs on the GL thread. Decodes bands of a streamed image into its texture on slot, from row on, until budget_ms
+// is used up (0: to the end). Texture storage must be allocated. Returns the next row, -1 if the jpg is corrupt.
+static int stream_rows(DecodedImage &img, int slot, int row, float budget_ms) {
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const size_t pitch = (size_t)img.width * bytes_per_pixel(img.format, img.type);
+    g_stream_band.resize(pitch * STREAM_BAND_ROWS); // same size for every image on the same display, allocated once
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(GL_TEXTURE0 + slot);
+    while (row < img.height) {
+        const int rows = img.stream->read_rows(g_stream_band.data(), STREAM_BAND_ROWS);
+        if (rows <= 0) return -1;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, img.width, rows, img.format, img.type, g_stream_band.data());
+        row += rows;
+
+        if (budget_ms > 0 && (SDL_GetPerformanceCounter() - start) / 1000000.0f >= budget_ms) break; //nanoseconds to milliseconds
+    }
+    return row;
+}
+#endif
+
+
+// Runs on the GL thread. slot 0 = tex0, 1 = tex1, chroma planes go to texture units 2+slot and 4+slot.
+// Everything in one glTexImage2D per plane, streamed images are decoded a band at a time right after.
+// has_storage: the textures already have the right size and format, the pixels go in with glTexSubImage2D.
+// Returns false if a streamed jpg turns out corrupt.
+static bool upload_image(DecodedImage &img, int slot, bool has_storage) {
+    bool success = true;
     {
         #ifdef DEBUG
             ScopedTimer timer("uploaded to GPU"); 
         #endif
-        
-        if (!pixeldata || width <= 0 || height <= 0) {
-            SDL_Log("Invalid decoded data for GL upload ptr:%d w:%d h:%d", pixeldata, width, height);
-            return false;
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // avoid padding issues, scaled and chroma widths are not always a multiple of 4
+
+        for (int i = 0; i < plane_count(img); i++) {
+            glActiveTexture(GL_TEXTURE0 + slot + 2*i); // bind texture unit, texture is already bound inside it
+            const unsigned char *pixels = is_streamed(img) ? nullptr : img.pixeldata + plane_offset(img, i);
+            if (is_compressed(img)) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, 0, img.format, img.width, img.height, 0, img.pixeldata_len, pixels);
+            } else if (!has_storage) {
+                glTexImage2D(GL_TEXTURE_2D, 0, plane_format(img), plane_width(img, i), plane_height(img, i), 0, 
+                             plane_format(img), plane_type(img), pixels);
+            } else if (pixels) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_width(img, i), plane_height(img, i), plane_format(img), plane_type(img), pixels);
+            }
         }
+#ifdef USE_STREAMING_DECODE
+        if (img.stream) success = stream_rows(img, slot, 0, 0.0f) == img.height;
+#endif
+        set_slot_layout(img, slot);
+    }
+    log_peak_rss(img);
+    return success;
+}
+
+
+// Check that glTexSubImage2D really updates a texture: on some RPi drivers it does not. 
+// Writes one texel of a scratch texture and reads it back through a framebuffer.
+static bool texsubimage_works() {
+    GLint prev_unit;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &prev_unit);
+    glActiveTexture(GL_TEXTURE7); // not used by the shader
 
-        glActiveTexture(texture_unit); // bind texture unit, texture is already bound inside it
-        //glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // avoid padding issues
-        glTexImage2D(GL_TEXTURE_2D, 0, LOADER_GL_PIXEL_FORMAT, width, height, 0, LOADER_GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, pixeldata); //glTexSubImage2D does not work on RPi
+    GLuint tex, fbo;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    const unsigned char zeros[4*4*4] = {0};
+    const unsigned char texel[4] = {255, 128, 64, 255};
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 4, 4, 0, GL_RGBA, GL_UNSIGNED_BYTE, zeros);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 2, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
 
-        _free_pixeldata(pixeldata, pixeldata_len);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+
+    bool works = false;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        unsigned char readback[4] = {0};
+        glReadPixels(2, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, readback);
+        works = readback[0] > 200 && readback[1] > 100 && readback[1] < 160 && readback[2] > 40 && readback[2] < 90;
     }
 
-    return true;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+    glActiveTexture(prev_unit);
+    while (glGetError() != GL_NO_ERROR) {} // do not leave errors from the probe around
+
+    return works;
 }
 
 
 
-ImageLoader::ImageLoader(const std::string& path) : folder_path(path) { 
+#ifdef USE_RGB565
+#define RGB565_CONVERSION_BUFFERS 1
+#else
+#define RGB565_CONVERSION_BUFFERS 0
+#endif
+
+#ifdef USE_PREEMPTIBLE_DECODE
+#define PARKED_DECODE_BUFFERS 1
+#else
+#define PARKED_DECODE_BUFFERS 0
+#endif
+
+// Streamed images are never decoded into memory, there are only files to keep around
+static ImageCacheConfig loader_cache_config(ImageCacheConfig config) {
+#ifdef USE_STREAMING_DECODE
+    config.decoded_frames = 0;
+#endif
+    return config;
+}
+
+
+ImageLoader::ImageLoader(const std::string& path, int display_width, int display_height, const ImageCacheConfig &cache_config, const SidecarConfig &sidecar_config, int decode_threads, const std::string &quarantine_file, const std::string &catalog_file, const std::string &state_file_path) : 
+    folder_path(path), display_w(display_width), display_h(display_height), img_files(path), watcher(path), 
+    // decoded frames: the cached ones, one being decoded and one waiting for upload. 
+    // 1.5x the display covers 4:3 and 3:2 photos scaled to cover a 16:9 screen.
+    // With USE_RGB565 one more holds the converted copy of the frame being decoded, with USE_PREEMPTIBLE_DECODE one
+    // more an interrupted decode.
+    pixel_pool((size_t)display_width * display_height * 3 * 3 / 2, loader_cache_config(cache_config).decoded_frames + 2 + RGB565_CONVERSION_BUFFERS + PARKED_DECODE_BUFFERS),
+    // files: the raw window plus the one being read. 1 byte per pixel is plenty for a display sized jpg.
+    file_pool((size_t)display_width * display_height, 3 * cache_config.raw_neighbors + 2),
+    cache(loader_cache_config(cache_config)),
+    sidecars(sidecar_config, display_width, display_height),
+    catalog(catalog_file, path),
+    quarantine(quarantine_file, catalog),
+    state_file(state_file_path)
+{ 
     init_success = true;
+    g_pixel_pool = &pixel_pool;
+
+#ifdef USE_V4L2
+    decoders.add(std::make_unique<V4L2Decoder>());
+#endif
+#ifdef USE_MMAL
+    decoders.add(std::make_unique<MmalDecoder>());
+#endif
+#ifdef USE_TURBO_JPEG
+    decoders.add(std::make_unique<TurboJpegDecoder>(decode_threads));
+#endif
+#ifdef USE_STB_IMAGE
+    decoders.add(std::make_unique<StbDecoder>());
+#endif
+#ifdef USE_QOI
+    decoders.add(std::make_unique<QoiDecoder>());
+#endif
+    const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+    etc1_supported = extensions && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture");
+    if (!etc1_supported) SDL_Log("ETC1 textures are not supported here, showing jpgs instead of .pkm/.ktx files");
+
+    if (!decoders.select()) { init_success = false; return; }
+    loaded_event_type = SDL_RegisterEvents(1); // before the scanner starts, it pushes one too
+
+    texsubimage_supported = texsubimage_works();
+    if (!texsubimage_supported) SDL_Log("glTexSubImage2D does not work here, uploading every image in a single call");
+#ifdef USE_STREAMING_DECODE
+    stream_jpgs = texsubimage_supported; // bands go in with glTexSubImage2D, otherwise jpgs are decoded whole
+#endif
+
+#ifdef USE_RGB565
+    // SDL_GL_window allocated both textures at the display size in RGB565, every frame fits them as they are
+    for (int slot = 0; slot < 2; slot++) texture_shapes[slot] = { GL_RGB, GL_UNSIGNED_SHORT_5_6_5, display_w, display_h };
+#endif
 
-    if (!_init_img_loader()) { init_success = false; return; }
-    if (!load_file_list()) { init_success = false; return; }
-    if (!load_image(img_files[0], GL_TEXTURE0)) { init_success = false; return; }
+    // first image is loaded synchronously, there is nothing to show in the meantime anyway. Broken files are skipped.
+    // The one shown last before a restart comes first, then the list of the catalog, and only then the folder is
+    // listed: the first image that loads is shown. Unless the catalog was listed already, the rest of the list
+    // comes from it or from a scan of the folder in the background.
+    bool shown = false;
+    const std::filesystem::path last_shown = read_last_shown(state_file);
+    const bool in_folder = !last_shown.empty() && last_shown.parent_path() / "" == std::filesystem::path(folder_path) / "";
+    if (in_folder && is_listed_type(last_shown) && load_first_image(last_shown.string())) {
+        shown = true;
+        first_image_source = "last shown";
+    }
+
+    std::vector<std::string> listed;
+    const bool from_catalog = !shown && list_from_catalog(listed);
+    if (from_catalog) apply_file_list(listed);
+    for (size_t i = 0; from_catalog && !shown && i < img_files.size(); i++) {
+        shown = load_first_image(img_files.path(i));
+        if (shown) first_image_source = "catalog";
+    }
+    if (!from_catalog && !shown && find_first_image()) {
+        shown = true;
+        first_image_source = "first found";
+    }
+    if (!shown) {
+        SDL_Log("No image in %s could be loaded", folder_path.c_str());
+        init_success = false;
+        return;
+    }
+    if (!from_catalog) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            img_files.assign({ tex_loaded_filenames[0] });
+            resize_order();
+        }
+        scanner = std::thread(&ImageLoader::scan_in_background, this);
+    }
+
+    prefetch_center = tex_loaded_filenames[0];
+    prefetch_pending = true;
+    index_pending = sidecars.enabled();
+
+    worker = std::thread(&ImageLoader::worker_loop, this);
+}
+
+ImageLoader::~ImageLoader() { 
+    if (scanner.joinable()) scanner.join();
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop_worker = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+    result = nullptr;
+    uploading = nullptr;
+#ifdef USE_PREEMPTIBLE_DECODE
+    parked_job = nullptr;
+#endif
+    release_import(0);
+    release_import(1);
+    cache.retain({}, {});
+    g_pixel_pool = nullptr;
 }
 
-ImageLoader::~ImageLoader() { _loader_cleanup(); }
+
+static bool is_image_file(const std::string &extension) {
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".qoi";
+}
+
+
+// The list of the last run, if nothing was added to or removed from the folder since: no scan at all.
+// The images in it are checked as they are read, like any other time. Any thread.
+bool ImageLoader::list_from_catalog(std::vector<std::string> &paths_out) {
+    std::vector<std::string> paths;
+    if (!catalog.list(paths) || paths.empty()) return false;
+    for (const auto &path : paths) {
+        if (!is_listed_type(path)) return false; // ETC1 support changed, which files are shown changes too
+    }
+#ifdef DEBUG
+    SDL_Log("%zu files from the catalog, the folder did not change", paths.size());
+#endif
+    paths_out.swap(paths);
+    return true;
+}
+
+
+// by the extension, the decoder is picked by the contents later, see DecoderRegistry. README compares the formats.
+bool ImageLoader::is_listed_type(const std::filesystem::path &path) {
+    return is_image_file(path.extension().string()) || (etc1_supported && etc1_is_file(path.string()));
+}
 
 
 bool ImageLoader::load_file_list() {
-    namespace fs = std::filesystem;
     std::vector<std::string> imgs_found;
+    if (!scan_folder(imgs_found)) return false;
+    apply_file_list(imgs_found);
+    return true;
+}
+
+
+// Any thread, touches nothing but the folder
+bool ImageLoader::scan_folder(std::vector<std::string> &imgs_found) {
+    namespace fs = std::filesystem;
+    std::set<std::string> etc1_found; // stems
     try {
         if (fs::exists(folder_path) && fs::is_directory(folder_path)) {
             for (const auto& entry : fs::directory_iterator(folder_path)) {
-                //jpgs load in 1.4-1.6 seconds, pngs in 1.0-1.2 seconds but take much more space in filesystem
-                if (entry.is_regular_file() && entry.path().extension().string() == ".jpg") 
+                if (!entry.is_regular_file()) continue;
+                if (is_listed_type(entry.path())) 
                 {
                     imgs_found.push_back(entry.path().string());
+                    if (etc1_is_file(entry.path().string())) etc1_found.insert((entry.path().parent_path() / entry.path().stem()).string());
 #ifdef DEBUG
                     SDL_Log("found: %s", entry.path().string().c_str());
 #endif
                 }
             }
         }
+
+        // a jpg with an ETC1 copy (see etc1_encode.cpp) is shown through the copy, unless the jpg changed since
+        auto replaced = [&](const std::string &path) {
+            const fs::path p(path);
+            const std::string stem = (p.parent_path() / p.stem()).string();
+            if (p.extension() != ".jpg" || !etc1_found.count(stem)) return false;
+            std::error_code ec;
+            for (const char *ext : { ".pkm", ".ktx" }) {
+                const fs::path copy = stem + ext;
+                if (fs::exists(copy, ec) && fs::last_write_time(copy, ec) >= fs::last_write_time(p, ec)) return true;
+            }
+            return false;
+        };
+        auto stale = [&](const std::string &path) {
+            const fs::path p(path);
+            if (!etc1_is_file(path)) return false;
+            std::error_code ec;
+            const fs::path jpg = (p.parent_path() / p.stem()).string() + ".jpg";
+            return fs::exists(jpg, ec) && fs::last_write_time(p, ec) < fs::last_write_time(jpg, ec);
+        };
+        imgs_found.erase(std::remove_if(imgs_found.begin(), imgs_found.end(), 
+                                        [&](const std::string &path) { return replaced(path) || stale(path); }), imgs_found.end());
     } catch (const fs::filesystem_error& e) {
         SDL_Log("Filesystem error: %s", e.what());
         return false;
@@ -148,61 +1029,655 @@ bool ImageLoader::load_file_list() {
         SDL_Log("No files found in %s", folder_path.c_str());
         return false;
     }
+    return true;
+}
 
-    img_files = imgs_found;
+
+void ImageLoader::apply_file_list(const std::vector<std::string> &imgs_found) {
+    {
+        std::lock_guard<std::mutex> lock(mutex); // the worker may be walking the list right now
+        img_files.assign(imgs_found);
+        resize_order();
+        index_cursor = 0; // new files get a sidecar too
+        index_pending = sidecars.enabled();
+    }
+    cv.notify_one();
+    catalog.set_files(imgs_found);
+#ifdef DEBUG
+    SDL_Log("%zu files, the index takes %zu bytes", img_files.size(), img_files.memory_bytes());
+#endif
     //NOTE: back_texture_file_idx is now in an invalid state. but since it is read only at FADE_DONE, and 
     // FADE_DONE also invalidates new_image_loaded_since_fade, a new back_texture_file_idx will get assigned anyway.
+}
+
+
+// Constructor only. Reads path and uploads it to texture 0. A streamed jpg that turns out corrupt halfway through the
+// upload is quarantined like one that does not decode at all, and the caller goes on with the next file.
+bool ImageLoader::load_first_image(const std::string &path) {
+    DecodedImagePtr img;
+    if (!read_image(path, nullptr, img, false)) return false;
+    const bool uploaded = upload_image(*img, 0, has_storage_for(*img, 0));
+    for (int i = 0; i < plane_count(*img); i++) // the storage is allocated even if the upload failed halfway
+        texture_shapes[2*i] = { plane_format(*img), plane_type(*img), plane_width(*img, i), plane_height(*img, i) };
+    if (!uploaded) {
+        SDL_Log("Failed to decode %s, skipping it", path.c_str());
+        quarantine.add(path);
+        return false;
+    }
+    tex_loaded_filenames[0] = path;
     return true;
 }
 
 
-int ImageLoader::get_file_idx(const std::string &path) {
-    auto pos = std::find(img_files.begin(), img_files.end(), path);
-    return pos != img_files.end() ? std::distance(img_files.begin(), pos) : 0;
+// Startup without a catalog: the first file of the folder that loads, without listing the rest of it first
+bool ImageLoader::find_first_image() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (fs::directory_iterator it(folder_path, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec) || !is_listed_type(it->path())) continue;
+        if (load_first_image(it->path().string())) return true;
+    }
+    return false;
 }
 
 
-bool ImageLoader::load_image_to_back_texture(int file_idx) {
-    std::string path = img_files[file_idx];
+// Runs on the scanner thread, finish_scan applies the result on the GL thread
+void ImageLoader::scan_in_background() {
+    std::vector<std::string> imgs_found;
+    const bool ok = list_from_catalog(imgs_found) || scan_folder(imgs_found);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scan_result = std::move(imgs_found);
+        scan_ok = ok;
+    }
+    scan_done = true;
+    push_loaded_event(loaded_event_type); // wakes the GL thread to apply the list, see IdleWait
+}
+
 
-    bool success = load_image(path, current_active_texture == 1 ? GL_TEXTURE0 : GL_TEXTURE1);
-    if (success) {
-        tex_loaded_filenames[!current_active_texture] = path;
-        new_image_loaded = true;
+// GL thread. Until the scan is done the list only holds the first image, folder changes wait in the watcher's queue.
+void ImageLoader::finish_scan() {
+    scanner.join();
+    scan_done = false;
+    std::vector<std::string> imgs_found;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        imgs_found = std::move(scan_result);
+        ok = scan_ok;
     }
-    return success;
+    if (ok) apply_file_list(imgs_found);
+    SDL_Log("Listed %s in the background: %zu files", folder_path.c_str(), img_files.size());
 }
 
 
-bool ImageLoader::load_next_image() { //search forwards until an image can be loaded
-    int curr_file_idx = get_file_idx(tex_loaded_filenames[current_active_texture]);
+// O(changes) instead of a walk over the whole folder. ETC1 files and jpgs that have an ETC1 copy replace each other
+// depending on their mtimes (see load_file_list), changes to those are rare enough to just scan the folder again.
+bool ImageLoader::update_file_list() {
+    if (scan_done) finish_scan();
+    if (scanner.joinable()) return true; // still scanning, the changes are applied once it is done
 
-    bool success = false;
-    int attempts = 0;
-    while (!success && attempts < img_files.size()) {
-        success = load_image_to_back_texture((curr_file_idx+1+attempts)%img_files.size());
-        attempts++;
+    std::vector<FolderWatcher::Change> changes;
+    if (!watcher.read_changes(changes)) {
+#ifdef DEBUG
+        SDL_Log("not watching %s (inotify queue overflow, or the folder was replaced), scanning it", folder_path.c_str());
+#endif
+        return load_file_list();
     }
-    
-    return success;
+    if (changes.empty()) return true;
+
+    namespace fs = std::filesystem;
+    std::unordered_map<std::string, bool> updates; // path, added: the last change to a file counts
+    for (const auto &change : changes) {
+        const fs::path path = fs::path(folder_path) / change.name;
+        if (!is_listed_type(path)) continue;
+        if (etc1_supported) {
+            const std::string stem = (path.parent_path() / path.stem()).string();
+            std::error_code ec;
+            if (etc1_is_file(path.string()) || fs::exists(stem + ".pkm", ec) || fs::exists(stem + ".ktx", ec)) return load_file_list();
+        }
+        updates[path.string()] = change.added;
+    }
+
+    std::vector<std::string> added, removed;
+    for (const auto &update : updates) (update.second ? added : removed).push_back(update.first);
+    if (added.empty() && removed.empty()) return true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex); // the worker may be walking the list right now
+        if (!img_files.update(added, removed)) return true;
+        resize_order();
+        index_cursor = 0; // new files get a sidecar too, the checked ones are skipped quickly
+        index_pending = sidecars.enabled();
+    }
+    cv.notify_one();
+    catalog.update_files(added, removed);
+#ifdef DEBUG
+    SDL_Log("file list: %zu added, %zu removed, %zu files", added.size(), removed.size(), img_files.size());
+#endif
+    return true;
+}
+
+
+// Index (see file_at) of the file step files after path (before it if negative). If path was removed meanwhile, its
+// neighbors are the ones next to the file that followed it by name.
+int ImageLoader::neighbor_idx(const std::string &path, int step) {
+    bool listed;
+    const int pos = img_files.position(path, listed);
+    const int idx = shuffle ? order_idx(pos % img_files.size()) : pos;
+    return listed || step < 0 ? idx + step : idx + step - 1;
 }
 
 
-bool ImageLoader::load_prev_image() { //search backwards until an image can be loaded
-    int curr_file_idx = get_file_idx(tex_loaded_filenames[current_active_texture]);
+// The file at idx of the order images are shown in, wrapping around: the file list itself, or shuffle_order over it.
+// The GL thread, or mutex must be held.
+std::string ImageLoader::file_at(int idx) {
+    const int n = img_files.size();
+    const int i = (idx % n + n) % n;
+    return img_files.path(shuffle ? shuffle_order.position(i) : i);
+}
+
 
+// Back from a position in img_files to an index of file_at
+int ImageLoader::order_idx(int pos) {
+    return shuffle ? shuffle_order.step(pos) : pos;
+}
+
+
+// GL thread with mutex held, after img_files changed
+void ImageLoader::resize_order() {
+    if (shuffle_order.size() != img_files.size()) shuffle_order.set_size(img_files.size());
+}
+
+
+void ImageLoader::set_shuffle(uint64_t seed) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shuffle = true;
+        shuffle_order = ShuffleOrder(seed);
+        shuffle_order.set_size(img_files.size());
+        prefetch_pending = true; // the neighbors are other files now
+    }
+    cv.notify_one();
+}
+
+
+// GL thread. Small libraries go round in fewer steps than this remembers, nothing counts as recent there.
+bool ImageLoader::shown_recently(const std::string &path) {
+    if (img_files.size() <= 2 * SHUFFLE_RECENT) return false;
+    const size_t name_hash = std::hash<std::string>()(path);
+    return std::find(std::begin(recent_shown), std::end(recent_shown), name_hash) != std::end(recent_shown);
+}
+
+
+void ImageLoader::request_load(int start_idx, int step, LoadPriority priority, bool preview) {
+    request_pending = true;
+    new_image_loaded = false; // back texture is going to be overwritten
+    uploading = nullptr; // abandon a half uploaded image
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request.start_idx = start_idx;
+        request.step = step;
+        request.priority = priority;
+        request.preview = preview;
+        request.generation++; // supersedes whatever the worker is doing
+
+        // decoded frame already cached: hand it over right away, even if the worker is busy prefetching
+        const std::string path = file_at(start_idx);
+        if (DecodedImagePtr hit = cache.find_decoded(path)) {
+            cache.count_decoded_hit();
+            served_generation = request.generation;
+            publish_result(hit, true, step);
+        } else if (priority == LoadPriority::USER) {
+            preempt = true; // background decodes stop at the next band, serve_request clears it
+        }
+    }
+    cv.notify_one();
+}
+
+
+void ImageLoader::load_next_image(LoadPriority priority, bool preview) { //search forwards until an image can be loaded
+    int idx = neighbor_idx(tex_loaded_filenames[current_active_texture], 1);
+    for (int skipped = 0; shuffle && priority == LoadPriority::BACKGROUND && skipped < SHUFFLE_RECENT; skipped++) {
+        if (!shown_recently(file_at(idx))) break;
+        idx++;
+    }
+    request_load(idx, 1, priority, preview);
+}
+
+
+void ImageLoader::load_prev_image(LoadPriority priority, bool preview) { //search backwards until an image can be loaded
+    request_load(neighbor_idx(tex_loaded_filenames[current_active_texture], -1), -1, priority, preview);
+}
+
+
+// mutex must be held
+void ImageLoader::publish_result(DecodedImagePtr img, bool success, int step) {
+    result = img;
+    result_generation = request.generation;
+    result_success = success;
+    result_ready = true;
+
+    if (success) { // move the prefetch window
+        prefetch_center = img->path;
+        prefetch_dir = step;
+        prefetch_failed.clear();
+    }
+    prefetch_pending = true;
+}
+
+
+void ImageLoader::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        cv.wait(lock, [this] { return stop_worker || request.generation != served_generation || prefetch_pending || index_pending; });
+        if (stop_worker) break;
+
+        if (request.generation != served_generation) {
+            serve_request(lock);
+        } else if (prefetch_pending) {
+            if (!prefetch_step(lock)) prefetch_pending = false; // window is complete, sleep until something moves it
+        } else if (!index_step(lock)) {
+            index_pending = false; // every image has a sidecar
+        }
+    }
+}
+
+
+// mutex must be held, it is released while reading and decoding
+void ImageLoader::serve_request(std::unique_lock<std::mutex> &lock) {
+    const LoadRequest req = request;
+    served_generation = req.generation;
+    preempt = false; // this is the newest request, a USER one from now on interrupts it (if it is background work)
+    const int num_files = img_files.size();
+
+    DecodedImagePtr img;
     bool success = false;
-    int attempts = 0;
-    while (!success && attempts < img_files.size()) {
-        success = load_image_to_back_texture((curr_file_idx+img_files.size()-1-attempts)%img_files.size());
-        attempts++;
+    for (int attempts = 0; attempts < num_files && !success; attempts++) {
+        if (stop_worker || request.generation != req.generation) return; // superseded, nobody wants this image anymore
+        if (img_files.empty()) break;
+
+        std::string path = file_at(req.start_idx + req.step*attempts);
+
+        if ((img = cache.find_decoded(path))) {
+            cache.count_decoded_hit();
+            success = true;
+            break;
+        }
+
+        FileBufferPtr buf = cache.find_raw(path);
+        if (buf) cache.count_raw_hit();
+        else cache.count_miss();
+
+        lock.unlock(); // decode without holding the lock, the GL thread must never wait for us
+        DecodedImagePtr preview;
+        const bool previewed = req.preview && read_preview(path, buf, preview);
+        if (previewed) {
+            lock.lock();
+            if (stop_worker || request.generation != req.generation) return;
+            publish_result(std::move(preview), true, req.step); // a full frame that is ready first replaces it unseen
+            push_loaded_event(loaded_event_type);
+            lock.unlock();
+        }
+        success = read_image(path, buf, img, req.priority == LoadPriority::BACKGROUND);
+        lock.lock();
+
+        // a streamed frame is only decoded while it is uploaded, so it must not replace the preview before that is shown
+        if (previewed && success && is_streamed(*img)) 
+            cv.wait(lock, [&] { return stop_worker || request.generation != req.generation || !result_ready; });
+
+        if (success && !is_streamed(*img)) cache.insert_decoded(path, img, decoded_size(*img));
     }
-    
-    return success;
+
+    if (stop_worker || request.generation != req.generation) return;
+
+    publish_result(img, success, req.step);
+    push_loaded_event(loaded_event_type);
+}
+
+
+// Files around prefetch_center in priority order: first the next one in the navigation direction, 
+// then the center itself, then two steps ahead for every step behind.
+// mutex must be held
+std::vector<std::string> ImageLoader::prefetch_window(int ahead, int behind, size_t max_entries) {
+    std::vector<std::string> window;
+    const int n = img_files.size();
+    if (n == 0) return window;
+
+    const int center_pos = img_files.find(prefetch_center);
+    if (center_pos < 0) return window;
+    const int center = order_idx(center_pos);
+
+    auto add = [&](int offset) {
+        const std::string path = file_at(center + offset*prefetch_dir);
+        if (window.size() < max_entries && std::find(window.begin(), window.end(), path) == window.end())
+            window.push_back(path);
+    };
+
+    int a = 1, b = 0;
+    while ((a <= ahead || b <= behind) && window.size() < max_entries && window.size() < (size_t)n) {
+        if (a <= ahead) add(a++);
+        if (b <= behind) add(-b++);
+        if (a <= ahead) add(a++);
+    }
+    return window;
+}
+
+
+// Fetch one missing entry of the window. Returns false when there is nothing left to do.
+// mutex must be held, it is released while reading and decoding
+bool ImageLoader::prefetch_step(std::unique_lock<std::mutex> &lock) {
+    const int k = cache.cfg.raw_neighbors, m = cache.cfg.decoded_frames;
+    std::vector<std::string> wanted_decoded = prefetch_window(m, m, m);
+    std::vector<std::string> wanted_raw = prefetch_window(2*k, k, 3*k + 1);
+    cache.retain(wanted_decoded, wanted_raw);
+#ifdef USE_PREEMPTIBLE_DECODE
+    // an interrupted decode goes on below if its image is still wanted, otherwise its rows are thrown away
+    if (parked_job && std::find(wanted_decoded.begin(), wanted_decoded.end(), parked_job->path) == wanted_decoded.end()) {
+    #ifdef DEBUG
+        SDL_Log("dropping the interrupted decode of %s", parked_job->path.c_str());
+    #endif
+        parked_job = nullptr;
+    }
+#endif
+
+    std::string path;
+    bool decode = false;
+    for (const auto &p : wanted_decoded) {
+        if (!cache.has_decoded(p) && !prefetch_failed.count(p)) { path = p; decode = true; break; }
+    }
+    if (path.empty()) {
+        for (const auto &p : wanted_raw) {
+            if (!cache.has_raw(p) && !cache.has_decoded(p) && !prefetch_failed.count(p)) { path = p; break; }
+        }
+    }
+    if (path.empty()) return false;
+
+    FileBufferPtr buf = cache.find_raw(path);
+    const std::string center = prefetch_center;
+
+    lock.unlock();
+    DecodedImagePtr img;
+    bool success;
+    if (decode) {
+        success = read_image(path, buf, img, true);
+    } else if (sidecars.is_fresh(path) || quarantine.contains(path)) {
+        success = false; // mapping the sidecar later is as quick as having the jpg in memory, skip it
+    } else {
+        if (!buf) buf = load_file(path, file_pool, true);
+        success = buf != nullptr;
+    }
+    lock.lock();
+
+    if (center != prefetch_center) return true; // window moved while we were busy, start over
+    if (!success && is_parked(path)) return true; // interrupted by a USER request, goes on later if still wanted
+
+    bool cached = false;
+    if (success) cached = decode ? !is_streamed(*img) && cache.insert_decoded(path, img, decoded_size(*img)) : cache.insert_raw(path, buf);
+    if (!cached) prefetch_failed.insert(path); // undecodable, over budget or not needed
+    return true;
+}
+
+
+// Idle work: write the sidecar of one image that does not have a valid one. Returns false when every image has one.
+// Runs only when there is no request and the prefetch window is complete, a new request waits for one image at most.
+// mutex must be held, it is released while decoding and writing
+bool ImageLoader::index_step(std::unique_lock<std::mutex> &lock) {
+    if (!sidecars.enabled()) return false;
+
+    while (index_cursor < img_files.size() && img_files.checked(index_cursor)) index_cursor++;
+    if (index_cursor >= img_files.size()) return false;
+
+    const std::string path = img_files.path(index_cursor);
+    img_files.set_checked(index_cursor, true);
+    DecodedImagePtr img = cache.find_decoded(path); // prefetched frames need no decode
+
+    lock.unlock();
+    if (!etc1_is_file(path) && !sidecars.is_fresh(path) && !quarantine.contains(path)) { // ETC1 files map as quickly as a sidecar
+        FileBufferPtr buf;
+        if (!img) {
+            buf = load_file(path, file_pool, false);
+            if (!buf || !decode_image(path, buf, img, true)) {
+                if (buf) quarantine_if_broken(path);
+                img = nullptr;
+            }
+        }
+        if (img) store_sidecar(sidecars, path, *img);
+#ifdef DEBUG
+        if (img) SDL_Log("indexed %s", path.c_str());
+#endif
+    }
+    lock.lock();
+    const int pos = img_files.find(path); // the list may have changed meanwhile
+    if (!img && is_parked(path) && pos >= 0) img_files.set_checked(pos, false); // interrupted, try again later
+    return true;
+}
+
+
+bool ImageLoader::update() {
+    if (scan_done) finish_scan();
+    if (uploading) {
+        continue_upload();
+        return true;
+    }
+
+    DecodedImagePtr img;
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!result_ready) return true;
+
+        img = result;
+        success = result_success;
+        result = nullptr;
+        result_ready = false;
+
+        if (result_generation != request.generation) return true; // a newer request is already queued
+    }
+    if (img && img->preview) cv.notify_one(); // the worker may hold the full frame back until now
+
+    if (!success) {
+        request_pending = false;
+        return false;
+    }
+
+    begin_upload(img);
+    return true;
+}
+
+
+void ImageLoader::begin_upload(DecodedImagePtr img) {
+    const int slot = !current_active_texture;
+    release_import(slot); // the back texture gets new storage either way
+
+#ifdef USE_V4L2
+    if (void *image = import_dmabuf(*img, slot)) {
+        imported[slot] = img;
+        imported_image[slot] = image;
+        texture_shapes[slot] = {}; // storage belongs to the image now, the next upload reallocates it
+        set_slot_layout(*img, slot);
+        upload_stats.last_upload_ms = 0.0f;
+        uploading = img;
+        finish_upload();
+        return;
+    }
+#endif
+
+    if (!texsubimage_supported || upload_budget_ms <= 0 || is_compressed(*img)) { // ETC1 allows no partial updates, and is small anyway
+        const bool uploaded = upload_image(*img, slot, has_storage_for(*img, slot));
+        for (int i = 0; i < plane_count(*img); i++) 
+            texture_shapes[slot + 2*i] = { plane_format(*img), plane_type(*img), plane_width(*img, i), plane_height(*img, i) };
+        uploading = img;
+        if (uploaded) finish_upload();
+        else skip_failed_upload();
+        return;
+    }
+
+    uploading = img;
+    upload_plane = 0;
+    upload_row = 0;
+    upload_start = SDL_GetPerformanceCounter();
+
+    // (re)allocate storage only if the size changed, the strips then go in with glTexSubImage2D
+    if (!has_storage_for(*img, slot)) {
+        for (int i = 0; i < plane_count(*img); i++) {
+            const TextureShape shape = { plane_format(*img), plane_type(*img), plane_width(*img, i), plane_height(*img, i) };
+            glActiveTexture(GL_TEXTURE0 + slot + 2*i);
+            glTexImage2D(GL_TEXTURE_2D, 0, shape.format, shape.width, shape.height, 0, shape.format, shape.type, nullptr);
+            texture_shapes[slot + 2*i] = shape;
+        }
+    }
+    set_slot_layout(*img, slot);
+}
+
+
+// true if the textures of slot are allocated with the size and format of every plane of img.
+// Only then can pixels go in with glTexSubImage2D, which has to work here.
+bool ImageLoader::has_storage_for(const DecodedImage &img, int slot) {
+    if (!texsubimage_supported || is_compressed(img)) return false;
+    for (int i = 0; i < plane_count(img); i++) {
+        const TextureShape &allocated = texture_shapes[slot + 2*i];
+        if (allocated.format != plane_format(img) || allocated.type != plane_type(img) || 
+            allocated.width != plane_width(img, i) || allocated.height != plane_height(img, i)) return false;
+    }
+    return true;
+}
+
+
+// Upload strips until the frame budget is used up. Streamed images are decoded a band at a time on the way.
+void ImageLoader::continue_upload() {
+    DecodedImage &img = *uploading;
+    const int slot = !current_active_texture;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    bool failed = false;
+
+#ifdef USE_STREAMING_DECODE
+    if (img.stream) {
+        upload_row = stream_rows(img, slot, upload_row, upload_budget_ms);
+        failed = upload_row < 0;
+        if (upload_row >= img.height) upload_plane = 1;
+    }
+#endif
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    while (!is_streamed(img) && upload_plane < plane_count(img)) {
+        const GLenum format = plane_format(img), type = plane_type(img);
+        const int w = plane_width(img, upload_plane), h = plane_height(img, upload_plane);
+        const int rows = std::min(UPLOAD_STRIP_ROWS, h - upload_row);
+        const size_t pitch = (size_t)w * bytes_per_pixel(format, type);
+
+        glActiveTexture(GL_TEXTURE0 + slot + 2*upload_plane);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload_row, w, rows, format, type, 
+                        img.pixeldata + plane_offset(img, upload_plane) + upload_row * pitch);
+
+        upload_row += rows;
+        if (upload_row >= h) {
+            upload_plane++;
+            upload_row = 0;
+        }
+
+        if ((SDL_GetPerformanceCounter() - start) / 1000000.0f >= upload_budget_ms) break; //nanoseconds to milliseconds
+    }
+
+    const float step_ms = (SDL_GetPerformanceCounter() - start) / 1000000.0f;
+    upload_stats.steps++;
+    upload_stats.last_step_ms = step_ms;
+    upload_stats.max_step_ms = std::max(upload_stats.max_step_ms, step_ms);
+#ifdef DEBUG_RENDER
+    SDL_Log("upload step %.2fms", step_ms);
+#endif
+
+    if (failed) {
+        skip_failed_upload();
+    } else if (upload_plane >= plane_count(img)) {
+        upload_stats.last_upload_ms = (SDL_GetPerformanceCounter() - upload_start) / 1000000.0f;
+        log_peak_rss(img);
+        finish_upload();
+    }
+}
+
+
+// A streamed jpg turned out corrupt halfway through its upload: go on with the next file in the same direction
+void ImageLoader::skip_failed_upload() {
+    const std::string path = uploading->path;
+    int step;
+    LoadPriority priority;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        step = request.step;
+        priority = request.priority;
+    }
+    SDL_Log("Failed to decode %s, skipping it", path.c_str());
+    quarantine.add(path);
+    request_load(neighbor_idx(path, step), step, priority, false);
+}
+
+
+// Runs on the GL thread. Lets go of the frame backing the texture of slot, if it was imported.
+void ImageLoader::release_import(int slot) {
+#ifdef USE_V4L2
+    if (imported_image[slot]) g_dmabuf.destroy_image(g_dmabuf.display, imported_image[slot]);
+#endif
+    imported_image[slot] = nullptr;
+    imported[slot] = nullptr; // frees the capture buffer for the decoder
+}
+
+
+void ImageLoader::finish_upload() {
+    tex_loaded_filenames[!current_active_texture] = uploading->path;
+    tex_preview[!current_active_texture] = uploading->preview;
+    request_pending = uploading->preview; // the full frame is still being decoded
+    uploading = nullptr;
+    upload_stats.uploads++;
+    new_image_loaded = true;
+
+#ifdef DEBUG
+    SDL_Log("upload done in %.2fms, longest step %.2fms of %.2fms budget", upload_stats.last_upload_ms, upload_stats.max_step_ms, upload_budget_ms);
+#endif
 }
 
 
 void ImageLoader::switch_active_texture() {
     current_active_texture = !current_active_texture;
     new_image_loaded = false;
-}
\ No newline at end of file
+    if (!tex_preview[current_active_texture]) write_last_shown(state_file, tex_loaded_filenames[current_active_texture], catalog);
+    if (shuffle) {
+        recent_shown[recent_next] = std::hash<std::string>()(tex_loaded_filenames[current_active_texture]);
+        recent_next = (recent_next + 1) % SHUFFLE_RECENT;
+    }
+
+#ifdef DEBUG
+    ImageCacheStats stats = get_cache_stats();
+    SDL_Log("cache: %lu decoded hits, %lu raw hits, %lu misses, %d decoded + %d raw entries in %zu bytes", 
+            stats.decoded_hits, stats.raw_hits, stats.misses, stats.decoded_entries, stats.raw_entries, stats.bytes_used);
+
+    BufferPoolStats pixel_stats = pixel_pool.get_stats(), file_stats = file_pool.get_stats();
+    SDL_Log("buffer pools: pixels %lu acquires %lu heap allocations, files %lu acquires %lu heap allocations", 
+            pixel_stats.pool_acquires, pixel_stats.heap_allocations, file_stats.pool_acquires, file_stats.heap_allocations);
+
+    SidecarStats sidecar_stats = get_sidecar_stats();
+    SDL_Log("sidecars: %lu hits, %lu misses, %lu stale, %lu stored, %lu evicted, %d frames in %zu bytes", 
+            sidecar_stats.hits, sidecar_stats.misses, sidecar_stats.stale, sidecar_stats.stores, sidecar_stats.evictions, 
+            sidecar_stats.entries, sidecar_stats.bytes_used);
+    SDL_Log("quarantine: %zu files", quarantine.size());
+#endif
+}
+
+
+void ImageLoader::get_buffer_stats(BufferPoolStats &pixels, BufferPoolStats &files) {
+    pixels = pixel_pool.get_stats();
+    files = file_pool.get_stats();
+}
+
+
+SidecarStats ImageLoader::get_sidecar_stats() {
+    return sidecars.get_stats();
+}
+
+
+ImageCacheStats ImageLoader::get_cache_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.get_stats();
+}
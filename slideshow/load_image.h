@@ -1,35 +1,261 @@
 #pragma once
 
+#include "image_cache.h"
+#include "buffer_pool.h"
+#include "sidecar_cache.h"
+#include "decoder_registry.h"
+#include "quarantine.h"
+#include "folder_watcher.h"
+#include "file_index.h"
+#include "catalog.h"
+#include "shuffle.h"
+
 #include <string>
 #include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <filesystem>
+#include <cstddef>
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengles2.h>
+
+
+#ifdef USE_STREAMING_DECODE
+struct ImageStream;
+#endif
+#ifdef USE_PREEMPTIBLE_DECODE
+struct DecodeJob;
+#endif
+
+
+struct DecodedImage {
+    DecodedImage();
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+    ~DecodedImage(); // releases pixeldata through decoder, unless it points into mapping
+
+    unsigned char *pixeldata = nullptr;
+    size_t pixeldata_len = 0;
+    int width = 0, height = 0;
+    GLenum format = GL_RGB; // of packed pixels, GL_ETC1_RGB8_OES for pre-encoded ETC1 blocks
+    GLenum type = GL_UNSIGNED_BYTE; // GL_UNSIGNED_SHORT_5_6_5 for RGB565 frames, see USE_RGB565
+    int num_planes = 0; // 0: packed pixels in format, 1: luminance only, 3: Y, Cb, Cr planes back to back
+    int plane_w[3] = {0}, plane_h[3] = {0};
+    bool top_down = false; // first row is the top of the picture. Packed frames are usually stored bottom-up for GL.
+    int dmabuf_fd = -1; // set if pixeldata is also a DMABUF the GPU can import, owned by decoder
+    size_t dmabuf_offset = 0;
+    int dmabuf_pitch = 0;
+    std::string path;
+    ImageDecoder *decoder = nullptr; // the one that allocated pixeldata
+    FileBufferPtr mapping; // set if pixeldata points into a mapped sidecar, an ETC1 file or a converted frame in the pixel pool
+    bool preview = false; // decoded at a fraction of the display size for a quick first look, the full frame follows
+#ifdef USE_STREAMING_DECODE
+    // Set instead of pixeldata for jpgs that are decoded a band at a time straight into the texture, see JpegStream.
+    // Can be read only once, such an image is never cached.
+    FileBufferPtr source;
+    std::unique_ptr<ImageStream> stream; // reads from source
+#endif
+};
+
+
+struct UploadStats {
+    unsigned long uploads = 0;
+    unsigned long steps = 0;        // update() calls that uploaded something
+    float last_step_ms = 0.0f;
+    float max_step_ms = 0.0f;       // should stay around the budget
+    float last_upload_ms = 0.0f;    // first strip to last strip, including the frames in between
+};
+
+
+enum class LoadPriority {
+    BACKGROUND, // the automatic next image, jpgs are decoded a band at a time so a USER request can interrupt them
+    USER,       // arrow keys: interrupts the background decode, prefetch or sidecar write the worker is busy with
+};
 
 
 class ImageLoader {
 public:
-    ImageLoader(const std::string& path);
+    // images are decoded at the smallest size that still covers display_width x display_height, if the loader can scale
+    // decoded frames are kept on disk as sidecars, see SidecarCache
+    // decode_threads: cores a single jpg is split across (turbojpeg with USE_PARALLEL_DECODE), 0 = all of them
+    // files that fail to decode are listed in quarantine_file and skipped until they change, see Quarantine
+    // catalog_file keeps the file list and what is known about each image across restarts, see Catalog
+    // state_file remembers the image on screen, it is shown first on the next start
+    ImageLoader(const std::string& path, int display_width, int display_height, const ImageCacheConfig &cache_config, const SidecarConfig &sidecar_config, int decode_threads, const std::string &quarantine_file, const std::string &catalog_file, const std::string &state_file);
     ~ImageLoader();
     bool init_is_successful() { return init_success; }
+    // where the first image came from: "last shown", "catalog" or "first found"
+    const char *get_first_image_source() { return first_image_source; }
+    // the rest of the file list is still being listed in the background, update() picks it up
+    bool listing_in_background() { return scanner.joinable(); }
 
+    // Scan the whole folder. Keeps the previous list if the folder cannot be read or has no images.
     bool load_file_list();
+    // Apply the files that arrived in or left the folder since the last call, see FolderWatcher.
+    // Only scans the folder again if the watcher lost track of it.
+    bool update_file_list();
 
-    bool load_next_image();
-    bool load_prev_image();
+    // Go through the images in a pseudo-random order instead of by name, see ShuffleOrder. The same seed gives the
+    // same order, as long as the number of images stays the same.
+    void set_shuffle(uint64_t seed);
+
+    // Queue a decode on the worker thread, the result is uploaded by update()
+    // preview: first hand over a 1/8 scale decode that shows up in a few ms, then the full frame as a second image
+    void load_next_image(LoadPriority priority = LoadPriority::BACKGROUND, bool preview = false);
+    void load_prev_image(LoadPriority priority = LoadPriority::BACKGROUND, bool preview = false);
+    bool load_in_progress() { return request_pending; } // stays true until the full frame after a preview is loaded
     bool new_image_has_been_loaded() { return new_image_loaded; }
+    bool showing_preview() { return tex_preview[current_active_texture]; } // the full frame is on its way
+
+    // Call from the GL thread. Uploads a decoded image to the back texture once the worker is done with it.
+    // Returns false if no image in the folder could be loaded, the request is over then and the textures are untouched.
+    bool update();
+
+    // Pushed by the worker when a decoded image is ready, so the main loop can wake up
+    Uint32 get_loaded_event_type() { return loaded_event_type; }
 
     void switch_active_texture();
     float correct_fade_direction(float fade) { return current_active_texture ? (1 - fade) : fade; }
 
+    // Spread uploads over several update() calls, spending at most budget_ms per call. 0 = single glTexImage2D.
+    void set_upload_budget(float budget_ms) { upload_budget_ms = budget_ms; }
+    bool upload_in_progress() { return uploading != nullptr; }
+    UploadStats get_upload_stats() { return upload_stats; }
+
+    ImageCacheStats get_cache_stats();
+    void get_buffer_stats(BufferPoolStats &pixels, BufferPoolStats &files);
+    SidecarStats get_sidecar_stats();
+
 private:
-    int get_file_idx(const std::string &path);
-    bool load_image_to_back_texture(int file_idx);
+    int neighbor_idx(const std::string &path, int step);
+    std::string file_at(int idx);
+    int order_idx(int pos);
+    void resize_order();
+    bool shown_recently(const std::string &path);
+    bool list_from_catalog(std::vector<std::string> &paths_out);
+    bool scan_folder(std::vector<std::string> &imgs_found);
+    void apply_file_list(const std::vector<std::string> &imgs_found);
+    bool load_first_image(const std::string &path);
+    bool find_first_image();
+    void scan_in_background();
+    void finish_scan();
+    bool is_listed_type(const std::filesystem::path &path);
+    void request_load(int start_idx, int step, LoadPriority priority, bool preview);
+    void worker_loop();
+    void serve_request(std::unique_lock<std::mutex> &lock);
+    bool prefetch_step(std::unique_lock<std::mutex> &lock);
+    bool index_step(std::unique_lock<std::mutex> &lock);
+    bool read_image(const std::string &path, FileBufferPtr buf, DecodedImagePtr &img, bool preemptible);
+    void quarantine_if_broken(const std::string &path);
+    bool read_preview(const std::string &path, FileBufferPtr &buf, DecodedImagePtr &img);
+    bool decode_image(const std::string &path, const FileBufferPtr &buf, DecodedImagePtr &img, bool preemptible);
+    bool decode_frame(const std::string &path, const FileBufferPtr &buf, DecodedImagePtr &img, bool preemptible);
+    bool is_parked(const std::string &path);
+    void publish_result(DecodedImagePtr img, bool success, int step);
+    void begin_upload(DecodedImagePtr img);
+    void continue_upload();
+    void skip_failed_upload();
+    bool has_storage_for(const DecodedImage &img, int slot);
+    void finish_upload();
+    void release_import(int slot);
+    std::vector<std::string> prefetch_window(int ahead, int behind, size_t max_entries);
 
 private:
     bool init_success;
     const std::string folder_path;
-    std::vector<std::string> img_files;
+    const int display_w, display_h;
+    FileIndex img_files;                // written only by the GL thread, read by the worker under mutex
+    FolderWatcher watcher;              // started before the first scan
+    bool shuffle = false;               // indexes of requests and the prefetch window go through shuffle_order
+    ShuffleOrder shuffle_order;         // written only by the GL thread, read by the worker under mutex
+
+    DecoderRegistry decoders; // used by the worker only once it runs, must outlive every DecodedImage
 
     bool current_active_texture = 0; // 0 = tex0, 1 = tex1
     std::string tex_loaded_filenames[2]; //currently loaded filename for tex0 and tex1
+    bool tex_preview[2] = {false, false}; // tex0 or tex1 holds a preview, see DecodedImage::preview
+
+    // hashes of the last paths shown in shuffle mode, automatic steps skip them. Within one order that never happens,
+    // but the order is another one when the library grows or shrinks.
+    static constexpr int SHUFFLE_RECENT = 64;
+    size_t recent_shown[SHUFFLE_RECENT] = {};
+    int recent_next = 0;
 
     bool new_image_loaded = false;
-};
\ No newline at end of file
+    bool request_pending = false;
+
+    // strip upload state, GL thread only
+    static constexpr int UPLOAD_STRIP_ROWS = 32;
+    struct TextureShape {
+        GLenum format, type;
+        int width, height;
+    };
+    TextureShape texture_shapes[6] = {}; // what is currently allocated on texture units 0-5
+    bool texsubimage_supported = false;
+    bool etc1_supported = false; // GL_OES_compressed_ETC1_RGB8_texture, set before the worker starts
+#ifdef USE_STREAMING_DECODE
+    bool stream_jpgs = false; // needs glTexSubImage2D, set before the worker starts
+#endif
+    float upload_budget_ms = 0.0f;
+    DecodedImagePtr uploading;
+    int upload_plane = 0, upload_row = 0;
+    Uint64 upload_start = 0;
+    UploadStats upload_stats;
+    DecodedImagePtr imported[2]; // frames imported as the storage of tex0 and tex1 instead of uploaded, see DecodedImage::dmabuf_fd
+    void *imported_image[2] = {nullptr, nullptr}; // their EGLImages
+
+    // worker thread handoff, everything below is protected by mutex
+    struct LoadRequest {
+        int start_idx = 0;
+        int step = 1; // +1 searches forwards, -1 backwards
+        LoadPriority priority = LoadPriority::BACKGROUND;
+        bool preview = false;
+        unsigned int generation = 0;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop_worker = false;
+
+    LoadRequest request;
+    unsigned int served_generation = 0;
+
+    DecodedImagePtr result;
+    unsigned int result_generation = 0;
+    bool result_ready = false;
+    bool result_success = false;
+
+    BufferPool pixel_pool, file_pool; // must outlive everything holding a DecodedImage or FileBuffer
+    std::atomic<bool> preempt{false};       // set with a USER request, background decodes stop at the next band of rows
+#ifdef USE_PREEMPTIBLE_DECODE
+    std::unique_ptr<DecodeJob> parked_job;  // worker only: a background decode a USER request interrupted
+#endif
+    ImageCache cache;
+    std::string prefetch_center;            // last image handed to the GL thread, the window is built around it
+    int prefetch_dir = 1;                   // direction the user is navigating in, prefetch goes further that way
+    bool prefetch_pending = false;
+    std::set<std::string> prefetch_failed;  // do not retry these until the window moves
+
+    SidecarCache sidecars;
+    bool index_pending = false;             // some images may not have a sidecar yet
+    size_t index_cursor = 0;                // into img_files, which flags the files checked or written this run
+
+    Catalog catalog;                        // thread safe, the worker describes images, the GL thread lists them
+    Quarantine quarantine;                  // thread safe, worker and GL thread add to it. After catalog, it keeps it up to date.
+    bool decode_failed_transiently = false; // worker (and constructor): the last decode_frame failed, not because of the file
+    const std::string state_file;           // written by the GL thread whenever a full image comes on screen
+    const char *first_image_source = "";
+
+    std::thread scanner;                    // lists the folder once the first image is up, from the catalog or a scan
+    std::atomic<bool> scan_done{false};     // the GL thread picks scan_result up in finish_scan
+    std::vector<std::string> scan_result;
+    bool scan_ok = false;
+
+    Uint32 loaded_event_type = 0;
+};
@@ -15,7 +15,22 @@
 #include <cstddef>
 
 
-#define LOADER_GL_PIXEL_FORMAT GL_RGBA
+class MmalDecoder : public ImageDecoder {
+public:
+    const char *name() override { return "mmal"; }
+    bool init() override;
+    bool accepts(const unsigned char *filebuf, size_t filebuf_len) override { return is_jpeg(filebuf, filebuf_len); }
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len) override { return jpeg_header_ok(filebuf, filebuf_len); }
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) override {
+        return load(img.pixeldata, img.pixeldata_len, filebuf, filebuf_len, path, target_w, target_h, img.width, img.height);
+    }
+    void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) override;
+    bool is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) override { return true; } // VideoCore
+    GLenum pixel_format() override { return GL_RGBA; }
+
+private:
+    bool load(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height);
+};
 
 static MMAL_COMPONENT_T* decode_component = nullptr;
 static MMAL_POOL_T *input_pool = nullptr, *output_pool = nullptr;
@@ -50,7 +65,7 @@ static void control_callback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
 }
 
 
-bool _init_img_loader() {
+bool MmalDecoder::init() {
     bcm_host_init();
     vcos_semaphore_create(&semaphore, "imgloader", 1);
 
@@ -135,7 +150,7 @@ bool _init_img_loader() {
 }
 
 
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height) {
+bool MmalDecoder::load(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height) {
 
     MMAL_BUFFER_HEADER_T *in_buf, *out_buf;
 
@@ -144,7 +159,7 @@ bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const
 
     // Feed JPEG chunks into input buffers
     size_t offset = 0;
-    while (offset < filebuf_in.size()) {
+    while (offset < filebuf_len) {
 
         /* Wait for buffer headers to be available on either of the decoder ports */
         VCOS_STATUS_T vcos_status = vcos_semaphore_wait_timeout(&semaphore, 2000);
@@ -157,11 +172,11 @@ bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const
 
         MMAL_BUFFER_HEADER_T* in_buf = mmal_queue_get(input_pool->queue);
 
-        size_t chunk = std::min((size_t)in_buf->alloc_size, filebuf_in.size() - offset);
-        memcpy(in_buf->data, filebuf_in.data() + offset, chunk);
+        size_t chunk = std::min((size_t)in_buf->alloc_size, filebuf_len - offset);
+        memcpy(in_buf->data, filebuf_in + offset, chunk);
         in_buf->length = chunk;
         in_buf->offset = 0;
-        in_buf->flags = (offset + chunk == filebuf_in.size()) ? MMAL_BUFFER_HEADER_FLAG_FRAME_END : 0;
+        in_buf->flags = (offset + chunk == filebuf_len) ? MMAL_BUFFER_HEADER_FLAG_FRAME_END : 0;
 
         if (mmal_port_send_buffer(input, in_buf) != MMAL_SUCCESS) {
             mmal_buffer_header_release(in_buf);
@@ -195,8 +210,6 @@ bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const
     return true;
 }
 
-void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
+void MmalDecoder::free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
     mmal_buffer_header_release(pixeldata);
 }
-
-void _loader_cleanup() {}
\ No newline at end of file
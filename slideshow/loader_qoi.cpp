@@ -0,0 +1,123 @@
+#include <string>
+#include <algorithm>
+#include <SDL3/SDL.h>
+#include <cstddef>
+#include <cstdint>
+
+
+// QOI, "the Quite OK Image format" (https://qoiformat.org): lossless like png, but a single pass over bytes with a
+// 64 entry color cache and no entropy coding, so it decodes several times faster. Alpha is dropped.
+class QoiDecoder : public ImageDecoder {
+public:
+    const char *name() override { return "qoi"; }
+    bool init() override { return true; }
+    bool accepts(const unsigned char *filebuf, size_t filebuf_len) override;
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len) override;
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) override;
+    void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) override { _release_pixeldata(pixeldata); }
+    GLenum pixel_format() override { return GL_RGB; }
+};
+
+
+#define QOI_HEADER_SIZE 14
+#define QOI_END_SIZE 8 // 7 zero bytes and a 1
+#define QOI_MAX_SIZE 16384 // per side, more than any GLES2 texture
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+
+
+bool QoiDecoder::accepts(const unsigned char *filebuf, size_t filebuf_len) {
+    return filebuf_len >= QOI_HEADER_SIZE && filebuf[0] == 'q' && filebuf[1] == 'o' && filebuf[2] == 'i' && filebuf[3] == 'f';
+}
+
+
+static uint32_t read_be32(const unsigned char *p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+
+
+// a size we can show, and at least one op between the header and the end marker
+bool QoiDecoder::check_header(const unsigned char *filebuf, size_t filebuf_len) {
+    const uint32_t width = read_be32(filebuf + 4), height = read_be32(filebuf + 8);
+    return width > 0 && height > 0 && width <= QOI_MAX_SIZE && height <= QOI_MAX_SIZE && filebuf_len > QOI_HEADER_SIZE + QOI_END_SIZE;
+}
+
+
+// no scaling, target_w and target_h are ignored. Decodes straight into a pooled buffer.
+bool QoiDecoder::decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) {
+    if (!accepts(filebuf, filebuf_len)) return false;
+    const uint32_t width = read_be32(filebuf + 4), height = read_be32(filebuf + 8);
+    if (width == 0 || height == 0 || width > QOI_MAX_SIZE || height > QOI_MAX_SIZE) {
+        SDL_Log("Unsupported qoi size %ux%u in %s", width, height, path.c_str());
+        return false;
+    }
+
+    const size_t len = (size_t)width * height * 3;
+    unsigned char *out = _alloc_pixeldata(len);
+    if (!out) {
+        SDL_Log("Out of memory");
+        transient_failure = true;
+        return false;
+    }
+
+    struct Rgba { unsigned char r, g, b, a; };
+    Rgba index[64] = {};
+    Rgba px = { 0, 0, 0, 255 };
+
+    const unsigned char *p = filebuf + QOI_HEADER_SIZE, *end = filebuf + filebuf_len;
+    unsigned char *dst = out, *const dst_end = out + len;
+    while (dst < dst_end && p < end) {
+        const unsigned char op = *p++;
+
+        if (op >= QOI_OP_RUN) {
+            if (op == QOI_OP_RGB) {
+                if (end - p < 3) break;
+                px.r = p[0]; px.g = p[1]; px.b = p[2];
+                p += 3;
+            } else if (op == QOI_OP_RGBA) {
+                if (end - p < 4) break;
+                px = { p[0], p[1], p[2], p[3] };
+                p += 4;
+            } else { // QOI_OP_RUN: the previous pixel again, 1 to 62 times
+                index[(px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) & 63] = px; // like the reference decoder
+                const size_t run = std::min((size_t)(op & 0x3F) + 1, (size_t)(dst_end - dst) / 3);
+                for (size_t i = 0; i < run; i++) {
+                    dst[0] = px.r; dst[1] = px.g; dst[2] = px.b;
+                    dst += 3;
+                }
+                continue;
+            }
+        } else if (op < QOI_OP_DIFF) { // QOI_OP_INDEX
+            px = index[op];
+        } else if (op < QOI_OP_LUMA) { // QOI_OP_DIFF
+            px.r += ((op >> 4) & 3) - 2;
+            px.g += ((op >> 2) & 3) - 2;
+            px.b += (op & 3) - 2;
+        } else { // QOI_OP_LUMA
+            if (p >= end) break;
+            const int dg = (op & 0x3F) - 32, b2 = *p++;
+            px.r += dg - 8 + (b2 >> 4);
+            px.g += dg;
+            px.b += dg - 8 + (b2 & 0x0F);
+        }
+        index[(px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) & 63] = px;
+        dst[0] = px.r; dst[1] = px.g; dst[2] = px.b;
+        dst += 3;
+    }
+
+    if (dst < dst_end) {
+        SDL_Log("Truncated qoi file %s", path.c_str());
+        _release_pixeldata(out);
+        return false;
+    }
+
+    img.pixeldata = out;
+    img.pixeldata_len = len;
+    img.width = width;
+    img.height = height;
+    img.top_down = true; // rows are stored top first
+    return true;
+}
@@ -3,30 +3,46 @@
 #include <string>
 #include <SDL3/SDL.h>
 #include <cstddef>
+#include <cstring>
 
-#define LOADER_GL_PIXEL_FORMAT GL_RGB
+class StbDecoder : public ImageDecoder {
+public:
+    const char *name() override { return "stb_image"; }
+    bool init() override;
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len) override;
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) override;
+    void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) override;
+    GLenum pixel_format() override { return GL_RGB; }
+};
 
 
-bool _init_img_loader() {
+bool StbDecoder::init() {
     stbi_set_flip_vertically_on_load(1);
     return true;
 }
 
 
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height) {
+bool StbDecoder::check_header(const unsigned char *filebuf, size_t filebuf_len) {
+    int width, height, channels;
+    return stbi_info_from_memory(filebuf, filebuf_len, &width, &height, &channels) != 0;
+}
+
+
+// no scaling, target_w and target_h are ignored
+bool StbDecoder::decode(DecodedImage &img, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h) {
     int channels;
-    pixeldata_out = stbi_load_from_memory(filebuf_in.data(), filebuf_in.size(), &width, &height, &channels, STBI_rgb); 
-    if (!pixeldata_out) {
+    img.pixeldata = stbi_load_from_memory(filebuf_in, filebuf_len, &img.width, &img.height, &channels, STBI_rgb); 
+    if (!img.pixeldata) {
         SDL_Log("Failed to load image %s: %s", path_in.c_str(), stbi_failure_reason());
+        transient_failure = strcmp(stbi_failure_reason(), "outofmem") == 0;
         return false;
     }
+    img.pixeldata_len = (size_t)img.width * img.height * 3;
     return true;
 }
 
 
-void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
+void StbDecoder::free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
     if(pixeldata)
         stbi_image_free(pixeldata);
 }
-
-void _loader_cleanup() {}
\ No newline at end of file
@@ -6,46 +6,226 @@
 #include <SDL3/SDL.h>
 #include <cstddef>
 
+#ifdef USE_PARALLEL_DECODE
+    #include "parallel_jpeg.h"
+#endif
 
-#define LOADER_GL_PIXEL_FORMAT GL_RGB
 
-static tjhandle g_tj;
+class TurboJpegDecoder : public ImageDecoder {
+public:
+    // decode_threads: cores a single jpg is split across, 0 = all of them. Needs USE_PARALLEL_DECODE.
+    TurboJpegDecoder(int decode_threads = 1) : threads(decode_threads) {}
+    ~TurboJpegDecoder() override { if (tj) tjDestroy(tj); }
 
+    const char *name() override { return "turbojpeg"; }
+    bool init() override;
+    bool accepts(const unsigned char *filebuf, size_t filebuf_len) override { return is_jpeg(filebuf, filebuf_len); }
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len) override { return jpeg_header_ok(filebuf, filebuf_len); }
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) override;
+    bool can_scale() override { return true; } // in the IDCT, down to 1/8
+    bool is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) override;
+    void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) override { _release_pixeldata(pixeldata); }
+    GLenum pixel_format() override { return GL_RGB; }
 
-bool _init_img_loader() {
-    g_tj = tjInitDecompress();
-    return true;
+private:
+    bool load_rgb(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height);
+    bool load_yuv(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height, int &num_planes, int plane_w[3], int plane_h[3]);
+
+    tjhandle tj = nullptr;
+    int threads;
+
+#ifdef USE_PARALLEL_DECODE
+    std::unique_ptr<ParallelJpegDecoder> parallel;
+
+    #ifdef DEBUG
+        // Once per run: decode the first split image again on this thread alone, to see what the slices bought.
+        // decode_single decodes into the scratch buffer it gets.
+        template<typename F> void log_speedup(Uint64 parallel_start, size_t len, F decode_single) {
+            const float parallel_s = (SDL_GetPerformanceCounter() - parallel_start) / 1000000000.0f; //nanoseconds to seconds
+            if (speedup_logged) return;
+            speedup_logged = true;
+
+            unsigned char *scratch = (unsigned char*)malloc(len);
+            const Uint64 start = SDL_GetPerformanceCounter();
+            if (scratch && decode_single(scratch)) {
+                const float single_s = (SDL_GetPerformanceCounter() - start) / 1000000000.0f;
+                SDL_Log("parallel decode: %fs on %d threads, %fs on one, %.2fx speedup", parallel_s, parallel->get_threads(), single_s, single_s / parallel_s);
+            }
+            free(scratch);
+        }
+        bool speedup_logged = false;
+    #endif
+#endif
+};
+
+
+bool TurboJpegDecoder::init() {
+    tj = tjInitDecompress();
+#ifdef USE_PARALLEL_DECODE
+    if (tj && threads != 1) {
+        parallel = std::make_unique<ParallelJpegDecoder>(threads);
+        if (parallel->get_threads() < 2) parallel = nullptr; // single core
+    }
+#endif
+    return tj != nullptr;
+}
+
+
+bool TurboJpegDecoder::decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) {
+#ifdef USE_YUV_DECODE
+    bool success = load_yuv(img.pixeldata, img.pixeldata_len, filebuf, filebuf_len, path, target_w, target_h, img.width, img.height, img.num_planes, img.plane_w, img.plane_h);
+    img.top_down = img.num_planes > 0;
+    return success;
+#else
+    return load_rgb(img.pixeldata, img.pixeldata_len, filebuf, filebuf_len, path, target_w, target_h, img.width, img.height);
+#endif
+}
+
+
+// let the IDCT do the downscaling: pick the smallest factor that still covers the display
+static tjscalingfactor choose_scaled_size(int target_w, int target_h, int &width, int &height) {
+    tjscalingfactor best = {1, 1};
+    if (target_w <= 0 || target_h <= 0) return best;
+
+    int num_factors;
+    tjscalingfactor *factors = tjGetScalingFactors(&num_factors);
+    int best_w = width, best_h = height;
+    for (int i = 0; factors && i < num_factors; i++) {
+        int w = TJSCALED(width, factors[i]), h = TJSCALED(height, factors[i]);
+        if (w >= target_w && h >= target_h && w < best_w) { best_w = w; best_h = h; best = factors[i]; }
+    }
+    width = best_w; height = best_h;
+    return best;
+}
+
+
+// Split across the cores by ParallelJpegDecoder. Only reads the headers, and the restart markers if there are any.
+bool TurboJpegDecoder::is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) {
+#ifdef USE_PARALLEL_DECODE
+    int width, height, subsamp, colorspace;
+    if (!parallel || tjDecompressHeader3(tj, filebuf, filebuf_len, &width, &height, &subsamp, &colorspace) != 0) return false;
+    const tjscalingfactor scale = choose_scaled_size(target_w, target_h, width, height);
+    #ifdef USE_YUV_DECODE
+        return parallel->can_split(filebuf, filebuf_len, scale, true);
+    #else
+        return parallel->can_split(filebuf, filebuf_len, scale, false);
+    #endif
+#else
+    return false;
+#endif
 }
 
 
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height) {
+bool TurboJpegDecoder::load_rgb(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height) {
     int subsamp, colorspace;
-    if (tjDecompressHeader3(g_tj, filebuf_in.data(), filebuf_in.size(),
+    if (tjDecompressHeader3(tj, filebuf_in, filebuf_len,
                             &width, &height, &subsamp, &colorspace) != 0) {
         SDL_Log("TurboJPEG header read failed: %s", tjGetErrorStr());
         return false;
     }
 
-    pixeldata_out = (unsigned char*)malloc(width*height*3*sizeof(unsigned char));
+    [[maybe_unused]] const tjscalingfactor scale = choose_scaled_size(target_w, target_h, width, height);
+
+    pixeldata_len_out = width*height*3*sizeof(unsigned char);
+    pixeldata_out = _alloc_pixeldata(pixeldata_len_out);
     if (!pixeldata_out) {
         SDL_Log("Out of memory");
+        transient_failure = true;
         return false;
     }
 
-    if (tjDecompress2(g_tj, filebuf_in.data(), filebuf_in.size(),
+    const int flags = TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE | TJFLAG_BOTTOMUP;
+    bool split = false, success = false;
+#ifdef USE_PARALLEL_DECODE
+    #ifdef DEBUG
+        const Uint64 start = SDL_GetPerformanceCounter();
+    #endif
+    success = parallel && parallel->decode_rgb(filebuf_in, filebuf_len, scale, flags, pixeldata_out, width, height, split);
+    #ifdef DEBUG
+        if (success) log_speedup(start, pixeldata_len_out, [&](unsigned char *scratch) { 
+            return tjDecompress2(tj, filebuf_in, filebuf_len, scratch, width, 0, height, TJPF_RGB, flags) == 0; 
+        });
+    #endif
+#endif
+
+    if (!split) {
+        success = tjDecompress2(tj, filebuf_in, filebuf_len,
                     pixeldata_out, width, 0, height,
-                    TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE | TJFLAG_BOTTOMUP) != 0) {
-        SDL_Log("TurboJPEG decompress failed: %s", tjGetErrorStr());
-        free(pixeldata_out);
+                    TJPF_RGB, flags) == 0;
+        if (!success) SDL_Log("TurboJPEG decompress failed: %s", tjGetErrorStr());
+    }
+
+    if (!success) {
+        _release_pixeldata(pixeldata_out);
+        pixeldata_out = nullptr;
         return false;
     }
 
     return true;
 }
 
-void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
-    if(pixeldata)
-        free(pixeldata);
-}
+// Decode to planar YCbCr, no color conversion on the CPU. Planes are stored back to back (top-down) in pixeldata_out, 
+// num_planes is 1 for grayscale jpgs. JPEGs that are not YCbCr/gray are decoded to RGB instead and num_planes is 0.
+bool TurboJpegDecoder::load_yuv(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const unsigned char *filebuf_in, size_t filebuf_len, const std::string &path_in, int target_w, int target_h, int &width, int &height, int &num_planes, int plane_w[3], int plane_h[3]) {
+    int subsamp, colorspace;
+    if (tjDecompressHeader3(tj, filebuf_in, filebuf_len,
+                            &width, &height, &subsamp, &colorspace) != 0) {
+        SDL_Log("TurboJPEG header read failed: %s", tjGetErrorStr());
+        return false;
+    }
+
+    if (colorspace != TJCS_YCbCr && colorspace != TJCS_GRAY) {
+        num_planes = 0;
+        return load_rgb(pixeldata_out, pixeldata_len_out, filebuf_in, filebuf_len, path_in, target_w, target_h, width, height);
+    }
+
+    [[maybe_unused]] const tjscalingfactor scale = choose_scaled_size(target_w, target_h, width, height);
+
+    num_planes = subsamp == TJSAMP_GRAY ? 1 : 3;
+    pixeldata_len_out = 0;
+    for (int i = 0; i < num_planes; i++) {
+        plane_w[i] = tjPlaneWidth(i, width, subsamp);
+        plane_h[i] = tjPlaneHeight(i, height, subsamp);
+        pixeldata_len_out += plane_w[i] * plane_h[i];
+    }
+
+    pixeldata_out = _alloc_pixeldata(pixeldata_len_out);
+    if (!pixeldata_out) {
+        SDL_Log("Out of memory");
+        transient_failure = true;
+        return false;
+    }
+
+    unsigned char *planes[3] = {pixeldata_out, nullptr, nullptr};
+    for (int i = 1; i < num_planes; i++) planes[i] = planes[i-1] + plane_w[i-1] * plane_h[i-1];
+
+    const int flags = TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE;
+    bool split = false, success = false;
+#ifdef USE_PARALLEL_DECODE
+    #ifdef DEBUG
+        const Uint64 start = SDL_GetPerformanceCounter();
+    #endif
+    success = parallel && parallel->decode_yuv(filebuf_in, filebuf_len, scale, flags, subsamp, planes, plane_w, width, height, split);
+    #ifdef DEBUG
+        if (success) log_speedup(start, pixeldata_len_out, [&](unsigned char *scratch) {
+            unsigned char *scratch_planes[3] = {scratch, nullptr, nullptr};
+            for (int i = 1; i < num_planes; i++) scratch_planes[i] = scratch + (planes[i] - planes[0]);
+            return tjDecompressToYUVPlanes(tj, filebuf_in, filebuf_len, scratch_planes, width, nullptr, height, flags) == 0;
+        });
+    #endif
+#endif
+
+    if (!split) {
+        success = tjDecompressToYUVPlanes(tj, filebuf_in, filebuf_len,
+                    planes, width, nullptr, height, flags) == 0;
+        if (!success) SDL_Log("TurboJPEG decompress failed: %s", tjGetErrorStr());
+    }
+
+    if (!success) {
+        _release_pixeldata(pixeldata_out);
+        pixeldata_out = nullptr;
+        return false;
+    }
 
-void _loader_cleanup() {}
\ No newline at end of file
+    return true;
+}
@@ -1,16 +1,12 @@
-
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
 #include <SDL3/SDL.h>
 #include <cstddef>
+#include <cstring>
 
-
-#include <linux/videodev2.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#include <errno.h>
+#include "v4l2_device.h"
 
 // REFERENCES
 // https://github.com/raspberrypi/linux/blob/rpi-6.1.y/drivers/staging/vc04_services/bcm2835-codec/bcm2835-v4l2-codec.c#L266
@@ -20,437 +16,580 @@
 // https://www.linuxtv.org/downloads/v4l-dvb-apis/userspace-api/v4l/mmap.html#example-mapping-buffers-in-the-multi-planar-api
 // https://www.linuxtv.org/downloads/v4l-dvb-apis/userspace-api/v4l/buffer.html#v4l2-buf-flag-queued
 // https://www.linuxtv.org/downloads/v4l-dvb-apis/userspace-api/v4l/vidioc-qbuf.html#vidioc-qbuf
+// https://www.kernel.org/doc/html/latest/userspace-api/media/v4l/vidioc-expbuf.html
 // https://github.com/raspberrypi/linux/issues/3791
 // https://forums.raspberrypi.com/viewtopic.php?t=356791
 
 
-// Upload ABGR/ARGB mapped data as GL_RGBA; ABGR32 means memory order A B G R,
-// on many GL implementations GL_RGBA + GL_UNSIGNED_BYTE will match ABGR32 on little-endian
-// If colors are swapped, change format to GL_BGRA or adjust shader accordingly.
-#define LOADER_GL_PIXEL_FORMAT GL_RGBA
-
-
-#define FMT_OUT_NUM_PLANES 1
-#define FMT_CAP_NUM_PLANES 1
-
-static int v4l2_fd = -1;
-
-struct Buffer_OUT {
-    void *start[FMT_OUT_NUM_PLANES] = {0};
-    size_t length[FMT_OUT_NUM_PLANES] = {0};
-};
-
-struct Buffer_CAP {
-    void *start[FMT_CAP_NUM_PLANES] = {0};
-    size_t length[FMT_CAP_NUM_PLANES] = {0};
+#define V4L2_DEVICE_PATH "/dev/video10"             // bcm2835-codec decoder
+#define V4L2_OUTPUT_BUFFERS 2
+#define V4L2_OUTPUT_BUFFER_SIZE (4*1024*1024)       // largest jpg the codec is given, bigger ones go to the next decoder
+#define V4L2_CAPTURE_BUFFERS 5                      // CMA memory: 8.4MB each for a 1920x1080 jpg
+#define V4L2_MIN_QUEUED_CAPTURE 1                   // frames are copied out instead of held if fewer would stay queued
+#define V4L2_DECODE_TIMEOUT_MS 2000
+
+
+// Stateful memory to memory decode (see dev-decoder.html): the jpg goes in an OUTPUT buffer, the codec reports its size
+// with a source change event, then RGBA32 frames come back in CAPTURE buffers. Frames of the same size reuse the
+// capture buffers, a new size reallocates them.
+// Decoded frames point straight into the capture buffer and carry its DMABUF, so the GL thread can import it
+// instead of uploading it. The buffer is queued again when the DecodedImage is freed.
+class V4L2Decoder : public ImageDecoder {
+public:
+    V4L2Decoder(std::unique_ptr<V4L2Device> device = std::make_unique<KernelV4L2Device>(V4L2_DEVICE_PATH)) : dev(std::move(device)) {}
+    ~V4L2Decoder() override { cleanup(); }
+
+    const char *name() override { return "v4l2"; }
+    bool init() override;
+    bool accepts(const unsigned char *filebuf, size_t filebuf_len) override { return is_jpeg(filebuf, filebuf_len); }
+    bool check_header(const unsigned char *filebuf, size_t filebuf_len) override { return jpeg_header_ok(filebuf, filebuf_len); }
+    bool decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) override;
+    bool is_accelerated(const unsigned char *filebuf, size_t filebuf_len, int target_w, int target_h) override { return device_open; }
+    void free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) override; // any thread
+    GLenum pixel_format() override { return GL_RGBA; } // RGBA32 is R, G, B, A in memory
+
+private:
+    struct OutputBuffer {
+        unsigned char *start = nullptr;
+        size_t length = 0;
+        bool queued = false;
+    };
+
+    struct CaptureBuffer {
+        unsigned char *start = nullptr;
+        size_t length = 0;
+        int dmabuf_fd = -1;
+        bool queued = false;
+        bool held = false; // pixeldata of a DecodedImage
+    };
+
+    bool setup_output();
+    bool setup_capture();
+    void release_capture();
+    bool queue_capture(int index);
+    int dequeue_capture(struct v4l2_buffer &buf, struct v4l2_plane *planes);
+    void reclaim_buffers();
+    int free_output_buffer();
+    bool handle_events();
+    bool wait_frame(uint32_t frame_id, int &index);
+    void flush();
+    int queued_capture();
+    void cleanup();
+
+    std::unique_ptr<V4L2Device> dev;
+    bool device_open = false;
+    bool capture_streaming = false;
+    uint32_t next_frame_id = 1; // as the buffer timestamp, the codec copies it from OUTPUT to CAPTURE
+
+    std::vector<OutputBuffer> output;
+    std::vector<CaptureBuffer> capture;
+    struct v4l2_format capture_fmt = {};
+    struct v4l2_rect visible = {}; // the codec aligns the height to 16 (1088), this is the actual picture
+
+    // free_pixeldata runs on whatever thread drops the last reference to a frame,
+    // only the decoding thread touches the device: it hands the buffers back through here
+    std::mutex buffers_mutex;
+    std::vector<int> released;      // capture buffers to queue again
+    std::vector<CaptureBuffer> orphans; // held while the capture buffers were reallocated, unmapped once freed
 };
 
-// persistent mmap buffers & counts
-static std::vector<Buffer_OUT> v4l2_out_mmap;     // compressed input (OUTPUT) buffers
-static std::vector<Buffer_CAP> v4l2_cap_mmap;     // decoded output (CAPTURE) buffers 
 
-//FIXME remove
-// store the chosen/negotiated width/height for capture
-//static int v4l2_cap_width = 0;
-//static int v4l2_cap_height = 0;
+static void log_errno(const char *what) { SDL_Log("%s failed: %s", what, strerror(errno)); }
 
-// Some fourcc fallbacks if kernel headers differ
-//#ifndef V4L2_PIX_FMT_ABGR32
-//    #define V4L2_PIX_FMT_ABGR32 v4l2_fourcc('A','B','2','4')
-//#endif
-//#ifndef V4L2_PIX_FMT_JPEG
-//    #define V4L2_PIX_FMT_JPEG v4l2_fourcc('J','P','E','G')
-//#endif
 
-bool _init_img_loader() {
-
-    v4l2_fd = open("/dev/video10", O_RDWR | O_CLOEXEC);
-    if (v4l2_fd < 0) {
-        SDL_Log("Failed to open /dev/video10: %s", strerror(errno));
+bool V4L2Decoder::init() {
+    if (dev->open_device() < 0) {
+        log_errno("Opening " V4L2_DEVICE_PATH);
         return false;
     }
+    device_open = true;
 
-    // 1) Set INPUT (OUTPUT_MPLANE) 
-    struct v4l2_format fmt_out = {0};
-    fmt_out.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-    fmt_out.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_MJPEG;
-    fmt_out.fmt.pix_mp.num_planes = FMT_OUT_NUM_PLANES;
-    fmt_out.fmt.pix_mp.width = 1920;
-    fmt_out.fmt.pix_mp.height = 1080; 
-    if (ioctl(v4l2_fd, VIDIOC_S_FMT, &fmt_out) < 0) {
-        SDL_Log("VIDIOC_S_FMT (input) failed: %s", strerror(errno));
+    struct v4l2_capability cap = {};
+    if (dev->xioctl(VIDIOC_QUERYCAP, &cap) < 0) {
+        log_errno("VIDIOC_QUERYCAP");
+        return false;
+    }
+    const uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_M2M_MPLANE) || !(caps & V4L2_CAP_STREAMING)) {
+        SDL_Log("%s is not a multiplanar memory to memory device", (const char*)cap.card);
         return false;
     }
 
-    char format_code[5] = {0};
-    strncpy(format_code, (char*)&fmt_out.fmt.pix_mp.pixelformat, 4);
-    printf("Set format:\n"
-	 " Width: %d\n"
-	 " Height: %d\n"
-	 " Pixel format: %s\n"
-	 " Field: %d\n",
-	 fmt_out.fmt.pix_mp.width,
-	 fmt_out.fmt.pix_mp.height,
-	 format_code,
-	 fmt_out.fmt.pix_mp.field);
-
-    // 2) Set OUTPUT (CAPTURE_MPLANE) 
-    struct v4l2_format fmt_cap = {0};
-    fmt_cap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    fmt_cap.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_RGBA32;
-    fmt_cap.fmt.pix_mp.num_planes = FMT_CAP_NUM_PLANES;
-    fmt_out.fmt.pix_mp.width = 1920;
-    fmt_out.fmt.pix_mp.height = 1088; //multiple of 32 //FIXME add crop //FIXME does not get set: stays at 32x32
-    if (ioctl(v4l2_fd, VIDIOC_S_FMT, &fmt_cap) < 0) {
-        SDL_Log("VIDIOC_S_FMT (output) failed: %s", strerror(errno));
+    // compressed side. The size is only a hint, the real one comes with the source change event.
+    struct v4l2_format fmt = {};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_MJPEG;
+    fmt.fmt.pix_mp.width = 1920;
+    fmt.fmt.pix_mp.height = 1080;
+    fmt.fmt.pix_mp.num_planes = 1;
+    fmt.fmt.pix_mp.plane_fmt[0].sizeimage = V4L2_OUTPUT_BUFFER_SIZE;
+    if (dev->xioctl(VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_MJPEG) {
+        log_errno("VIDIOC_S_FMT (output) MJPEG");
         return false;
     }
 
-    strncpy(format_code, (char*)&fmt_cap.fmt.pix_mp.pixelformat, 4);
-    printf("Set format:\n"
-	 " Width: %d\n"
-	 " Height: %d\n"
-	 " Pixel format: %s\n"
-	 " Field: %d\n",
-	 fmt_cap.fmt.pix_mp.width,
-	 fmt_cap.fmt.pix_mp.height,
-	 format_code,
-	 fmt_cap.fmt.pix_mp.field);
-
-    // 3) Request MMAP buffers for input (output)
-    struct v4l2_requestbuffers req_out = {0};
-    req_out.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-    req_out.memory = V4L2_MEMORY_MMAP;
-    req_out.count = 4; // a few buffers for pipelining
-    if (ioctl(v4l2_fd, VIDIOC_REQBUFS, &req_out) < 0) {
-        SDL_Log("VIDIOC_REQBUFS (output) failed: %s", strerror(errno));
+    // decoded side. Best effort: the driver may only take it once it knows the stream, setup_capture() checks again.
+    fmt = {};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (dev->xioctl(VIDIOC_G_FMT, &fmt) == 0) {
+        fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_RGBA32;
+        dev->xioctl(VIDIOC_S_FMT, &fmt);
+    }
+
+    struct v4l2_event_subscription sub = {};
+    sub.type = V4L2_EVENT_SOURCE_CHANGE;
+    if (dev->xioctl(VIDIOC_SUBSCRIBE_EVENT, &sub) < 0) {
+        log_errno("VIDIOC_SUBSCRIBE_EVENT source change");
         return false;
     }
+    sub.type = V4L2_EVENT_EOS;
+    dev->xioctl(VIDIOC_SUBSCRIBE_EVENT, &sub); // only used while draining on cleanup
 
-    v4l2_out_mmap.resize(req_out.count);
+    return setup_output();
+}
 
-    for (int i = 0; i < v4l2_out_mmap.size(); ++i) {
-        struct v4l2_buffer buf = {0};
-        struct v4l2_plane planes[FMT_OUT_NUM_PLANES];
-        memset(planes, 0, sizeof(planes));
 
-        buf.type = req_out.type;
-        buf.memory = req_out.memory;
-        buf.index = i;
+bool V4L2Decoder::setup_output() {
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    req.memory = V4L2_MEMORY_MMAP;
+    req.count = V4L2_OUTPUT_BUFFERS;
+    if (dev->xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
+        log_errno("VIDIOC_REQBUFS (output)");
+        return false;
+    }
 
-        /* length in struct v4l2_buffer in multi-planar API stores the size
-         * of planes array. */
-        buf.length = FMT_OUT_NUM_PLANES;
+    output.resize(req.count);
+    for (unsigned int i = 0; i < req.count; i++) {
+        struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+        struct v4l2_buffer buf = {};
+        buf.type = req.type;
+        buf.memory = req.memory;
+        buf.index = i;
+        buf.length = VIDEO_MAX_PLANES; // size of the planes array in the multiplanar API
         buf.m.planes = planes;
+        if (dev->xioctl(VIDIOC_QUERYBUF, &buf) < 0) {
+            log_errno("VIDIOC_QUERYBUF (output)");
+            return false;
+        }
 
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            SDL_Log("VIDIOC_QUERYBUF (output) failed: %s", strerror(errno));
+        void *start = dev->map(planes[0].length, planes[0].m.mem_offset);
+        if (start == MAP_FAILED) {
+            log_errno("mmap (output)");
             return false;
         }
+        output[i].start = (unsigned char*)start;
+        output[i].length = planes[0].length;
+    }
 
-        /* Every plane has to be mapped separately */
-        for (int j = 0; j < FMT_OUT_NUM_PLANES; j++) {
-            v4l2_out_mmap[i].length[j] = buf.m.planes[j].length; /* remember for munmap() */
+    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    if (dev->xioctl(VIDIOC_STREAMON, &type) < 0) {
+        log_errno("VIDIOC_STREAMON (output)");
+        return false;
+    }
+    return true;
+}
 
-            v4l2_out_mmap[i].start[j] = mmap(NULL, buf.m.planes[j].length,
-                    PROT_READ | PROT_WRITE, /* recommended */
-                    MAP_SHARED,             /* recommended */
-                    v4l2_fd, buf.m.planes[j].m.mem_offset);
 
-            if (MAP_FAILED == v4l2_out_mmap[i].start[j]) {
-                /* If you do not exit here you should unmap() and free()
-                the buffers and planes mapped so far. */
-                SDL_Log("mmap (output buf %d) failed: %s", i, strerror(errno));
-                return false;
-            }
+// After a source change: allocate capture buffers for the new size, export and queue them, start streaming
+bool V4L2Decoder::setup_capture() {
+    capture_fmt = {};
+    capture_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (dev->xioctl(VIDIOC_G_FMT, &capture_fmt) < 0) {
+        log_errno("VIDIOC_G_FMT (capture)");
+        return false;
+    }
+    if (capture_fmt.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_RGBA32) {
+        capture_fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_RGBA32;
+        if (dev->xioctl(VIDIOC_S_FMT, &capture_fmt) < 0 || capture_fmt.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_RGBA32) {
+            SDL_Log("v4l2 codec cannot decode to RGBA32");
+            return false;
         }
     }
 
-    // 4) Request MMAP buffers for output (capture)
-    struct v4l2_requestbuffers req_cap = {0};
-    req_cap.count = 4;
-    req_cap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    req_cap.memory = V4L2_MEMORY_MMAP;
-    if (ioctl(v4l2_fd, VIDIOC_REQBUFS, &req_cap) < 0) {
-        SDL_Log("VIDIOC_REQBUFS (capture) failed: %s", strerror(errno));
+    const struct v4l2_pix_format_mplane &pix = capture_fmt.fmt.pix_mp;
+    if (pix.num_planes != 1 || pix.plane_fmt[0].bytesperline < pix.width * 4) {
+        SDL_Log("Unexpected v4l2 capture layout: %u planes, pitch %u for width %u", pix.num_planes, pix.plane_fmt[0].bytesperline, pix.width);
         return false;
     }
 
-    v4l2_cap_mmap.resize(req_cap.count);
+    // the part of the aligned buffer that holds the picture. Selection takes the single plane buffer type.
+    struct v4l2_selection sel = {};
+    sel.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sel.target = V4L2_SEL_TGT_COMPOSE;
+    if (dev->xioctl(VIDIOC_G_SELECTION, &sel) == 0 && sel.r.width > 0 && sel.r.height > 0 &&
+        sel.r.left >= 0 && sel.r.top >= 0 && sel.r.left + sel.r.width <= pix.width && sel.r.top + sel.r.height <= pix.height) {
+        visible = sel.r;
+    } else {
+        visible = { 0, 0, pix.width, pix.height };
+    }
 
-    for (int i = 0; i < v4l2_cap_mmap.size(); ++i) {
-        struct v4l2_buffer buf = {0};
-        struct v4l2_plane planes[FMT_CAP_NUM_PLANES];
-        memset(planes, 0, sizeof(planes));
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    req.memory = V4L2_MEMORY_MMAP;
+    req.count = V4L2_CAPTURE_BUFFERS;
+    if (dev->xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
+        log_errno("VIDIOC_REQBUFS (capture)");
+        return false;
+    }
 
-        buf.type = req_cap.type;
-        buf.memory = req_cap.memory;
+    std::vector<CaptureBuffer> buffers(req.count);
+    for (unsigned int i = 0; i < req.count; i++) {
+        struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+        struct v4l2_buffer buf = {};
+        buf.type = req.type;
+        buf.memory = req.memory;
         buf.index = i;
-
-        /* length in struct v4l2_buffer in multi-planar API stores the size
-         * of planes array. */
-        buf.length = FMT_CAP_NUM_PLANES;
+        buf.length = VIDEO_MAX_PLANES;
         buf.m.planes = planes;
-
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            SDL_Log("VIDIOC_QUERYBUF (capture) failed: %s", strerror(errno));
+        if (dev->xioctl(VIDIOC_QUERYBUF, &buf) < 0) {
+            log_errno("VIDIOC_QUERYBUF (capture)");
             return false;
         }
-
-        /* Every plane has to be mapped separately */
-        for (int j = 0; j < FMT_CAP_NUM_PLANES; j++) {
-            v4l2_cap_mmap[i].length[j] = buf.m.planes[j].length; /* remember for munmap() */
-
-            v4l2_cap_mmap[i].start[j] = mmap(NULL, buf.m.planes[j].length,
-                    PROT_READ | PROT_WRITE, /* recommended */
-                    MAP_SHARED,             /* recommended */
-                    v4l2_fd, buf.m.planes[j].m.mem_offset);
-
-            if (MAP_FAILED == v4l2_cap_mmap[i].start[j]) {
-                /* If you do not exit here you should unmap() and free()
-                the buffers and planes mapped so far. */
-                SDL_Log("mmap (capture buf %d) failed: %s", i, strerror(errno));
-                return false;
-            }
+        if (planes[0].length < (size_t)pix.plane_fmt[0].bytesperline * pix.height) {
+            SDL_Log("v4l2 capture buffer %u too small: %u bytes", i, planes[0].length);
+            return false;
         }
 
-        // queue all capture buffers initially (they will be filled by the driver)
-        if (ioctl(v4l2_fd, VIDIOC_QBUF, &buf) < 0) {
-            SDL_Log("VIDIOC_QBUF (initial capture qbuf %d) failed: %s", i, strerror(errno));
+        void *start = dev->map(planes[0].length, planes[0].m.mem_offset);
+        if (start == MAP_FAILED) {
+            log_errno("mmap (capture)");
             return false;
         }
+        buffers[i].start = (unsigned char*)start;
+        buffers[i].length = planes[0].length;
+
+        struct v4l2_exportbuffer expbuf = {};
+        expbuf.type = req.type;
+        expbuf.index = i;
+        expbuf.plane = 0;
+        expbuf.flags = O_RDONLY | O_CLOEXEC;
+        if (dev->xioctl(VIDIOC_EXPBUF, &expbuf) == 0) buffers[i].dmabuf_fd = expbuf.fd;
+        else if (i == 0) log_errno("VIDIOC_EXPBUF, frames will be uploaded"); // still works through the mapping
     }
 
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        capture = std::move(buffers);
+    }
 
-    // --- Stream on
-    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_STREAMON, &type) < 0) {
-        SDL_Log("VIDIOC_STREAMON output failed: %s", strerror(errno));
-        return false;
+    for (size_t i = 0; i < capture.size(); i++) {
+        if (!queue_capture(i)) return false;
     }
-    type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_STREAMON, &type) < 0) {
-        SDL_Log("VIDIOC_STREAMON capture failed: %s", strerror(errno));
+
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (dev->xioctl(VIDIOC_STREAMON, &type) < 0) {
+        log_errno("VIDIOC_STREAMON (capture)");
         return false;
     }
+    capture_streaming = true;
 
+#ifdef DEBUG
+    SDL_Log("v4l2 capture: %u buffers of %ux%u, pitch %u, picture %ux%u at %d,%d, dmabuf %s", req.count, pix.width, pix.height,
+            pix.plane_fmt[0].bytesperline, visible.width, visible.height, visible.left, visible.top, capture[0].dmabuf_fd >= 0 ? "yes" : "no");
+#endif
     return true;
 }
 
 
+// Stop the capture queue and free its buffers. Frames still in use keep their mapping until they are freed.
+void V4L2Decoder::release_capture() {
+    if (capture_streaming) {
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        if (dev->xioctl(VIDIOC_STREAMOFF, &type) < 0) log_errno("VIDIOC_STREAMOFF (capture)");
+        capture_streaming = false;
+    }
 
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height) {
-    if (v4l2_fd < 0 || v4l2_out_mmap.empty() || v4l2_cap_mmap.empty()) {
-        SDL_Log("v4l2 not initialized");
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (int index : released) capture[index].held = false;
+        released.clear();
+
+        for (auto &buf : capture) {
+            if (buf.held) {
+                orphans.push_back(buf);
+                continue;
+            }
+            dev->unmap(buf.start, buf.length);
+            if (buf.dmabuf_fd >= 0) close(buf.dmabuf_fd);
+        }
+        capture.clear();
     }
 
-    //fill input (output_mplane) buffers with jpeg data
-    size_t remaining = filebuf_in.size();
-    int buf_idx = 0;
-    while(remaining > 0 && buf_idx < (v4l2_out_mmap.size()*3)) {
-        struct v4l2_buffer out_buf = {0};
-        struct v4l2_plane out_planes[FMT_OUT_NUM_PLANES];
-        memset(out_planes, 0, sizeof(out_planes));
+    // the kernel keeps the memory of orphaned buffers alive as long as they are mapped
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    req.memory = V4L2_MEMORY_MMAP;
+    req.count = 0;
+    if (device_open) dev->xioctl(VIDIOC_REQBUFS, &req);
+}
 
-        out_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-        out_buf.memory = V4L2_MEMORY_MMAP;
-        out_buf.length = FMT_OUT_NUM_PLANES;
-        out_buf.m.planes = out_planes;
-        out_buf.index = buf_idx % v4l2_out_mmap.size();
 
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &out_buf) < 0) {
-            SDL_Log("VIDIOC_QUERYBUF (output) failed: %s", strerror(errno));
-            return false;
-        }
+bool V4L2Decoder::queue_capture(int index) {
+    struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+    struct v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    buf.length = 1;
+    buf.m.planes = planes;
+    planes[0].length = capture[index].length;
+    if (dev->xioctl(VIDIOC_QBUF, &buf) < 0) {
+        log_errno("VIDIOC_QBUF (capture)");
+        return false;
+    }
+    capture[index].queued = true;
+    return true;
+}
 
-        if(!(out_buf.flags & V4L2_BUF_FLAG_QUEUED)) { //if buffer not queued
 
-            //if done dequeue it to make it available
-            if (out_buf.flags & V4L2_BUF_FLAG_DONE) {
-                if(ioctl(v4l2_fd, VIDIOC_DQBUF, &out_buf) < 0) {
-                    SDL_Log("cannot get empty input buffer: VIDIOC_DQBUF output failed: %s", strerror(errno));
-                    return false;
-                }
-            }
+// Returns the index of a decoded frame, -1 if none is ready yet (or the stream is stopped for a source change)
+// planes: VIDEO_MAX_PLANES entries, filled in along with buf
+int V4L2Decoder::dequeue_capture(struct v4l2_buffer &buf, struct v4l2_plane *planes) {
+    memset(planes, 0, sizeof(struct v4l2_plane) * VIDEO_MAX_PLANES);
+    buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.length = VIDEO_MAX_PLANES;
+    buf.m.planes = planes;
+    if (dev->xioctl(VIDIOC_DQBUF, &buf) < 0) {
+        if (errno != EAGAIN && errno != EPIPE) log_errno("VIDIOC_DQBUF (capture)");
+        return -1;
+    }
+    if (buf.index >= capture.size()) return -1;
+    capture[buf.index].queued = false;
+    return buf.index;
+}
 
-            //fill planes
-            for (int p = 0; p < FMT_OUT_NUM_PLANES; ++p) {
-                size_t plane_size = v4l2_out_mmap[out_buf.index].length[p];
-                size_t to_copy = remaining < plane_size ? remaining : plane_size;
-                memcpy(v4l2_out_mmap[out_buf.index].start[p], filebuf_in.data() + (filebuf_in.size() - remaining), to_copy);
-                out_buf.m.planes[p].bytesused = to_copy;
-                out_buf.m.planes[p].length = plane_size;
-                remaining -= to_copy;
-            }
 
-            if (ioctl(v4l2_fd, VIDIOC_QBUF, &out_buf) < 0) {
-                SDL_Log("VIDIOC_QBUF (output) failed: %s", strerror(errno));
-                return false;
-            }
-            #ifdef DEBUG
-            else {
-                SDL_Log("VIDIOC_QBUF (output) success");
-            }
-            #endif
-        }
+// Queue again the capture buffers of freed frames and take back the OUTPUT buffers the codec is done with
+void V4L2Decoder::reclaim_buffers() {
+    std::vector<int> indices;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        indices.swap(released);
+    }
+    for (int index : indices) {
+        capture[index].held = false;
+        if (capture_streaming) queue_capture(index);
+    }
 
-        buf_idx++;
+    while (true) {
+        struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+        struct v4l2_buffer buf = {};
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.length = VIDEO_MAX_PLANES;
+        buf.m.planes = planes;
+        if (dev->xioctl(VIDIOC_DQBUF, &buf) < 0 || buf.index >= output.size()) break;
+        output[buf.index].queued = false;
     }
+}
 
-    if (remaining > 0) {
-        SDL_Log("JPEG not fully uploaded.");
-        return false;
+
+int V4L2Decoder::free_output_buffer() {
+    for (size_t i = 0; i < output.size(); i++) {
+        if (!output[i].queued) return i;
     }
+    return -1;
+}
 
-    struct v4l2_format cur_fmt = {0};
-    cur_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_G_FMT, &cur_fmt) < 0) {
-        SDL_Log("VIDIOC_G_FMT (capture) failed: %s", strerror(errno));
-        return false;
+
+int V4L2Decoder::queued_capture() {
+    int n = 0;
+    for (auto &buf : capture) n += buf.queued;
+    return n;
+}
+
+
+// Dequeue every pending event, reallocate the capture buffers if the size changed
+bool V4L2Decoder::handle_events() {
+    bool source_changed = false;
+    struct v4l2_event event;
+    while (true) {
+        event = {};
+        if (dev->xioctl(VIDIOC_DQEVENT, &event) < 0) break;
+        if (event.type == V4L2_EVENT_SOURCE_CHANGE && (event.u.src_change.changes & V4L2_EVENT_SRC_CH_RESOLUTION)) source_changed = true;
     }
 
-    width = cur_fmt.fmt.pix_mp.width;
-    height = cur_fmt.fmt.pix_mp.height;
-
-    char format_code[5] = {0};
-    strncpy(format_code, (char*)&cur_fmt.fmt.pix_mp.pixelformat, 4);
-    printf("Set format:\n"
-	 " Width: %d\n"
-	 " Height: %d\n"
-	 " Pixel format: %s\n"
-	 " Field: %d\n",
-	 cur_fmt.fmt.pix_mp.width, //FIXME does not report correct resolution
-	 cur_fmt.fmt.pix_mp.height,
-	 format_code,
-	 cur_fmt.fmt.pix_mp.field);
-
-//FIXME read capture buffer into pixeldata_out
-/* 
-
-    //dequeue done input (output_mplane) buffers
-    for (int i = 0; i < v4l2_out_mmap.size(); ++i) {
-        struct v4l2_buffer out_buf = {0};
-        struct v4l2_plane out_planes[FMT_OUT_NUM_PLANES];
-        memset(out_planes, 0, sizeof(out_planes));
-
-        out_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-        out_buf.memory = V4L2_MEMORY_MMAP;
-        out_buf.length = FMT_OUT_NUM_PLANES;
-        out_buf.m.planes = out_planes;
-        out_buf.index = i;
-
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &out_buf) < 0) {
-            SDL_Log("VIDIOC_QUERYBUF (output) failed: %s", strerror(errno));
+    if (!source_changed) return true;
+    release_capture();
+    return setup_capture();
+}
+
+
+// Wait for the frame of the jpg queued as frame_id. Frames of jpgs that timed out before are dropped.
+bool V4L2Decoder::wait_frame(uint32_t frame_id, int &index) {
+    const Uint64 deadline = SDL_GetTicks() + V4L2_DECODE_TIMEOUT_MS;
+
+    while (true) {
+        const Sint64 remaining = (Sint64)(deadline - SDL_GetTicks());
+        if (remaining <= 0) {
+            SDL_Log("v4l2 decode timed out");
             return false;
         }
 
-        if(!(out_buf.flags & V4L2_BUF_FLAG_QUEUED) && (out_buf.flags & V4L2_BUF_FLAG_DONE)) {
-            if(ioctl(v4l2_fd, VIDIOC_DQBUF, &out_buf) < 0) {
-                SDL_Log("cannot get empty input buffer: VIDIOC_DQBUF output failed: %s", strerror(errno));
-                return false;
+        short revents = 0;
+        int ret = dev->wait(POLLIN | POLLPRI, revents, remaining);
+        if (ret < 0) {
+            log_errno("poll on v4l2 device");
+            return false;
+        }
+        if (ret == 0) continue;
+
+        if (revents & POLLPRI) {
+            if (!handle_events()) return false;
+            continue; // the new capture queue has nothing yet
+        }
+
+        if (revents & POLLIN) {
+            struct v4l2_plane planes[VIDEO_MAX_PLANES];
+            struct v4l2_buffer buf;
+            int i = dequeue_capture(buf, planes);
+            if (i < 0) continue;
+
+            const bool stale = buf.timestamp.tv_sec != (time_t)frame_id;
+            if (stale || (buf.flags & V4L2_BUF_FLAG_ERROR) || planes[0].bytesused == 0) {
+                queue_capture(i);
+                if (stale) continue;
+                transient_failure = false;
+                return false; // corrupt jpg
             }
+            index = i;
+            return true;
+        }
+
+        if (revents & POLLERR) {
+            SDL_Log("v4l2 device reported an error");
+            return false;
         }
     }
+}
+
+
+// Drop whatever the codec is still working on, after a timeout or a corrupt jpg
+void V4L2Decoder::flush() {
+    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    dev->xioctl(VIDIOC_STREAMOFF, &type); // returns every OUTPUT buffer
+    for (auto &buf : output) buf.queued = false;
+    if (dev->xioctl(VIDIOC_STREAMON, &type) < 0) log_errno("VIDIOC_STREAMON (output)");
 
+    if (!capture_streaming) return;
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    dev->xioctl(VIDIOC_STREAMOFF, &type);
+    for (size_t i = 0; i < capture.size(); i++) {
+        capture[i].queued = false;
+        if (!capture[i].held) queue_capture(i);
+    }
+    if (dev->xioctl(VIDIOC_STREAMON, &type) < 0) {
+        log_errno("VIDIOC_STREAMON (capture)");
+        capture_streaming = false;
+    }
+}
 
 
+bool V4L2Decoder::decode(DecodedImage &img, const unsigned char *filebuf, size_t filebuf_len, const std::string &path, int target_w, int target_h) {
+    // target size is ignored: the codec always decodes at full size
+    transient_failure = true; // the codec, unless it says the jpg is corrupt
+    if (!device_open || output.empty()) return false;
 
-    // We'll use buffer index 0 for output (compressed) for simplicity, but we rotate through available buffers
-    static int out_idx = 0;
-    static int cap_idx = 0;
+    reclaim_buffers();
 
-    // 1) Copy JPEG into next output mmap buffer
-    int chosen_out = out_idx % v4l2_out_buf.size();
-    if (filebuf_in.size() > v4l2_out_mmap_len[chosen_out]) {
-        SDL_Log("JPEG size %zu exceeds mapped output buffer size %zu", filebuf_in.size(), v4l2_out_mmap_len[chosen_out]);
+    int out = free_output_buffer();
+    if (out < 0 || filebuf_len > output[out].length) {
+        SDL_Log("v4l2 cannot take %s: %s", path.c_str(), out < 0 ? "no free input buffer" : "too big");
         return false;
     }
-    // copy compressed JPEG to the mmap region
-    memcpy(v4l2_out_mmap[chosen_out], filebuf_in.data(), filebuf_in.size());
-
-    // Prepare and queue the OUTPUT buffer (compressed)
-    struct v4l2_buffer outbuf = {};
-    struct v4l2_plane outplanes[VIDEO_MAX_PLANES];
-    memset(outplanes, 0, sizeof(outplanes));
-    outbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-    outbuf.memory = V4L2_MEMORY_MMAP;
-    outbuf.index = chosen_out;
-    outbuf.length = 1;
-    outbuf.m.planes = outplanes;
-    outbuf.m.planes[0].bytesused = (unsigned int)filebuf_in.size();
-    outbuf.m.planes[0].length = (unsigned int)v4l2_out_mmap_len[chosen_out];
-
-    if (ioctl(v4l2_fd, VIDIOC_QBUF, &outbuf) < 0) {
-        SDL_Log("VIDIOC_QBUF (output) failed: %s", strerror(errno));
+    if (capture_streaming && queued_capture() == 0) {
+        SDL_Log("v4l2 has no free frame for %s, every one is in use", path.c_str());
         return false;
     }
 
+    memcpy(output[out].start, filebuf, filebuf_len);
+
+    const uint32_t frame_id = next_frame_id++;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+    struct v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = out;
+    buf.length = 1;
+    buf.m.planes = planes;
+    buf.timestamp.tv_sec = frame_id;
+    planes[0].bytesused = filebuf_len;
+    planes[0].length = output[out].length;
+    if (dev->xioctl(VIDIOC_QBUF, &buf) < 0) {
+        log_errno("VIDIOC_QBUF (output)");
+        return false;
+    }
+    output[out].queued = true;
 
-
-    // 2) Prepare capture buffer (we use whichever is next; capture buffers were pre-queued in init,
-    //    but to be safe we will dequeue one and requeue after processing)
-    struct v4l2_buffer capbuf = {};
-    struct v4l2_plane capplanes[VIDEO_MAX_PLANES];
-    memset(capplanes, 0, sizeof(capplanes));
-    capbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    capbuf.memory = V4L2_MEMORY_MMAP;
-    capbuf.length = 1;
-    capbuf.m.planes = capplanes;
-
-    // Dequeue a decoded capture buffer (this blocks until decode completes)
-    if (ioctl(v4l2_fd, VIDIOC_DQBUF, &capbuf) < 0) {
-        SDL_Log("VIDIOC_DQBUF (capture) failed: %s", strerror(errno));
+    int index;
+    if (!wait_frame(frame_id, index)) {
+        SDL_Log("v4l2 failed to decode %s", path.c_str());
+        flush();
         return false;
     }
 
-    // Query capture format (to get width/height)
-    struct v4l2_format fmtget = {};
-    fmtget.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_G_FMT, &fmtget) < 0) {
-        SDL_Log("VIDIOC_G_FMT (capture) failed: %s", strerror(errno));
-        // still proceed if necessary
-    } else {
-        v4l2_cap_width = fmtget.fmt.pix_mp.width;
-        v4l2_cap_height = fmtget.fmt.pix_mp.height;
+    CaptureBuffer &cap = capture[index];
+    const size_t pitch = capture_fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    const size_t offset = visible.top * pitch + visible.left * 4;
+    const size_t row_bytes = (size_t)visible.width * 4;
+
+    img.width = visible.width;
+    img.height = visible.height;
+    img.top_down = true;
+    img.pixeldata_len = row_bytes * visible.height;
+
+    // zero copy only if the rows are contiguous and enough buffers stay queued for the next decodes
+    if (pitch == row_bytes && queued_capture() >= V4L2_MIN_QUEUED_CAPTURE) {
+        cap.held = true;
+        img.pixeldata = cap.start + offset;
+        img.dmabuf_fd = cap.dmabuf_fd;
+        img.dmabuf_offset = offset;
+        img.dmabuf_pitch = pitch;
+        return true;
     }
 
-    // capbuf.index tells which cap buffer holds the decoded data
-    int decoded_index = capbuf.index;
-    pixeldata_out = (unsigned char*)v4l2_cap_mmap[decoded_index];
-    pixeldata_len_out = v4l2_cap_mmap_len[decoded_index];
-    width = v4l2_cap_width;
-    height = v4l2_cap_height;
+    img.pixeldata = _alloc_pixeldata(img.pixeldata_len);
+    if (img.pixeldata) {
+        for (int y = 0; y < img.height; y++) memcpy(img.pixeldata + y * row_bytes, cap.start + offset + y * pitch, row_bytes);
+    } else {
+        SDL_Log("Out of memory");
+        transient_failure = true;
+    }
+    queue_capture(index);
+    return img.pixeldata != nullptr;
+}
 
 
-    // After consuming the capture buffer we'll re-queue it so driver can reuse it
-    // set bytesused as per capbuf.m.planes[0].bytesused (driver filled)
-    capbuf.m.planes[0].length = (unsigned int)pixeldata_len_out;
-    capbuf.m.planes[0].bytesused = capbuf.m.planes[0].bytesused; // keep what driver returned
+void V4L2Decoder::free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
 
-    if (ioctl(v4l2_fd, VIDIOC_QBUF, &capbuf) < 0) {
-        SDL_Log("VIDIOC_QBUF (requeue capture) failed: %s", strerror(errno));
-        // not fatal — but log
+    for (size_t i = 0; i < capture.size(); i++) {
+        if (pixeldata >= capture[i].start && pixeldata < capture[i].start + capture[i].length) {
+            released.push_back(i); // queued again by the decoding thread
+            return;
+        }
     }
 
-    // increment indices for round-robin
-    out_idx = (out_idx + 1) % v4l2_out_buf_count;
-    cap_idx = (cap_idx + 1) % v4l2_cap_buf_count;
-
-*/
-    return true;
-}
+    for (auto it = orphans.begin(); it != orphans.end(); ++it) {
+        if (pixeldata >= it->start && pixeldata < it->start + it->length) {
+            dev->unmap(it->start, it->length);
+            if (it->dmabuf_fd >= 0) close(it->dmabuf_fd);
+            orphans.erase(it);
+            return;
+        }
+    }
 
-void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
-    // we do not unmap here — mapping persists until program ends or cleanup; but
-    // if you prefer to unmap now, you should not re-use the buffers. For persistent reuse keep them mapped.
-    // (We leave them mapped)
+    _release_pixeldata(pixeldata); // copied out
 }
 
 
-//FIXME loader_cleanup() does not clean up properly. giving up on codec bug.
-// program "works" only one time. then you must reboot the system, or else you get:
+//NOTE older firmware leaves buffers active on STREAMOFF (below), after which the codec can not be opened again until a reboot:
 // VIDIOC_REQBUFS (output) failed: Invalid argument
+// cleanup() drains the codec first so nothing is in flight. If the bug still hits, init() fails and
+// DecoderRegistry falls back to the software decoders.
 
 /*
 $ dmesg | grep -i video
@@ -493,100 +632,56 @@ $ dmesg | grep -i video
 [  258.802694] bcm2835-codec bcm2835-codec: bcm2835_codec_create_component: failed to create component ril.video_decode
 */
 
-void _loader_cleanup() {
-
-    int buf_idx = 0;
-    while(buf_idx < v4l2_out_mmap.size()) {
-        struct v4l2_buffer out_buf = {0};
-        struct v4l2_plane out_planes[FMT_OUT_NUM_PLANES];
-        memset(out_planes, 0, sizeof(out_planes));
-
-        out_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-        out_buf.memory = V4L2_MEMORY_MMAP;
-        out_buf.length = FMT_OUT_NUM_PLANES;
-        out_buf.m.planes = out_planes;
-        out_buf.index = buf_idx;
-
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &out_buf) < 0) {
-            SDL_Log("cleanup: VIDIOC_QUERYBUF output failed: %s", strerror(errno));
-        }
-
-        if(out_buf.flags & V4L2_BUF_FLAG_DONE) { 
-            if(ioctl(v4l2_fd, VIDIOC_DQBUF, &out_buf) < 0) {
-                SDL_Log("cleanup: VIDIOC_DQBUF output failed: %s", strerror(errno));
-            }
-            else {
-                SDL_Log("cleanup: VIDIOC_DQBUF output sucecess");
-            }
-        }
-
-        buf_idx++;
-    }
-
-    buf_idx = 0;
-    while(buf_idx < v4l2_cap_mmap.size()) {
-        struct v4l2_buffer cap_buf = {0};
-        struct v4l2_plane cap_planes[FMT_CAP_NUM_PLANES];
-        memset(cap_planes, 0, sizeof(cap_planes));
-
-        cap_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-        cap_buf.memory = V4L2_MEMORY_MMAP;
-        cap_buf.length = FMT_CAP_NUM_PLANES;
-        cap_buf.m.planes = cap_planes;
-        cap_buf.index = buf_idx;
-
-        if (ioctl(v4l2_fd, VIDIOC_QUERYBUF, &cap_buf) < 0) {
-            SDL_Log("cleanup: VIDIOC_QUERYBUF capture failed: %s", strerror(errno));
-        }
-
-        if(cap_buf.flags & V4L2_BUF_FLAG_DONE) { 
-            if(ioctl(v4l2_fd, VIDIOC_DQBUF, &cap_buf) < 0) {
-                SDL_Log("cleanup: VIDIOC_DQBUF capture failed: %s", strerror(errno));
-            }
-            else {
-                SDL_Log("cleanup: VIDIOC_DQBUF capture sucecess");
+void V4L2Decoder::cleanup() {
+    if (!device_open) return;
+
+    // drain: the codec flags the last frame once everything queued is decoded
+    if (capture_streaming) {
+        struct v4l2_decoder_cmd cmd = {};
+        cmd.cmd = V4L2_DEC_CMD_STOP;
+        if (dev->xioctl(VIDIOC_DECODER_CMD, &cmd) == 0) {
+            const Uint64 deadline = SDL_GetTicks() + V4L2_DECODE_TIMEOUT_MS;
+            bool drained = false;
+            while (!drained && SDL_GetTicks() < deadline) {
+                short revents = 0;
+                if (dev->wait(POLLIN | POLLPRI, revents, 100) < 0) break;
+                if (revents & POLLPRI) {
+                    struct v4l2_event event = {};
+                    while (dev->xioctl(VIDIOC_DQEVENT, &event) == 0) drained = drained || event.type == V4L2_EVENT_EOS;
+                }
+                if (revents & POLLIN) {
+                    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+                    struct v4l2_buffer buf;
+                    if (dequeue_capture(buf, planes) >= 0) drained = drained || (buf.flags & V4L2_BUF_FLAG_LAST);
+                    else drained = drained || errno == EPIPE; // last one already dequeued
+                }
             }
         }
-
-        buf_idx++;
     }
 
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_STREAMOFF, &type) < 0)
-        SDL_Log("cleanup: VIDIOC_STREAMOFF output failed: %s", strerror(errno));
+    reclaim_buffers();
+    release_capture();
 
-    type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    if (ioctl(v4l2_fd, VIDIOC_STREAMOFF, &type) < 0)
-        SDL_Log("cleanup: VIDIOC_STREAMOFF capture failed: %s", strerror(errno));
+    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    dev->xioctl(VIDIOC_STREAMOFF, &type);
+    for (auto &buf : output) dev->unmap(buf.start, buf.length);
+    output.clear();
 
-    struct v4l2_requestbuffers req = {0};
+    struct v4l2_requestbuffers req = {};
     req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
     req.memory = V4L2_MEMORY_MMAP;
     req.count = 0;
-    if (ioctl(v4l2_fd, VIDIOC_REQBUFS, &req) < 0)
-        SDL_Log("cleanup: VIDIOC_REQBUFS output failed: %s", strerror(errno));
-
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    req.memory = V4L2_MEMORY_MMAP;
-    req.count = 0;
-    if (ioctl(v4l2_fd, VIDIOC_REQBUFS, &req) < 0)
-        SDL_Log("cleanup: VIDIOC_REQBUFS capture failed: %s", strerror(errno));
+    dev->xioctl(VIDIOC_REQBUFS, &req);
 
-    for (auto &buf : v4l2_out_mmap) {
-        for (int i=0; i < FMT_OUT_NUM_PLANES; i++) {
-            if (buf.start[i] != 0 && buf.start[i] != MAP_FAILED) {
-                munmap(buf.start[i], buf.length[i]);
-            }
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (auto &buf : orphans) { // frames outliving the decoder, should not happen
+            dev->unmap(buf.start, buf.length);
+            if (buf.dmabuf_fd >= 0) close(buf.dmabuf_fd);
         }
+        orphans.clear();
     }
 
-    for (auto &buf : v4l2_cap_mmap) {
-        for (int i=0; i < FMT_CAP_NUM_PLANES; i++) {
-            if (buf.start[i] != 0 && buf.start[i] != MAP_FAILED) {
-                munmap(buf.start[i], buf.length[i]);
-            }
-        }
-    }
-
-    close(v4l2_fd); v4l2_fd = -1;
-}
\ No newline at end of file
+    dev->close_device();
+    device_open = false;
+}
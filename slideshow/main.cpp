@@ -2,17 +2,34 @@
 #include "SDL_GL_window.h"
 #include "load_image.h"
 #include "gpio_led.h"
+#include "idle_wait.h"
 
 #include <math.h>
 #include <string>
 #include <csignal>
 #include <atomic>
+#include <chrono>
+#include <time.h>
+#include <sys/resource.h>
 
 
 #define DEFAULT_IMG_DISPLAY_TIME 60.0f 
 #define DEFAULT_IMG_FADE_TIME 0.5f
 #define DEFAULT_IMG_FOLDER_PATH "/tmp"
 #define DEFAULT_GPIO_LINE 23  // GPIO23
+#define DEFAULT_IMG_CACHE_MB 24 // two decoded 1080p frames plus a few jpgs, fine on a 256MB Pi
+#define DEFAULT_IMG_CACHE_RAW 2
+#define DEFAULT_IMG_CACHE_DECODED 2
+#define DEFAULT_IMG_UPLOAD_BUDGET_MS 8.0f // per main loop iteration, 0 uploads every image in one call
+#define DEFAULT_IMG_SIDECAR_DIR ".frames" // inside IMG_FOLDER_PATH, so the decoded frames stay on the same drive as the jpgs
+#define DEFAULT_IMG_SIDECAR_MB 2048 // ~340 1080p RGB frames, 0 disables the sidecars
+#define DEFAULT_IMG_DECODE_THREADS 0 // cores one jpg is decoded on, 0 = all of them, 1 = no splitting
+#define DEFAULT_IMG_NAVIGATION_PREVIEW 1 // arrow keys first show a 1/8 scale decode, then the full image
+#define DEFAULT_IMG_QUARANTINE_FILE ".quarantine" // inside IMG_FOLDER_PATH, lists the files that failed to decode
+#define DEFAULT_IMG_CATALOG_FILE ".catalog" // inside IMG_FOLDER_PATH, the file list and image metadata of the last run
+#define DEFAULT_IMG_SHUFFLE 0 // 1 shows the images in a pseudo-random order instead of by name
+#define DEFAULT_IMG_SHUFFLE_SEED_FILE ".shuffle_seed" // inside IMG_FOLDER_PATH, keeps the order across restarts
+#define DEFAULT_IMG_STATE_FILE ".last_shown" // inside IMG_FOLDER_PATH, the image on screen, shown first after a restart
 
 std::atomic<bool> stop_requested(false);
 
@@ -23,12 +40,25 @@ void signal_handler(int signal) {
 }
 
 
+static float ms_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<float, std::milli>(to - from).count();
+}
+
+
+// ms until deadline_s, rounded up so the wait does not end just before it
+static int ms_until(float now_s, float deadline_s) {
+    return (int)ceilf((deadline_s - now_s) * 1000.0f);
+}
+
+
 int main(int, char**)
 {
+    const auto start_time = std::chrono::steady_clock::now();
     enum State { DISPLAY, FADING };
     State curr_state = DISPLAY;
     float curr_state_time_spent = 0.0f;
     bool paused = false;
+    int navigation_dir = 0; // user asked for another image (-1 prev, 1 next), jump to it as soon as it is uploaded
 
     std::signal(SIGINT, signal_handler);
 
@@ -44,19 +74,79 @@ int main(int, char**)
     const char* env_led = getenv("LED_PAUSE_INDICATOR_GPIO");
     unsigned int led_pin = env_led != nullptr ? (unsigned int)std::stoul(env_led) : DEFAULT_GPIO_LINE;
 
+    ImageCacheConfig cache_config;
+    const char* env_cache_mb = getenv("IMG_CACHE_MB");
+    cache_config.budget_bytes = (size_t)(env_cache_mb != nullptr ? std::stoul(env_cache_mb) : DEFAULT_IMG_CACHE_MB) * 1024 * 1024;
+
+    const char* env_cache_raw = getenv("IMG_CACHE_RAW");
+    cache_config.raw_neighbors = env_cache_raw != nullptr ? std::stoi(env_cache_raw) : DEFAULT_IMG_CACHE_RAW;
+
+    const char* env_cache_decoded = getenv("IMG_CACHE_DECODED");
+    cache_config.decoded_frames = env_cache_decoded != nullptr ? std::stoi(env_cache_decoded) : DEFAULT_IMG_CACHE_DECODED;
+
+    SidecarConfig sidecar_config;
+    const char* env_sidecar_path = getenv("IMG_SIDECAR_PATH");
+    sidecar_config.dir = env_sidecar_path != nullptr ? env_sidecar_path : folder_path + "/" + DEFAULT_IMG_SIDECAR_DIR;
+
+    const char* env_sidecar_mb = getenv("IMG_SIDECAR_MB");
+    sidecar_config.budget_bytes = (size_t)(env_sidecar_mb != nullptr ? std::stoul(env_sidecar_mb) : DEFAULT_IMG_SIDECAR_MB) * 1024 * 1024;
+
+    const char* env_decode_threads = getenv("IMG_DECODE_THREADS");
+    const int decode_threads = env_decode_threads != nullptr ? std::stoi(env_decode_threads) : DEFAULT_IMG_DECODE_THREADS;
+
+    const char* env_navigation_preview = getenv("IMG_NAVIGATION_PREVIEW");
+    const bool navigation_preview = (env_navigation_preview != nullptr ? std::stoi(env_navigation_preview) : DEFAULT_IMG_NAVIGATION_PREVIEW) != 0;
+
+    const char* env_quarantine_path = getenv("IMG_QUARANTINE_PATH"); // empty: the list is not kept across restarts
+    const std::string quarantine_path = env_quarantine_path != nullptr ? env_quarantine_path : folder_path + "/" + DEFAULT_IMG_QUARANTINE_FILE;
+
+    const char* env_catalog_path = getenv("IMG_CATALOG_PATH"); // empty: the folder is scanned on every start
+    const std::string catalog_path = env_catalog_path != nullptr ? env_catalog_path : folder_path + "/" + DEFAULT_IMG_CATALOG_FILE;
+
+    const char* env_shuffle = getenv("IMG_SHUFFLE");
+    const bool shuffle = (env_shuffle != nullptr ? std::stoi(env_shuffle) : DEFAULT_IMG_SHUFFLE) != 0;
+    const char* env_shuffle_seed_path = getenv("IMG_SHUFFLE_SEED_PATH"); // empty: a new order on every start
+    const std::string shuffle_seed_path = env_shuffle_seed_path != nullptr ? env_shuffle_seed_path : folder_path + "/" + DEFAULT_IMG_SHUFFLE_SEED_FILE;
+
+    const char* env_state_path = getenv("IMG_STATE_PATH"); // empty: every start begins with the first image
+    const std::string state_path = env_state_path != nullptr ? env_state_path : folder_path + "/" + DEFAULT_IMG_STATE_FILE;
+
     GPIOLED my_led(led_pin);
     SDL_GL_window my_window;
-    ImageLoader my_loader(folder_path);
+    const auto window_time = std::chrono::steady_clock::now();
+    // before the loader: a new seed file changes the folder, so it is in the mtime the catalog stores at this start
+    const uint64_t shuffle_seed = shuffle ? load_shuffle_seed(shuffle_seed_path) : 0;
+    ImageLoader my_loader(folder_path, my_window.get_display_width(), my_window.get_display_height(), cache_config, sidecar_config, decode_threads, quarantine_path, catalog_path, state_path);
     if (!my_loader.init_is_successful()) return 1;
+    const auto loader_time = std::chrono::steady_clock::now();
+    if (shuffle) my_loader.set_shuffle(shuffle_seed);
+
+    const char* env_upload_budget = getenv("IMG_UPLOAD_BUDGET_MS");
+    my_loader.set_upload_budget(env_upload_budget != nullptr ? std::stof(env_upload_budget) : DEFAULT_IMG_UPLOAD_BUDGET_MS);
 
 
     // first render, twice because of a bug on some opengl implementations where 
     // one render would show a black screen, but it would fix itself with a second one.
     my_window.render(0.0f);
     my_window.render(0.0f);
+    IdleWait idle(my_window.get_input_devices());
+
+    // time to first frame, logged on every start: the figure to watch when startup gets slower
+    const auto first_frame_time = std::chrono::steady_clock::now();
+    timespec boot_time;
+    clock_gettime(CLOCK_BOOTTIME, &boot_time);
+    SDL_Log("First image on screen after %.0f ms (window %.0f ms, loader %.0f ms, %s), %.1f s after boot",
+            ms_between(start_time, first_frame_time), ms_between(start_time, window_time), ms_between(window_time, loader_time),
+            my_loader.get_first_image_source(), boot_time.tv_sec + boot_time.tv_nsec / 1e9);
 
     Uint64 prevTime = SDL_GetPerformanceCounter(); 
-    SDL_Delay(100);
+#ifdef DEBUG
+    Uint64 key_time = 0;    // last navigation keypress, to time it until the image is on screen. SDL_GetTicksNS() time.
+    Uint64 key_handled = 0; // from the keypress until the main loop requested the image
+    Uint64 stats_time = prevTime; // wakeups and CPU time are logged once a minute
+    uint64_t stats_wakeups = 0;
+    float stats_cpu_ms = 0;
+#endif
 
     while (!stop_requested) // Main loop
     {
@@ -87,19 +177,27 @@ int main(int, char**)
                     break; 
 
                 case SDLK_LEFT:
-                    if (curr_state == FADING) break;
-                    if(!my_loader.load_prev_image()) return 1;
-                    curr_state_time_spent = img_fade_time_s; //jump directly to next image, don't fade
-                    curr_state = FADING;
+                    if (curr_state == FADING || navigation_dir == -1) break;
+                    my_loader.load_prev_image(LoadPriority::USER, navigation_preview); //decoded in the background, see navigation_dir
+                    navigation_dir = -1;
+#ifdef DEBUG
+                    key_time = event.key.timestamp; // from the kernel's timestamp of the key with evdev, like slideshow2
+                    key_handled = SDL_GetTicksNS() - key_time;
+#endif
                     break;
 
                 case SDLK_RIGHT:
-                    if (curr_state == FADING) break;
-                    if (!my_loader.new_image_has_been_loaded()) { //maybe the next image has already been loaded automatically. skip load.
-                        if(!my_loader.load_next_image()) return 1;
+                    if (curr_state == FADING || navigation_dir == 1) break;
+                    //maybe the next image has already been loaded automatically. skip load. One still being loaded is taken over
+                    //at USER priority: the decode goes on where it is, but nothing else runs before it anymore.
+                    if (navigation_dir == -1 || my_loader.showing_preview() || !my_loader.new_image_has_been_loaded()) {
+                        my_loader.load_next_image(LoadPriority::USER, navigation_preview);
                     }
-                    curr_state_time_spent = img_fade_time_s; //jump directly to next image, don't fade
-                    curr_state = FADING;
+                    navigation_dir = 1;
+#ifdef DEBUG
+                    key_time = event.key.timestamp; // from the kernel's timestamp of the key with evdev, like slideshow2
+                    key_handled = SDL_GetTicksNS() - key_time;
+#endif
                     break;
                 }
                 break;
@@ -110,18 +208,39 @@ int main(int, char**)
         switch (curr_state)
         {
         case DISPLAY:
+            if (!my_loader.update()) { // upload happens here and only here, never while fading
+                //nothing else could be loaded: keep showing this image, try again after another display time
+                navigation_dir = 0;
+                curr_state_time_spent = 0;
+            }
+
+            //a preview is replaced by its full image the same way, as soon as it is there
+            if ((navigation_dir != 0 || my_loader.showing_preview()) && my_loader.new_image_has_been_loaded()) {
+                navigation_dir = 0;
+                curr_state_time_spent = img_fade_time_s; //jump directly to next image, don't fade
+                curr_state = FADING;
+                break;
+            }
+
             if (!paused) {
                 curr_state_time_spent += ts;
-                if (curr_state_time_spent > img_display_time_s) {
+                if (curr_state_time_spent > img_display_time_s && my_loader.new_image_has_been_loaded()) {
                     curr_state_time_spent = 0;
                     curr_state = FADING;
                     break;
                 }
-                else if (!my_loader.new_image_has_been_loaded() && curr_state_time_spent > img_display_time_s / 2) {
-                    if(!my_loader.load_next_image()) return 1;
+                else if (!my_loader.new_image_has_been_loaded() && !my_loader.load_in_progress() && curr_state_time_spent > img_display_time_s / 2) {
+                    my_loader.load_next_image();
                 }
             }
-            SDL_Delay(100); //slow down but allow polling for events every 100ms
+            //sleep until a key is pressed, an image is decoded or the next step of this state is due. Keep going while uploading strips.
+            {
+                int timeout_ms = -1; // paused, or the loader wakes us
+                if (my_loader.upload_in_progress()) timeout_ms = 1;
+                else if (!paused && curr_state_time_spent < img_display_time_s / 2) timeout_ms = ms_until(curr_state_time_spent, img_display_time_s / 2);
+                else if (!paused && curr_state_time_spent <= img_display_time_s) timeout_ms = ms_until(curr_state_time_spent, img_display_time_s);
+                idle.wait(timeout_ms);
+            }
             break;
 
         case FADING: 
@@ -136,7 +255,18 @@ int main(int, char**)
             
             if (done_fading) {
                 my_loader.switch_active_texture();
-                if (!my_loader.load_file_list()) return 1;
+#ifdef DEBUG
+                if (key_time) {
+                    const float key_ms = (SDL_GetTicksNS() - key_time) / 1000000.0f; //nanoseconds to milliseconds
+                    if (my_loader.showing_preview()) {
+                        SDL_Log("keypress to preview on screen in %.1fms (handled after %.2fms)", key_ms, key_handled / 1000000.0f);
+                    } else {
+                        SDL_Log("keypress to image on screen in %.1fms (handled after %.2fms)", key_ms, key_handled / 1000000.0f);
+                        key_time = 0;
+                    }
+                }
+#endif
+                my_loader.update_file_list(); //only what changed since the last fade, keeps the previous list if the folder cannot be read right now
                 curr_state_time_spent = 0;
                 curr_state = DISPLAY;
             }
@@ -144,6 +274,17 @@ int main(int, char**)
         }
 #ifdef DEBUG_RENDER
 	    SDL_Log("%f FPS", 1.0f/ts);
+#endif
+#ifdef DEBUG
+        if (crntTime - stats_time > 60000000000ull) { //nanoseconds
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            const float cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0f + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0f;
+            SDL_Log("last minute: %llu wakeups, %.0f ms CPU", (unsigned long long)(idle.get_wakeups() - stats_wakeups), cpu_ms - stats_cpu_ms);
+            stats_time = crntTime;
+            stats_wakeups = idle.get_wakeups();
+            stats_cpu_ms = cpu_ms;
+        }
 #endif
     }
 
@@ -0,0 +1,101 @@
+// Navigation latency under background decodes: how long an arrow key waits for its image while the prefetch of the next
+// one is still decoding, the case RPI_USE_PREEMPTIBLE_DECODE is for. Build it with the option on and off and compare.
+// Each round waits delay ms after the last image loaded, so the prefetch is busy, then asks for an image at user
+// priority: rounds alternate between the other direction (the prefetch is interrupted and dropped) and the image being
+// prefetched (it resumes). Only the next image is prefetched, no sidecars, no preview: every load is a jpg decode.
+// Use a folder of large jpgs, the decode has to take longer than the delay.
+//
+//   navigation_bench <folder> [rounds] [delay ms]
+//
+// IMG_DECODE_THREADS as for the slideshow. Opens the same window, the display size is the decode target.
+
+#include "SDL_GL_window.h"
+#include "load_image.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define DEFAULT_ROUNDS 20
+#define DEFAULT_DELAY_MS 10
+
+
+struct Latencies {
+    std::vector<float> ms;
+
+    void print(const char *what) {
+        if (ms.empty()) return;
+        std::sort(ms.begin(), ms.end());
+        float sum = 0;
+        for (float m : ms) sum += m;
+        printf("%s: %.1f ms average, %.1f median, %.1f min, %.1f max (%zu loads)\n", what, sum / ms.size(), ms[ms.size() / 2], ms.front(), ms.back(), ms.size());
+    }
+};
+
+
+// Keypress to loaded, -1 if the loader failed
+static float user_load(ImageLoader &loader, int dir) {
+    const auto start = std::chrono::steady_clock::now();
+    if (dir < 0) loader.load_prev_image(LoadPriority::USER);
+    else loader.load_next_image(LoadPriority::USER);
+    while (!loader.new_image_has_been_loaded()) {
+        if (!loader.update()) return -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    loader.switch_active_texture();
+    return ms;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <folder> [rounds] [delay ms]\n", argv[0]);
+        return 1;
+    }
+    const int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+    const int delay_ms = argc > 3 ? atoi(argv[3]) : DEFAULT_DELAY_MS;
+    const char* env_decode_threads = getenv("IMG_DECODE_THREADS");
+    const int decode_threads = env_decode_threads != nullptr ? atoi(env_decode_threads) : 0;
+
+    SDL_GL_window window;
+    ImageCacheConfig cache_config = { (size_t)512 * 1024 * 1024, 2, 1 }; // room for a decoded 24MP frame
+    SidecarConfig sidecar_config = { "", 0 };
+    ImageLoader loader(argv[1], window.get_display_width(), window.get_display_height(), cache_config, sidecar_config, decode_threads, "", "", "");
+    if (!loader.init_is_successful()) return 1;
+    loader.set_upload_budget(0);
+
+#ifdef USE_PREEMPTIBLE_DECODE
+    const char *preemptible = "on";
+#else
+    const char *preemptible = "off";
+#endif
+    printf("preemptible decode %s, display %dx%d, %d rounds, keys %d ms after the last load\n", preemptible,
+           window.get_display_width(), window.get_display_height(), rounds, delay_ms);
+
+    // the first load sets the direction the prefetch follows
+    if (user_load(loader, 1) < 0) return 1;
+
+    Latencies other, same;
+    int dir = 1;
+    for (int i = 0; i < rounds; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms)); // the prefetch is decoding the next image now
+        const bool turn = i % 2 == 0;
+        if (turn) dir = -dir;
+        const float ms = user_load(loader, dir);
+        if (ms < 0) {
+            printf("loading failed\n");
+            return 1;
+        }
+        (turn ? other : same).ms.push_back(ms);
+    }
+
+    other.print("other image");
+    same.print("image being prefetched");
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Parallel jpg decode speedup: decodes each jpg with one tjDecompress2 call and with ParallelJpegDecoder on 2 up to the
+// given number of threads, keeps the best of a few runs of each, checks that the rows are identical and prints the
+// speedup. Jpgs without restart markers are split by row ranges, progressive ones are not split at all.
+//
+//   parallel_bench <max threads> <jpg>...
+//
+// More threads than cores shows the cost of splitting, not a speedup.
+
+#include "parallel_jpeg.h"
+
+#include <turbojpeg.h>
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define RUNS 5
+
+
+static bool read_file(const char *path, std::vector<unsigned char> &data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    data.resize(file.tellg());
+    file.seekg(0, std::ios::beg);
+    return (bool)file.read((char*)data.data(), data.size());
+}
+
+// Best of RUNS, in ms. decode returns false on failure.
+template<typename F> static float best_ms(F decode) {
+    float best = -1;
+    for (int run = 0; run < RUNS; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!decode()) return -1;
+        const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: %s <max threads> <jpg>...\n", argv[0]);
+        return 1;
+    }
+    const int max_threads = atoi(argv[1]);
+    printf("%u cores, best of %d runs\n", std::thread::hardware_concurrency(), RUNS);
+
+    const int flags = TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE | TJFLAG_BOTTOMUP; // as the turbojpeg loader
+    const tjscalingfactor scales[] = { {1, 1}, {1, 2} };
+    tjhandle tj = tjInitDecompress();
+    bool all_identical = true;
+
+    for (int i = 2; i < argc; i++) {
+        std::vector<unsigned char> jpg;
+        int width, height, subsamp, colorspace;
+        if (!read_file(argv[i], jpg) || tjDecompressHeader3(tj, jpg.data(), jpg.size(), &width, &height, &subsamp, &colorspace) != 0) {
+            printf("%s: cannot read it\n", argv[i]);
+            continue;
+        }
+
+        for (const tjscalingfactor &scale : scales) {
+            const int w = TJSCALED(width, scale), h = TJSCALED(height, scale);
+            std::vector<unsigned char> single((size_t)w * h * 3), split_rows((size_t)w * h * 3);
+            const float single_ms = best_ms([&] { return tjDecompress2(tj, jpg.data(), jpg.size(), single.data(), w, 0, h, TJPF_RGB, flags) == 0; });
+            if (single_ms < 0) {
+                printf("%s: %s\n", argv[i], tjGetErrorStr());
+                break;
+            }
+            printf("%s %dx%d: %.1f ms on one thread\n", argv[i], w, h, single_ms);
+
+            for (int threads = 2; threads <= max_threads; threads++) {
+                ParallelJpegDecoder parallel(threads);
+                bool split = false;
+                const float ms = best_ms([&] { return parallel.decode_rgb(jpg.data(), jpg.size(), scale, flags, split_rows.data(), w, h, split) && split; });
+                if (ms < 0) {
+                    printf("  not split\n");
+                    break;
+                }
+                const bool identical = split_rows == single;
+                all_identical = all_identical && identical;
+                printf("  %d threads: %.1f ms, %.2fx%s\n", threads, ms, single_ms / ms, identical ? "" : ", rows DIFFER");
+            }
+        }
+    }
+
+    tjDestroy(tj);
+    return all_identical ? 0 : 1;
+}
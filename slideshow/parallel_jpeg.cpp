@@ -0,0 +1,338 @@
+#include "parallel_jpeg.h"
+
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <jpeglib.h>
+
+#include <SDL3/SDL.h>
+
+
+#define MIN_SLICE_ROWS 64       // output rows, thinner slices are not worth a thread
+#define ENTROPY_SHARE 0.4f      // of the decode time spent in the huffman decoder, repeated by row range slices for the rows above them
+
+
+static int read16(const unsigned char *p) { return (p[0] << 8) | p[1]; }
+
+
+ParallelJpegDecoder::ParallelJpegDecoder(int num_threads) :
+    threads(num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    for (int i = 0; i < threads; i++) {
+        tjhandle handle = tjInitDecompress();
+        if (!handle) break;
+        handles.push_back(handle);
+    }
+    threads = std::max<int>(1, handles.size());
+    slice_jpgs.resize(threads);
+}
+
+ParallelJpegDecoder::~ParallelJpegDecoder() {
+    for (tjhandle handle : handles) tjDestroy(handle);
+}
+
+
+// Walk the markers up to the scan, then find every restart marker in it.
+// Returns false for anything but a sequential huffman jpg with a single interleaved scan.
+bool ParallelJpegDecoder::parse_layout(const unsigned char *jpg, size_t jpg_len) {
+    layout = Layout();
+    if (jpg_len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8) return false;
+
+    int h_max = 1, v_max = 1;
+    bool have_frame = false;
+    size_t pos = 2;
+    while (true) {
+        if (pos + 4 > jpg_len || jpg[pos] != 0xFF) return false;
+        while (pos < jpg_len && jpg[pos] == 0xFF) pos++; // fill bytes
+        if (pos + 3 > jpg_len) return false;
+
+        const unsigned char marker = jpg[pos++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue; // no length
+        if (marker == 0xD9) return false; // no scan at all
+
+        const size_t segment_len = read16(jpg + pos);
+        if (segment_len < 2 || pos + segment_len > jpg_len) return false;
+        const unsigned char *segment = jpg + pos + 2;
+
+        if (marker == 0xC0 || marker == 0xC1) { // baseline, extended sequential
+            if (segment_len < 8) return false;
+            layout.sof_height = pos + 3;
+            layout.height = read16(segment + 1);
+            layout.width = read16(segment + 3);
+            layout.num_components = segment[5];
+            if (layout.height == 0 || layout.width == 0 || segment_len < 8 + 3 * (size_t)layout.num_components) return false; // height 0: comes later in a DNL marker
+            for (int c = 0; c < layout.num_components; c++) {
+                h_max = std::max(h_max, segment[6 + 3*c + 1] >> 4);
+                v_max = std::max(v_max, segment[6 + 3*c + 1] & 15);
+            }
+            have_frame = true;
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            return false; // progressive, lossless or arithmetic coded
+        } else if (marker == 0xDD) {
+            if (segment_len < 4) return false;
+            layout.restart_interval = read16(segment);
+        } else if (marker == 0xDA) {
+            if (!have_frame || segment[0] != layout.num_components) return false; // one scan per component
+            layout.scan_start = pos + segment_len;
+            break;
+        }
+        pos += segment_len;
+    }
+
+    // a single component scan is not interleaved, its MCU is one block whatever the sampling factors say
+    layout.mcu_w = layout.num_components == 1 ? 8 : 8 * h_max;
+    layout.mcu_h = layout.num_components == 1 ? 8 : 8 * v_max;
+    layout.mcus_per_row = (layout.width + layout.mcu_w - 1) / layout.mcu_w;
+    layout.mcu_rows = (layout.height + layout.mcu_h - 1) / layout.mcu_h;
+
+    // 0xFF in entropy coded data is always followed by a stuffed 0x00 or by a marker
+    const unsigned char *p = jpg + layout.scan_start, *end = jpg + jpg_len;
+    while ((p = (const unsigned char*)memchr(p, 0xFF, end - p)) && p + 1 < end) {
+        const unsigned char marker = p[1];
+        if (marker >= 0xD0 && marker <= 0xD7) {
+            layout.restarts.push_back(p - jpg);
+        } else if (marker == 0xD9) {
+            layout.scan_end = p - jpg;
+            return true;
+        } else if (marker != 0x00 && marker != 0xFF) {
+            return false; // another scan or a DNL marker
+        }
+        p++;
+    }
+    return false; // truncated
+}
+
+
+// Output rows of one MCU row, 0 if the scaling does not give a whole number
+static int scaled_mcu_height(int mcu_h, tjscalingfactor scale) {
+    return (mcu_h * scale.num) % scale.denom == 0 ? mcu_h * scale.num / scale.denom : 0;
+}
+
+
+// Cut at the restart markers that start an MCU row, as evenly as they allow
+bool ParallelJpegDecoder::plan_restart_slices(tjscalingfactor scale, int height) {
+    slices.clear();
+    const Layout &l = layout;
+    if (l.restart_interval <= 0) return false;
+
+    const long total_mcus = (long)l.mcus_per_row * l.mcu_rows;
+    if ((long)l.restarts.size() != (total_mcus + l.restart_interval - 1) / l.restart_interval - 1) return false; // markers missing, corrupt file
+
+    const int out_mcu_h = scaled_mcu_height(l.mcu_h, scale);
+    const int count = std::min(threads, out_mcu_h * l.mcu_rows / MIN_SLICE_ROWS);
+    if (out_mcu_h <= 0 || count < 2) return false;
+
+    int first = 0;
+    for (int i = 1; i <= count; i++) {
+        int end = (int)((long)l.mcu_rows * i / count);
+        while (end < l.mcu_rows && ((long)end * l.mcus_per_row) % l.restart_interval != 0) end++;
+        if (end <= first) continue;
+
+        const int pixel_rows = std::min(end * l.mcu_h, l.height) - first * l.mcu_h;
+        slices.push_back(Slice{ first, end - first, first * out_mcu_h, TJSCALED(pixel_rows, scale) });
+        first = end;
+    }
+    return slices.size() >= 2 && slices.back().first_row + slices.back().rows == height;
+}
+
+
+// Later slices repeat the huffman decode of every row above them, so they get fewer rows. With e = ENTROPY_SHARE
+// slice k costs e * first_k + rows_k, which is the same for every slice when first_k = T * (1 - (1 - e)^k) / e.
+bool ParallelJpegDecoder::plan_row_slices(tjscalingfactor scale, int height) {
+    slices.clear();
+    const Layout &l = layout;
+
+    const int out_mcu_h = scaled_mcu_height(l.mcu_h, scale);
+    const int count = std::min(threads, out_mcu_h * l.mcu_rows / MIN_SLICE_ROWS);
+    if (out_mcu_h <= 0 || count < 2) return false;
+
+    const float e = ENTROPY_SHARE;
+    const float slice_cost = l.mcu_rows * e / (1.0f - powf(1.0f - e, count));
+    int first = 0;
+    for (int i = 1; i <= count; i++) {
+        int end = i == count ? l.mcu_rows : (int)lroundf(slice_cost * (1.0f - powf(1.0f - e, i)) / e);
+        end = std::min(end, l.mcu_rows);
+        if (end <= first) continue;
+
+        const int pixel_rows = std::min(end * l.mcu_h, l.height) - first * l.mcu_h;
+        slices.push_back(Slice{ first, end - first, first * out_mcu_h, TJSCALED(pixel_rows, scale) });
+        first = end;
+    }
+    return slices.size() >= 2 && slices.back().first_row + slices.back().rows == height;
+}
+
+
+// A standalone jpg holding only the restart intervals of slice: the original header with the height of the slice,
+// then its entropy coded data with the restart markers numbered from 0 again.
+void ParallelJpegDecoder::build_slice_jpg(const unsigned char *jpg, const Slice &slice, std::vector<unsigned char> &out) {
+    const Layout &l = layout;
+    const int end_mcu_row = slice.first_mcu_row + slice.mcu_rows;
+    const bool last = end_mcu_row >= l.mcu_rows;
+    const int first_interval = (long)slice.first_mcu_row * l.mcus_per_row / l.restart_interval;
+    const int end_interval = last ? l.restarts.size() + 1 : (long)end_mcu_row * l.mcus_per_row / l.restart_interval;
+    const size_t data_start = first_interval == 0 ? l.scan_start : l.restarts[first_interval - 1] + 2;
+    const size_t data_end = last ? l.scan_end : l.restarts[end_interval - 1];
+    const int pixel_rows = std::min(end_mcu_row * l.mcu_h, l.height) - slice.first_mcu_row * l.mcu_h;
+
+    out.resize(l.scan_start + (data_end - data_start) + 2);
+    memcpy(out.data(), jpg, l.scan_start);
+    out[l.sof_height] = pixel_rows >> 8;
+    out[l.sof_height + 1] = pixel_rows & 0xFF;
+
+    memcpy(out.data() + l.scan_start, jpg + data_start, data_end - data_start);
+    for (int i = first_interval; i < end_interval - 1; i++) {
+        out[l.scan_start + (l.restarts[i] - data_start) + 1] = 0xD0 + ((i - first_interval) & 7);
+    }
+
+    out[out.size() - 2] = 0xFF;
+    out[out.size() - 1] = 0xD9;
+}
+
+
+// Slice 0 on the calling thread, the others on their own
+template<typename F> bool ParallelJpegDecoder::run_slices(int count, F decode_slice) {
+    std::vector<char> success(count, 0);
+    std::vector<std::thread> workers;
+    for (int i = 1; i < count; i++) workers.emplace_back([&, i] { success[i] = decode_slice(i); });
+    success[0] = decode_slice(0);
+    for (auto &worker : workers) worker.join();
+    return std::all_of(success.begin(), success.end(), [](char s) { return s != 0; });
+}
+
+
+struct LibjpegError {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void on_libjpeg_error(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    SDL_Log("libjpeg: %s", message);
+    longjmp(((LibjpegError*)cinfo->err)->jump, 1);
+}
+
+
+// Rows [first_row, first_row + rows) of the whole jpg, with the same settings tjDecompress2 uses for flags
+static bool decode_rows(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, int flags, unsigned char *dst, int width, int height, int first_row, int rows) {
+    struct jpeg_decompress_struct cinfo;
+    LibjpegError err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = on_libjpeg_error;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char*)jpg, jpg_len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = scale.num;
+    cinfo.scale_denom = scale.denom;
+    cinfo.dct_method = (flags & TJFLAG_FASTDCT) ? JDCT_IFAST : JDCT_ISLOW;
+    cinfo.do_fancy_upsampling = (flags & TJFLAG_FASTUPSAMPLE) ? FALSE : TRUE;
+    jpeg_start_decompress(&cinfo);
+
+    if ((int)cinfo.output_width != width || (int)cinfo.output_height != height || cinfo.output_components != 3) {
+        SDL_Log("libjpeg decodes to %ux%u, expected %dx%d", cinfo.output_width, cinfo.output_height, width, height);
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    if (first_row > 0) jpeg_skip_scanlines(&cinfo, first_row); // huffman decode only
+
+    const size_t pitch = (size_t)width * 3;
+    const bool bottom_up = flags & TJFLAG_BOTTOMUP;
+    JSAMPROW row_pointers[16];
+    while ((int)cinfo.output_scanline < first_row + rows) {
+        const int y = cinfo.output_scanline;
+        const int n = std::min(16, first_row + rows - y);
+        for (int i = 0; i < n; i++) row_pointers[i] = dst + (size_t)(bottom_up ? height - 1 - (y + i) : y + i) * pitch;
+        jpeg_read_scanlines(&cinfo, row_pointers, n);
+    }
+
+    jpeg_destroy_decompress(&cinfo); // rows below the slice are never decoded
+    return true;
+}
+
+
+bool ParallelJpegDecoder::decode_rgb(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, int flags, unsigned char *dst, int width, int height, bool &split) {
+    split = false;
+    if (threads < 2 || !(flags & TJFLAG_FASTUPSAMPLE) || !parse_layout(jpg, jpg_len)) return false;
+    if (TJSCALED(layout.width, scale) != width || TJSCALED(layout.height, scale) != height) return false;
+
+    const size_t pitch = (size_t)width * 3;
+    const bool bottom_up = flags & TJFLAG_BOTTOMUP;
+
+    if (plan_restart_slices(scale, height)) {
+        split = true;
+        for (size_t i = 0; i < slices.size(); i++) build_slice_jpg(jpg, slices[i], slice_jpgs[i]);
+#ifdef DEBUG
+        SDL_Log("decoding in %zu slices split at restart markers", slices.size());
+#endif
+        return run_slices(slices.size(), [&](int i) {
+            const Slice &s = slices[i];
+            unsigned char *rows = dst + (bottom_up ? height - s.first_row - s.rows : s.first_row) * pitch;
+            if (tjDecompress2(handles[i], slice_jpgs[i].data(), slice_jpgs[i].size(), rows, width, pitch, s.rows, TJPF_RGB, flags) != 0) {
+                SDL_Log("TurboJPEG decompress of slice %d failed: %s", i, tjGetErrorStr2(handles[i]));
+                return false;
+            }
+            return true;
+        });
+    }
+
+    if (plan_row_slices(scale, height)) {
+        split = true;
+#ifdef DEBUG
+        SDL_Log("decoding in %zu row range slices", slices.size());
+#endif
+        return run_slices(slices.size(), [&](int i) {
+            return decode_rows(jpg, jpg_len, scale, flags, dst, width, height, slices[i].first_row, slices[i].rows);
+        });
+    }
+
+    return false;
+}
+
+
+bool ParallelJpegDecoder::can_split(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, bool yuv) {
+    if (threads < 2 || !parse_layout(jpg, jpg_len)) return false;
+    const int height = TJSCALED(layout.height, scale);
+    return plan_restart_slices(scale, height) || (!yuv && plan_row_slices(scale, height));
+}
+
+
+bool ParallelJpegDecoder::decode_yuv(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, int flags, int subsamp,
+                                     unsigned char *planes[3], const int plane_w[3], int width, int height, bool &split) {
+    split = false;
+    if (threads < 2 || !(flags & TJFLAG_FASTUPSAMPLE) || !parse_layout(jpg, jpg_len)) return false;
+    if (TJSCALED(layout.width, scale) != width || TJSCALED(layout.height, scale) != height) return false;
+    if (!plan_restart_slices(scale, height)) return false; // no row range fallback, libjpeg cannot skip raw rows
+
+    split = true;
+    for (size_t i = 0; i < slices.size(); i++) build_slice_jpg(jpg, slices[i], slice_jpgs[i]);
+#ifdef DEBUG
+    SDL_Log("decoding to YUV in %zu slices split at restart markers", slices.size());
+#endif
+
+    const int num_planes = subsamp == TJSAMP_GRAY ? 1 : 3;
+    return run_slices(slices.size(), [&](int i) {
+        const Slice &s = slices[i];
+        unsigned char *slice_planes[3] = {nullptr, nullptr, nullptr};
+        int strides[3] = {0, 0, 0};
+        for (int p = 0; p < num_planes; p++) {
+            const int plane_row = s.first_row > 0 ? tjPlaneHeight(p, s.first_row, subsamp) : 0;
+            slice_planes[p] = planes[p] + (size_t)plane_row * plane_w[p];
+            strides[p] = plane_w[p];
+        }
+        if (tjDecompressToYUVPlanes(handles[i], slice_jpgs[i].data(), slice_jpgs[i].size(), slice_planes, width, strides, s.rows, flags) != 0) {
+            SDL_Log("TurboJPEG decompress of slice %d failed: %s", i, tjGetErrorStr2(handles[i]));
+            return false;
+        }
+        return true;
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <turbojpeg.h>
+
+
+// Decodes one jpg on several cores, each thread writes its own rows of the output. Two ways to split it:
+// - restart markers that fall on MCU row boundaries: every slice becomes a standalone jpg (the header plus its
+//   restart intervals) and is decoded with its own tjhandle, no work is repeated.
+// - otherwise row ranges with libjpeg: every thread still huffman decodes the rows above its range, but skips their
+//   IDCT, upsampling and color conversion (jpeg_skip_scanlines), which is most of the work.
+// Only sequential jpgs with a single scan are split, progressive ones are left to the caller.
+// Rows come out identical to a single tjDecompress2 call as long as TJFLAG_FASTUPSAMPLE is set: without it
+// chroma is smoothed across MCU rows and the slice borders would differ.
+class ParallelJpegDecoder {
+public:
+    ParallelJpegDecoder(int threads); // 0: one per core
+    ~ParallelJpegDecoder();
+
+    int get_threads() { return threads; }
+
+    // Decode to packed RGB into dst (width x height at scale, pitch width*3), as tjDecompress2 with flags would.
+    // split is false if the jpg was not worth splitting, nothing was decoded then.
+    bool decode_rgb(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, int flags, unsigned char *dst, int width, int height, bool &split);
+
+    // Decode to Y/Cb/Cr planes laid out as by tjDecompressToYUVPlanes (top-down, plane_w pitch). Restart markers only.
+    bool decode_yuv(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, int flags, int subsamp,
+                    unsigned char *planes[3], const int plane_w[3], int width, int height, bool &split);
+
+    // Whether decode_yuv (yuv) or decode_rgb would split jpg at scale, with TJFLAG_FASTUPSAMPLE. Decodes nothing.
+    bool can_split(const unsigned char *jpg, size_t jpg_len, tjscalingfactor scale, bool yuv);
+
+private:
+    struct Layout {
+        int width = 0, height = 0;
+        int num_components = 0;
+        int mcu_w = 8, mcu_h = 8;
+        int mcus_per_row = 0, mcu_rows = 0;
+        int restart_interval = 0;       // in MCUs, 0 if there are no restart markers
+        size_t sof_height = 0;          // offset of the height in the frame header
+        size_t scan_start = 0;          // first byte of entropy coded data
+        size_t scan_end = 0;            // offset of the EOI marker
+        std::vector<size_t> restarts;   // offset of every RST marker
+    };
+
+    struct Slice {
+        int first_mcu_row, mcu_rows;
+        int first_row, rows; // output rows, after scaling
+    };
+
+    bool parse_layout(const unsigned char *jpg, size_t jpg_len);
+    bool plan_restart_slices(tjscalingfactor scale, int height);
+    bool plan_row_slices(tjscalingfactor scale, int height);
+    void build_slice_jpg(const unsigned char *jpg, const Slice &slice, std::vector<unsigned char> &out);
+    template<typename F> bool run_slices(int count, F decode_slice);
+
+private:
+    int threads;
+    std::vector<tjhandle> handles; // one per thread
+    std::vector<std::vector<unsigned char>> slice_jpgs; // reused between images
+    Layout layout;
+    std::vector<Slice> slices;
+};
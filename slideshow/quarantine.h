@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+#include "catalog.h"
+
+
+// Files that could not be decoded, so they are skipped instead of read and decoded again on every pass.
+// An entry only holds for the size and mtime the file had when it failed: a file that was still being copied
+// gets another chance once it changes. Kept in a small text file, one "<size> <mtime ns> <path>" line per entry,
+// so the list survives restarts. Thread safe.
+class Quarantine {
+public:
+    // file: where the list is kept, empty keeps it in memory only
+    // catalog: of the folder the file may be in, it is kept up to date across saves of the list
+    Quarantine(const std::string &file, Catalog &catalog);
+
+    // true if path failed before and has not changed since. Only quarantined paths are stat()ed.
+    bool contains(const std::string &path);
+
+    // Skip path from now on, until it changes
+    void add(const std::string &path);
+
+    size_t size();
+
+private:
+    struct Entry {
+        uint64_t size;
+        int64_t mtime_ns;
+    };
+
+    bool stat_entry(const std::string &path, Entry &entry);
+    void save(); // mutex must be held
+
+private:
+    const std::string file;
+    Catalog &catalog;
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries; // by path
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+// RGB888 (or RGBA8888) to RGB565, resampled to a fixed size on the way (nearest neighbour) so every frame fits the
+// same display sized texture. A 4x4 ordered dither hides the banding 5 and 6 bit channels leave in smooth gradients.
+// The packing runs on NEON or SSE2 where available, the result is the same as the scalar code.
+class Rgb565Converter {
+public:
+    // src_bpp: 3 or 4, alpha is dropped
+    Rgb565Converter(int src_w, int src_h, int src_bpp, int dst_w, int dst_h);
+
+    // The source row that dst_row is made of. Grows with dst_row.
+    int src_row(int dst_row) { return (int)(((int64_t)dst_row * 2 + 1) * src_h / (2 * (int64_t)dst_h)); }
+
+    // Write dst_row (dst_w pixels) from src, which points at source row src_row(dst_row)
+    void convert_row(const unsigned char *src, int dst_row, uint16_t *dst);
+
+    // Whole frame, src rows src_w * src_bpp bytes apart, dst rows dst_w pixels apart
+    void convert(const unsigned char *src, uint16_t *dst);
+
+private:
+    const int src_w, src_h, src_bpp, dst_w, dst_h;
+    std::vector<int> src_offset;                // byte offset in the source row of every output pixel
+    std::vector<unsigned char> red, green, blue; // one output row, deinterleaved for the SIMD code
+};
@@ -0,0 +1,97 @@
+#include "shuffle.h"
+
+#include <cstdio>
+#include <cinttypes>
+#include <random>
+#include <unistd.h>
+
+#include <SDL3/SDL.h>
+
+
+#define SHUFFLE_ROUNDS 4 // enough to look random, this is a slideshow and not a cipher
+
+
+static uint64_t mix64(uint64_t x) { // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+
+void ShuffleOrder::set_size(uint32_t size) {
+    n = size;
+    half_bits = 1;
+    while (half_bits < 16 && ((uint64_t)1 << (2 * half_bits)) < n) half_bits++;
+    half_mask = ((uint32_t)1 << half_bits) - 1;
+}
+
+
+uint32_t ShuffleOrder::round_key(int round, uint32_t half) const {
+    return mix64(seed ^ ((uint64_t)(round + 1) << 32) ^ half) & half_mask;
+}
+
+
+uint32_t ShuffleOrder::permute(uint32_t x) const {
+    uint32_t left = x >> half_bits, right = x & half_mask;
+    for (int round = 0; round < SHUFFLE_ROUNDS; round++) {
+        const uint32_t next = left ^ round_key(round, right);
+        left = right;
+        right = next;
+    }
+    return (left << half_bits) | right;
+}
+
+
+uint32_t ShuffleOrder::unpermute(uint32_t x) const {
+    uint32_t left = x >> half_bits, right = x & half_mask;
+    for (int round = SHUFFLE_ROUNDS - 1; round >= 0; round--) {
+        const uint32_t prev = right ^ round_key(round, left);
+        right = left;
+        left = prev;
+    }
+    return (left << half_bits) | right;
+}
+
+
+// Walking the cycle of step through the domain until it lands inside [0, n). The way back walks the same cycle
+// backwards, so it stops at step again.
+uint32_t ShuffleOrder::position(uint32_t step) const {
+    uint32_t x = permute(step % n);
+    while (x >= n) x = permute(x);
+    return x;
+}
+
+
+uint32_t ShuffleOrder::step(uint32_t position) const {
+    uint32_t x = unpermute(position % n);
+    while (x >= n) x = unpermute(x);
+    return x;
+}
+
+
+uint64_t load_shuffle_seed(const std::string &file) {
+    uint64_t seed = 0;
+    if (!file.empty()) {
+        FILE *f = fopen(file.c_str(), "r");
+        bool found = f && fscanf(f, "%" SCNu64, &seed) == 1;
+        if (f) fclose(f);
+        if (found) return seed;
+    }
+
+    std::random_device random;
+    seed = ((uint64_t)random() << 32) ^ random();
+    if (file.empty()) return seed;
+
+    // through a temporary file, a crash must not leave an empty one behind and change the order
+    const std::string tmp_path = file + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    bool written = f && fprintf(f, "%" PRIu64 "\n", seed) > 0;
+    if (f) written = fclose(f) == 0 && written;
+    if (!written || rename(tmp_path.c_str(), file.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        SDL_Log("Cannot write %s, the shuffle order changes on the next start", file.c_str());
+    }
+    return seed;
+}
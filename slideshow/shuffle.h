@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+// A pseudo-random order of n files that needs no list of them: a Feistel network permutes [0, 4^k) with the
+// smallest 4^k >= n, and values past n are skipped by applying it again (cycle walking, below 4 rounds on average).
+// Every file comes once per cycle. Both directions take constant time and memory, the same seed gives the same order.
+// When n changes the order is a different one. Not thread safe.
+class ShuffleOrder {
+public:
+    ShuffleOrder(uint64_t seed = 0) : seed(seed) { set_size(0); }
+
+    void set_size(uint32_t n);
+    uint32_t size() const { return n; }
+
+    // Position (in the file list) of the file at step of the order, and back. n must not be 0.
+    uint32_t position(uint32_t step) const;
+    uint32_t step(uint32_t position) const;
+
+private:
+    uint32_t round_key(int round, uint32_t half) const;
+    uint32_t permute(uint32_t x) const;
+    uint32_t unpermute(uint32_t x) const;
+
+private:
+    uint64_t seed;
+    uint32_t n;
+    int half_bits;
+    uint32_t half_mask;
+};
+
+// The seed kept in file, a new random one is written there if it has none. Empty file: a new one on every start.
+uint64_t load_shuffle_seed(const std::string &file);
@@ -0,0 +1,326 @@
+#include "sidecar_cache.h"
+#include "load_image.h"
+
+#include <filesystem>
+#include <cstring>
+#include <vector>
+#include <ctime>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengles2.h>
+
+
+static const char SIDECAR_MAGIC[4] = {'R', 'P', 'F', 'R'};
+static const uint32_t SIDECAR_VERSION = 3;
+static const char *SIDECAR_EXTENSION = ".frame";
+static const int SIDECAR_BAND_ROWS = 32; // rows of a streamed frame written at a time
+
+
+static int64_t to_ns(const struct timespec &ts) { return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec; }
+
+static int64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now); // same clock as the file times read at startup
+    return to_ns(now);
+}
+
+
+static int packed_bytes_per_pixel(unsigned int pixel_format, unsigned int pixel_type) {
+    if (pixel_type == GL_UNSIGNED_SHORT_5_6_5) return 2;
+    return pixel_format == GL_RGBA ? 4 : pixel_format == GL_RGB ? 3 : 1;
+}
+
+// bytes of pixel data a frame of these dimensions has, laid out like DecodedImage
+static size_t payload_size(int width, int height, int num_planes, const int32_t plane_w[3], const int32_t plane_h[3], unsigned int pixel_format, unsigned int pixel_type) {
+    if (num_planes == 0) return (size_t)width * height * packed_bytes_per_pixel(pixel_format, pixel_type);
+    size_t size = 0;
+    for (int i = 0; i < num_planes; i++) size += (size_t)plane_w[i] * plane_h[i];
+    return size;
+}
+
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+
+SidecarCache::SidecarCache(const SidecarConfig &config, int w, int h) :
+    cfg(config), width(w), height(h)
+{
+    if (cfg.budget_bytes == 0 || cfg.dir.empty()) return;
+
+    namespace fs = std::filesystem;
+    try {
+        fs::create_directories(cfg.dir);
+        for (const auto& entry : fs::directory_iterator(cfg.dir)) {
+            const std::string name = entry.path().filename().string();
+            if (!entry.is_regular_file()) continue;
+            if (entry.path().extension() != SIDECAR_EXTENSION) {
+                if (entry.path().extension() == ".tmp") fs::remove(entry.path()); // interrupted store
+                continue;
+            }
+
+            struct stat st;
+            if (stat(entry.path().c_str(), &st) != 0) continue;
+            entries[name] = Entry{ (size_t)st.st_size, to_ns(st.st_atim) };
+            bytes_used += st.st_size;
+        }
+    } catch (const fs::filesystem_error& e) {
+        SDL_Log("Sidecar cache disabled, %s", e.what());
+        return;
+    }
+
+    ready = true;
+    evict_for(0); // budget may have been lowered since the last run
+
+#ifdef DEBUG
+    SDL_Log("sidecar cache: %zu frames, %zu of %zu bytes in %s", entries.size(), bytes_used, cfg.budget_bytes, cfg.dir.c_str());
+#endif
+}
+
+
+std::string SidecarCache::sidecar_path(const std::string &source) {
+    return cfg.dir + "/" + std::filesystem::path(source).filename().string() + SIDECAR_EXTENSION;
+}
+
+
+// Everything a sidecar of source has to match, except the image itself
+bool SidecarCache::make_header(const std::string &source, Header &header) {
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0) return false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIDECAR_MAGIC, sizeof(header.magic));
+    header.version = SIDECAR_VERSION;
+    header.source_size = st.st_size;
+    header.source_mtime_ns = to_ns(st.st_mtim);
+    header.target_w = width;
+    header.target_h = height;
+    return true;
+}
+
+
+bool SidecarCache::header_matches(const Header &expected, const Header &found, size_t file_size) {
+    if (memcmp(found.magic, expected.magic, sizeof(found.magic)) != 0 || found.version != expected.version) return false;
+    if (found.source_size != expected.source_size || found.source_mtime_ns != expected.source_mtime_ns) return false;
+    if (found.target_w != expected.target_w || found.target_h != expected.target_h) return false;
+    if (found.pixel_format != GL_RGB && found.pixel_format != GL_RGBA) return false;
+    if (found.pixel_type != GL_UNSIGNED_BYTE && (found.pixel_type != GL_UNSIGNED_SHORT_5_6_5 || found.pixel_format != GL_RGB)) return false;
+    if (found.width <= 0 || found.height <= 0 || found.width > 16384 || found.height > 16384) return false;
+    if (found.num_planes != 0 && found.num_planes != 1 && found.num_planes != 3) return false;
+
+    for (int i = 0; i < 3; i++) {
+        if (found.plane_w[i] < 0 || found.plane_h[i] < 0 || found.plane_w[i] > 16384 || found.plane_h[i] > 16384) return false;
+    }
+
+    // a truncated file (power cut during a store) must not be uploaded
+    return found.payload_size == payload_size(found.width, found.height, found.num_planes, found.plane_w, found.plane_h, found.pixel_format, found.pixel_type) && 
+           file_size == sizeof(Header) + found.payload_size;
+}
+
+
+void SidecarCache::remove(std::string name) { // by value, callers pass keys of entries
+    auto it = entries.find(name);
+    if (it != entries.end()) {
+        bytes_used -= it->second.bytes;
+        entries.erase(it);
+    }
+    unlink((cfg.dir + "/" + name).c_str());
+}
+
+
+// Remove least recently used sidecars until bytes more fit in the budget
+bool SidecarCache::evict_for(size_t bytes) {
+    if (bytes > cfg.budget_bytes) return false;
+
+    while (bytes_used + bytes > cfg.budget_bytes && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second.last_used_ns < oldest->second.last_used_ns) oldest = it;
+        }
+        remove(oldest->first);
+        stats.evictions++;
+    }
+    return true;
+}
+
+
+bool SidecarCache::is_fresh(const std::string &source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready) return false;
+
+    Header expected, found;
+    if (!make_header(source, expected)) return false;
+
+    int fd = open(sidecar_path(source).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    bool fresh = fstat(fd, &st) == 0 && pread(fd, &found, sizeof(found), 0) == (ssize_t)sizeof(found) &&
+                 header_matches(expected, found, st.st_size);
+    close(fd);
+    return fresh;
+}
+
+
+bool SidecarCache::load(const std::string &source, DecodedImagePtr &img_out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready) return false;
+
+    const std::string path = sidecar_path(source);
+    const std::string name = std::filesystem::path(path).filename().string();
+
+    Header expected;
+    if (!make_header(source, expected)) return false;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        stats.misses++;
+        return false;
+    }
+
+    Header found;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || pread(fd, &found, sizeof(found), 0) != (ssize_t)sizeof(found) || !header_matches(expected, found, st.st_size)) {
+        close(fd);
+        SDL_Log("Sidecar of %s is stale, removing it", source.c_str());
+        stats.stale++;
+        remove(name);
+        return false;
+    }
+
+    // MAP_POPULATE: fault every page in now, on the worker, instead of during the upload on the GL thread
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    struct timespec times[2] = { {0, UTIME_NOW}, {0, UTIME_OMIT} }; // atime is the LRU order
+    futimens(fd, times);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        stats.misses++;
+        return false;
+    }
+
+    auto mapping = std::make_shared<FileBuffer>(nullptr);
+    mapping->data = (unsigned char*)mem;
+    mapping->size = st.st_size;
+
+    auto img = std::make_shared<DecodedImage>();
+    img->mapping = mapping;
+    img->pixeldata = mapping->data + sizeof(Header);
+    img->pixeldata_len = found.payload_size;
+    img->format = found.pixel_format;
+    img->type = found.pixel_type;
+    img->width = found.width;
+    img->height = found.height;
+    img->num_planes = found.num_planes;
+    for (int i = 0; i < 3; i++) {
+        img->plane_w[i] = found.plane_w[i];
+        img->plane_h[i] = found.plane_h[i];
+    }
+    img->top_down = found.top_down != 0;
+    img->path = source;
+
+    auto it = entries.find(name);
+    if (it != entries.end()) {
+        it->second.last_used_ns = now_ns();
+    } else { // not seen by the startup scan
+        entries[name] = Entry{ mapping->size, now_ns() };
+        bytes_used += mapping->size;
+    }
+    stats.hits++;
+    img_out = img;
+    return true;
+}
+
+
+bool SidecarCache::store(const std::string &source, const DecodedImage &img) {
+    if (!img.pixeldata) return false;
+    return write_sidecar(source, img, [&](int fd, size_t size) {
+        return (!img.pixeldata_len || img.pixeldata_len >= size) && write_all(fd, img.pixeldata, size);
+    });
+}
+
+
+bool SidecarCache::store(const std::string &source, const DecodedImage &img, const std::function<int(unsigned char *rows, int max_rows)> &read_rows) {
+    if (img.num_planes != 0) return false;
+    return write_sidecar(source, img, [&](int fd, size_t size) {
+        const size_t pitch = (size_t)img.width * packed_bytes_per_pixel(img.format, img.type);
+        std::vector<unsigned char> band(pitch * SIDECAR_BAND_ROWS);
+        for (int row = 0; row < img.height; ) {
+            const int rows = read_rows(band.data(), SIDECAR_BAND_ROWS);
+            if (rows <= 0 || !write_all(fd, band.data(), rows * pitch)) return false;
+            row += rows;
+        }
+        return size == pitch * img.height;
+    });
+}
+
+
+// write_payload gets the temporary file positioned after the header
+bool SidecarCache::write_sidecar(const std::string &source, const DecodedImage &img, const std::function<bool(int fd, size_t payload_size)> &write_payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready || img.width <= 0 || img.height <= 0) return false;
+
+    Header header;
+    if (!make_header(source, header)) return false;
+    header.pixel_format = img.format;
+    header.pixel_type = img.type;
+    header.width = img.width;
+    header.height = img.height;
+    header.num_planes = img.num_planes;
+    for (int i = 0; i < 3; i++) {
+        header.plane_w[i] = img.plane_w[i];
+        header.plane_h[i] = img.plane_h[i];
+    }
+    header.top_down = img.top_down;
+    header.payload_size = payload_size(img.width, img.height, img.num_planes, header.plane_w, header.plane_h, header.pixel_format, header.pixel_type);
+
+    const std::string path = sidecar_path(source);
+    const std::string name = std::filesystem::path(path).filename().string();
+    const size_t bytes = sizeof(Header) + header.payload_size;
+
+    remove(name); // replaced, do not count it twice
+    if (!evict_for(bytes)) return false;
+
+    // write under a temporary name and rename, a sidecar is either complete or missing
+    const std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        SDL_Log("Failed to create %s", tmp_path.c_str());
+        return false;
+    }
+
+    bool written = write_all(fd, &header, sizeof(header)) && write_payload(fd, header.payload_size);
+    written = close(fd) == 0 && written;
+    if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        SDL_Log("Failed to write %s", path.c_str());
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    entries[name] = Entry{ bytes, now_ns() };
+    bytes_used += bytes;
+    stats.stores++;
+    return true;
+}
+
+
+SidecarStats SidecarCache::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.bytes_used = bytes_used;
+    stats.entries = entries.size();
+    return stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+#include "image_cache.h"
+
+
+struct SidecarConfig {
+    std::string dir;        // created if missing, should live on the same drive as the images
+    size_t budget_bytes;    // least recently used sidecars are removed past this, 0 disables the cache
+};
+
+struct SidecarStats {
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    unsigned long stale = 0;    // source changed or display mode changed, sidecar removed
+    unsigned long stores = 0;
+    unsigned long evictions = 0;
+    size_t bytes_used = 0;
+    int entries = 0;
+};
+
+
+// On disk cache of decoded frames: one "<image name>.frame" file per image, a fixed header followed by the
+// pixel data exactly as the GL thread uploads it. Loading one is a single mmap, no decode at all.
+// A sidecar is only valid for the size and mtime of its source image and for the display mode it was decoded for.
+// Frames keep the pixel format of the decoder that produced them (or RGB565, see USE_RGB565).
+// Thread safe, but calls hold a lock for their disk io: only the loader worker should load and store.
+class SidecarCache {
+public:
+    // width x height: the size images are decoded for
+    SidecarCache(const SidecarConfig &config, int width, int height);
+
+    bool enabled() { return ready; }
+
+    // Map the sidecar of source into img. Returns false if there is none or it is stale (stale ones are removed).
+    // Pages are read in here, so the upload never waits for the disk.
+    bool load(const std::string &source, DecodedImagePtr &img_out);
+
+    // true if source has a valid sidecar, only reads the header
+    bool is_fresh(const std::string &source);
+
+    // Write img as the sidecar of source, evicting old sidecars to make room
+    bool store(const std::string &source, const DecodedImage &img);
+
+    // Same for a packed frame that is decoded while it is written, img.pixeldata is not used:
+    // read_rows fills rows with up to max_rows more rows of img and returns how many, or -1 on error.
+    bool store(const std::string &source, const DecodedImage &img, const std::function<int(unsigned char *rows, int max_rows)> &read_rows);
+
+    SidecarStats get_stats();
+
+    const SidecarConfig cfg;
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t source_size;
+        int64_t source_mtime_ns;
+        uint32_t pixel_format;  // of packed frames
+        uint32_t pixel_type;    // GL_UNSIGNED_BYTE, or GL_UNSIGNED_SHORT_5_6_5 for RGB565 frames
+        int32_t target_w, target_h;
+        int32_t width, height;
+        int32_t num_planes;
+        int32_t plane_w[3], plane_h[3];
+        uint32_t top_down;
+        uint64_t payload_size;
+    };
+
+    struct Entry {
+        size_t bytes;
+        int64_t last_used_ns;   // atime of the file, so the order survives restarts
+    };
+
+    std::string sidecar_path(const std::string &source);
+    bool make_header(const std::string &source, Header &header);
+    bool header_matches(const Header &expected, const Header &found, size_t file_size);
+    void remove(std::string name);
+    bool evict_for(size_t bytes);
+    bool write_sidecar(const std::string &source, const DecodedImage &img, const std::function<bool(int fd, size_t payload_size)> &write_payload);
+
+private:
+    const int width, height;
+    bool ready = false;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries; // by sidecar file name
+    size_t bytes_used = 0;
+
+    SidecarStats stats;
+};
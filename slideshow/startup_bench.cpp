@@ -0,0 +1,117 @@
+// Startup time with and without the catalog: fills a temporary folder with copies of one jpg, then starts the loader
+// on it like the slideshow does and reports the time of the ImageLoader constructor, the time until the whole file
+// list is known, and where the first image came from.
+// In between, the state file is created and an image breaks in place and is quarantined, both inside the folder like
+// by default: the catalog has to stay valid across those writes, or the next start scans the folder again.
+// A small jpg keeps the folder small, the images are only listed and one of them decoded per start.
+//
+//   startup_bench <jpg> [images]
+//
+// Opens the same window, the display size is the decode target.
+
+#include "SDL_GL_window.h"
+#include "load_image.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+
+#define DEFAULT_IMAGES 20000
+
+
+static float ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One start like the slideshow's, false if no image loaded. Empty catalog, quarantine or state: disabled.
+// The loader is kept in loader_out to go on with it.
+static bool start(const char *what, SDL_GL_window &window, const std::string &folder, const std::string &catalog,
+                  const std::string &quarantine, const std::string &state, std::unique_ptr<ImageLoader> &loader_out) {
+    ImageCacheConfig cache_config = { 0, 0, 0 };
+    SidecarConfig sidecar_config = { "", 0 };
+    loader_out = nullptr; // the previous one writes nothing after this
+    const auto begin = std::chrono::steady_clock::now();
+    auto loader = std::make_unique<ImageLoader>(folder, window.get_display_width(), window.get_display_height(), cache_config, sidecar_config, 0, quarantine, catalog, state);
+    if (!loader->init_is_successful()) return false;
+    const float constructor_ms = ms_since(begin);
+    while (loader->listing_in_background()) {
+        if (!loader->update()) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printf("%-32s constructor %6.1f ms, file list after %6.1f ms, first image from %s\n", what, constructor_ms, ms_since(begin), loader->get_first_image_source());
+    loader_out = std::move(loader);
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <jpg> [images]\n", argv[0]);
+        return 1;
+    }
+    const int images = argc > 2 ? atoi(argv[2]) : DEFAULT_IMAGES;
+    if (images < 2) return 1;
+
+    namespace fs = std::filesystem;
+    char folder_template[] = "/tmp/startup_bench.XXXXXX";
+    if (!mkdtemp(folder_template)) return 1;
+    const std::string folder = folder_template;
+    std::error_code ec;
+    for (int i = 0; i < images && !ec; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/img%05d.jpg", i);
+        fs::copy_file(argv[1], folder + name, ec);
+    }
+    if (ec) {
+        printf("cannot fill %s: %s\n", folder.c_str(), ec.message().c_str());
+        fs::remove_all(folder, ec);
+        return 1;
+    }
+
+    SDL_GL_window window;
+    const std::string catalog = folder + "/.catalog", quarantine = folder + "/.quarantine", state = folder + "/.last_shown";
+    printf("%d images in %s, display %dx%d\n", images, folder.c_str(), window.get_display_width(), window.get_display_height());
+
+    std::unique_ptr<ImageLoader> loader;
+    bool ok = start("no catalog, no state file", window, folder, "", "", "", loader);
+    ok = ok && start("catalog written", window, folder, catalog, quarantine, state, loader);
+
+    // next image, which creates the state file. The image after it breaks, it is quarantined on the way to the next one.
+    for (int step = 0; step < 2 && ok; step++) {
+        if (step == 1) {
+            std::string shown;
+            std::getline(std::ifstream(state), shown);
+            int shown_idx = 0;
+            sscanf(fs::path(shown).filename().c_str(), "img%d", &shown_idx);
+            char name[32];
+            snprintf(name, sizeof(name), "/img%05d.jpg", (shown_idx + 1) % images);
+            std::ofstream(folder + name, std::ios::binary | std::ios::trunc) << "not a jpg";
+        }
+        loader->load_next_image(LoadPriority::USER);
+        while (ok && !loader->new_image_has_been_loaded()) {
+            ok = loader->update();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (ok) loader->switch_active_texture();
+    }
+    loader = nullptr;
+    ok = ok && fs::exists(quarantine) && fs::exists(state);
+    std::vector<std::string> listed;
+    if (ok) printf("state file created, one image quarantined: the catalog is %s\n", Catalog(catalog, folder).list(listed) ? "up to date" : "out of date");
+
+    ok = ok && start("catalog, no state file", window, folder, catalog, quarantine, "", loader);
+    ok = ok && start("catalog and state file", window, folder, catalog, quarantine, state, loader);
+    loader = nullptr;
+
+    fs::remove_all(folder, ec);
+    if (!ok) printf("loading failed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+// 192x128 4:2:0 baseline jpg, quality 85: color gradients with a sine pattern on top.
+// Decoded by every backend at startup to check that it works and to time it, see DecoderRegistry::select().
+static const unsigned char TEST_JPEG[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01, 0x01, 0x00, 0x00, 0x01,
+    0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x05, 0x03, 0x04, 0x04, 0x04, 0x03, 0x05,
+    0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x06, 0x07, 0x0c, 0x08, 0x07, 0x07, 0x07, 0x07, 0x0f, 0x0b,
+    0x0b, 0x09, 0x0c, 0x11, 0x0f, 0x12, 0x12, 0x11, 0x0f, 0x11, 0x11, 0x13, 0x16, 0x1c, 0x17, 0x13,
+    0x14, 0x1a, 0x15, 0x11, 0x11, 0x18, 0x21, 0x18, 0x1a, 0x1d, 0x1d, 0x1f, 0x1f, 0x1f, 0x13, 0x17,
+    0x22, 0x24, 0x22, 0x1e, 0x24, 0x1c, 0x1e, 0x1f, 0x1e, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x05, 0x05,
+    0x05, 0x07, 0x06, 0x07, 0x0e, 0x08, 0x08, 0x0e, 0x1e, 0x14, 0x11, 0x14, 0x1e, 0x1e, 0x1e, 0x1e,
+    0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e,
+    0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e,
+    0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0xff, 0xc0,
+    0x00, 0x11, 0x08, 0x00, 0x80, 0x00, 0xc0, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11,
+    0x01, 0xff, 0xc4, 0x00, 0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+    0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05,
+    0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21,
+    0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23,
+    0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17,
+    0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7,
+    0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5,
+    0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xc4, 0x00, 0x1f, 0x01, 0x00, 0x03,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
+    0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00,
+    0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13,
+    0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
+    0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27,
+    0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
+    0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6,
+    0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
+    0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+    0xfa, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xf9,
+    0x66, 0xd6, 0x3c, 0x55, 0xc0, 0x9c, 0x53, 0x62, 0x4d, 0xbd, 0xaa, 0x75, 0xaf, 0xdf, 0x70, 0x99,
+    0xc4, 0x28, 0xd1, 0xe4, 0x6c, 0xf1, 0xe1, 0x3b, 0xb2, 0xa4, 0xd1, 0x66, 0xaa, 0x3c, 0x07, 0x3d,
+    0x2b, 0x5c, 0xc7, 0xbb, 0xb5, 0x02, 0xd7, 0x3d, 0xab, 0xe2, 0xb3, 0xc8, 0x3c, 0x6c, 0xaf, 0x13,
+    0xd9, 0xc3, 0x57, 0xe5, 0x33, 0x6d, 0xe0, 0x20, 0xf4, 0xad, 0x5b, 0x48, 0xb1, 0x8a, 0x74, 0x76,
+    0xd8, 0xed, 0x56, 0xe2, 0x8f, 0x6d, 0x67, 0x93, 0x41, 0xe0, 0xa5, 0x79, 0x1e, 0x8f, 0xb7, 0xe6,
+    0x24, 0x8d, 0x38, 0xa6, 0x4b, 0x1e, 0x45, 0x58, 0x4a, 0x76, 0xcd, 0xd5, 0xf5, 0x18, 0xfc, 0xe2,
+    0x15, 0xa8, 0xf2, 0x26, 0x74, 0xd0, 0x9d, 0x99, 0x93, 0x2c, 0x24, 0x9a, 0x22, 0x80, 0xe7, 0xa5,
+    0x6b, 0x7d, 0x9b, 0x3d, 0xa9, 0xe9, 0x6b, 0x8e, 0xd5, 0xf9, 0xa6, 0x27, 0x2f, 0x9d, 0x4a, 0xdc,
+    0xe8, 0xf7, 0x28, 0xe2, 0x52, 0x44, 0x36, 0x71, 0x63, 0x15, 0xa9, 0x0a, 0x71, 0x51, 0xc5, 0x0e,
+    0xde, 0xd5, 0x6a, 0x31, 0x8a, 0xfb, 0x2c, 0xa7, 0x30, 0x8e, 0x12, 0x1c, 0xb2, 0x3a, 0x15, 0x4e,
+    0x66, 0x47, 0x24, 0x79, 0x15, 0x4e, 0x68, 0x72, 0x6b, 0x53, 0x6e, 0x69, 0x3c, 0x8d, 0xdd, 0xab,
+    0xcc, 0xcf, 0xb1, 0x2b, 0x1a, 0x9a, 0x89, 0xea, 0x61, 0xaa, 0xf2, 0x99, 0x09, 0x01, 0xcf, 0x4a,
+    0xd0, 0xb4, 0x87, 0x18, 0xe2, 0xac, 0xa5, 0xaf, 0xb5, 0x59, 0x8a, 0x0d, 0xbd, 0xab, 0xe5, 0x72,
+    0xfc, 0x1c, 0xb0, 0xf5, 0x79, 0x99, 0xeb, 0x47, 0x12, 0x9a, 0x1f, 0x6f, 0x1e, 0x05, 0x4e, 0xc9,
+    0xc5, 0x11, 0x8c, 0x54, 0xc0, 0x66, 0xbe, 0xf5, 0x67, 0x50, 0x54, 0x79, 0x2e, 0x6f, 0x4e, 0x7a,
+    0xdc, 0xcf, 0x9e, 0x1c, 0xd5, 0x7f, 0x20, 0xe7, 0xa5, 0x6c, 0x18, 0x77, 0x76, 0xa5, 0x5b, 0x5f,
+    0x6a, 0xfc, 0xef, 0x37, 0xc3, 0x4b, 0x15, 0x53, 0x9a, 0x27, 0xb7, 0x87, 0xc4, 0x72, 0xa2, 0x8d,
+    0xac, 0x24, 0x11, 0xc5, 0x6b, 0xda, 0xc7, 0xc0, 0xa6, 0xc5, 0x6f, 0x8e, 0xd5, 0x6e, 0x25, 0xc5,
+    0x7a, 0x79, 0x25, 0x5f, 0xa8, 0xfc, 0x47, 0x6f, 0xb6, 0xe6, 0x1c, 0x13, 0x8a, 0xaf, 0x3c, 0x59,
+    0xab, 0xab, 0xd2, 0x94, 0xc5, 0xba, 0xbd, 0x4c, 0xdb, 0x33, 0x8e, 0x2a, 0x9f, 0x2a, 0x67, 0x6e,
+    0x1e, 0xa7, 0x2b, 0x3c, 0x51, 0x93, 0x06, 0x84, 0x1c, 0xd5, 0xb9, 0xa2, 0xe7, 0xa5, 0x32, 0x38,
+    0x8e, 0x6b, 0xca, 0xcc, 0x73, 0x39, 0xd3, 0xaf, 0xca, 0x99, 0xfc, 0x73, 0x42, 0xa2, 0x68, 0x92,
+    0x08, 0xf7, 0x55, 0xf8, 0xad, 0xb2, 0x3a, 0x52, 0x59, 0xc5, 0xd3, 0x8a, 0xd6, 0xb7, 0x87, 0x8e,
+    0x95, 0xf6, 0xd9, 0x02, 0x58, 0x98, 0x27, 0x23, 0x77, 0x5f, 0x94, 0xcf, 0x36, 0xd8, 0x1d, 0x2a,
+    0x27, 0x8f, 0x6d, 0x6d, 0x3c, 0x3c, 0x74, 0xaa, 0x73, 0xc5, 0x58, 0x71, 0x1a, 0x58, 0x68, 0x37,
+    0x13, 0xd2, 0xc2, 0xd7, 0xb9, 0x41, 0x47, 0x35, 0x66, 0x04, 0xcd, 0x34, 0x44, 0x73, 0xd2, 0xaf,
+    0x5a, 0x45, 0xcf, 0x4a, 0xf8, 0x0c, 0x06, 0x67, 0x3a, 0x95, 0xf9, 0x5b, 0x3d, 0xa8, 0xd4, 0x49,
+    0x12, 0x43, 0x6f, 0x9e, 0xd5, 0x38, 0xb5, 0xe3, 0xa5, 0x5c, 0xb5, 0x87, 0x81, 0xc5, 0x5b, 0x30,
+    0xf1, 0xd2, 0xbf, 0x50, 0xc3, 0xe1, 0x69, 0xce, 0x87, 0x33, 0x2e, 0x18, 0x96, 0x99, 0x8a, 0xf0,
+    0xed, 0xed, 0x4c, 0xc6, 0x0d, 0x69, 0xcf, 0x17, 0xb5, 0x54, 0x31, 0x73, 0x5f, 0x9a, 0x71, 0x06,
+    0x36, 0x58, 0x7a, 0x8d, 0x44, 0xf7, 0x30, 0xb5, 0x6e, 0x84, 0x85, 0x73, 0x57, 0xe0, 0x83, 0x3d,
+    0xaa, 0x2b, 0x68, 0xb9, 0xe9, 0x5a, 0xf6, 0x90, 0xf0, 0x38, 0xae, 0xae, 0x1e, 0xc4, 0x3c, 0x54,
+    0x97, 0x39, 0xde, 0xeb, 0x58, 0xae, 0xb6, 0xbc, 0x74, 0xa4, 0x78, 0x36, 0xf6, 0xad, 0x85, 0x84,
+    0x63, 0xa5, 0x43, 0x3c, 0x3c, 0x74, 0xaf, 0xa8, 0xcd, 0xe8, 0x42, 0x8d, 0x1e, 0x68, 0x9d, 0x38,
+    0x7c, 0x45, 0xd9, 0x92, 0x57, 0x06, 0x9f, 0x10, 0xc9, 0xa9, 0xa4, 0x8b, 0x9a, 0x7c, 0x11, 0x73,
+    0xd2, 0xbf, 0x26, 0xab, 0x9a, 0x54, 0x58, 0x8e, 0x5b, 0x9e, 0xfd, 0x2a, 0x8a, 0xc4, 0xd6, 0xf0,
+    0xe7, 0xb5, 0x5c, 0x8e, 0xd7, 0x8e, 0x95, 0x25, 0x9c, 0x3d, 0x2b, 0x4e, 0x28, 0x46, 0xde, 0x95,
+    0xfa, 0x3e, 0x4d, 0x4a, 0x15, 0xe9, 0x5e, 0x46, 0x8b, 0x11, 0x66, 0x65, 0x35, 0xbe, 0x3b, 0x54,
+    0x4c, 0x98, 0xad, 0x89, 0xa1, 0xe3, 0xa5, 0x52, 0x9a, 0x2e, 0x7a, 0x57, 0xcd, 0xf1, 0x2d, 0x5f,
+    0xaa, 0xdf, 0x90, 0xf5, 0xb0, 0x95, 0xb9, 0xb7, 0x2a, 0xc6, 0x39, 0xab, 0xb6, 0xf1, 0x6e, 0xed,
+    0x51, 0x47, 0x11, 0xcd, 0x69, 0xd9, 0xc5, 0xd2, 0xbe, 0x67, 0x27, 0xc7, 0xce, 0xbd, 0x5e, 0x59,
+    0x1e, 0xb2, 0xab, 0x64, 0x78, 0xac, 0x90, 0x64, 0xf4, 0xa4, 0x8e, 0xdb, 0x9e, 0x95, 0xae, 0x96,
+    0xfb, 0xbb, 0x54, 0xab, 0x69, 0xed, 0x5f, 0x79, 0x88, 0xca, 0xdd, 0x79, 0xfb, 0x43, 0xf8, 0xb6,
+    0x8e, 0x2a, 0xda, 0x14, 0xad, 0xa1, 0xc6, 0x38, 0xad, 0x18, 0x57, 0x02, 0x95, 0x60, 0xdb, 0xda,
+    0xa4, 0x51, 0x8a, 0xf5, 0x30, 0x78, 0xf5, 0x97, 0xab, 0x33, 0xb6, 0x15, 0x39, 0xc1, 0x97, 0x22,
+    0xa0, 0x92, 0x1c, 0xf6, 0xab, 0x88, 0x33, 0x53, 0x24, 0x1b, 0xbb, 0x56, 0x19, 0x86, 0x39, 0x66,
+    0x0a, 0xc8, 0xf4, 0x68, 0x55, 0xe4, 0x32, 0x45, 0xb7, 0x3d, 0x2a, 0xdd, 0xbc, 0x18, 0x3d, 0x2b,
+    0x45, 0x2d, 0x3d, 0xaa, 0x45, 0xb7, 0xdb, 0xda, 0xbc, 0x1a, 0x59, 0x63, 0xc3, 0xcf, 0x9d, 0x9e,
+    0xad, 0x3c, 0x55, 0xd5, 0x86, 0xdb, 0xa6, 0x05, 0x58, 0xdb, 0xc5, 0x35, 0x57, 0x15, 0x2a, 0xf3,
+    0x5e, 0xfc, 0x33, 0xf8, 0xd2, 0x87, 0xb3, 0xb9, 0xd7, 0x4e, 0x57, 0x77, 0x2b, 0xcb, 0x16, 0x7b,
+    0x54, 0x1f, 0x66, 0x39, 0xe9, 0x5a, 0xa9, 0x16, 0xee, 0xd5, 0x32, 0x5a, 0xe7, 0xb5, 0x7c, 0xe6,
+    0x3b, 0x0a, 0xf1, 0xf2, 0xe6, 0x47, 0xad, 0x43, 0x11, 0xca, 0x66, 0x41, 0x6f, 0x83, 0xd2, 0xb4,
+    0xad, 0xa3, 0xc5, 0x4c, 0xb6, 0xd8, 0xed, 0x52, 0x2a, 0x6d, 0xa7, 0x82, 0xff, 0x00, 0x84, 0xe7,
+    0x76, 0x77, 0xc2, 0xbf, 0x38, 0xe5, 0x5e, 0x29, 0x92, 0x47, 0x9a, 0x95, 0x2a, 0x64, 0x8f, 0x75,
+    0x77, 0x62, 0xf3, 0xa5, 0x8a, 0x87, 0x22, 0x67, 0x75, 0x19, 0xf2, 0xea, 0x66, 0x35, 0xbe, 0x4f,
+    0x4a, 0x92, 0x1b, 0x7c, 0x1e, 0x95, 0xaa, 0x96, 0xd9, 0xed, 0x53, 0x2d, 0xae, 0x3b, 0x57, 0xcb,
+    0x4f, 0x29, 0x94, 0xa7, 0xed, 0x2c, 0x7a, 0xf4, 0xb1, 0x7d, 0x0a, 0xb6, 0xd1, 0x63, 0x1c, 0x55,
+    0xf8, 0xd7, 0x8a, 0x45, 0x8b, 0x6f, 0x6a, 0x91, 0x6b, 0xdb, 0xc2, 0xe6, 0xeb, 0x05, 0x1e, 0x46,
+    0xce, 0xc8, 0x4f, 0x98, 0x6b, 0xa6, 0x45, 0x56, 0x7b, 0x7c, 0x9e, 0x95, 0xa0, 0x8b, 0xba, 0xa7,
+    0x4b, 0x7d, 0xdd, 0xab, 0xcc, 0xcc, 0x6a, 0xff, 0x00, 0x68, 0xec, 0x7a, 0x74, 0x2b, 0x72, 0x19,
+    0x11, 0xdb, 0x1c, 0xf4, 0xab, 0xf6, 0xd0, 0xe3, 0x1c, 0x55, 0xd5, 0xb5, 0xf6, 0xa9, 0x16, 0x1d,
+    0xbd, 0xab, 0xcc, 0xc3, 0x60, 0x5e, 0x0a, 0x5c, 0xec, 0xf4, 0xe1, 0x89, 0xe6, 0x3c, 0x82, 0xda,
+    0x0c, 0xf6, 0xab, 0x82, 0xdf, 0x8e, 0x95, 0x25, 0xa4, 0x5c, 0x0e, 0x2a, 0xe8, 0x8c, 0x63, 0xa5,
+    0x7e, 0xd9, 0x97, 0xfb, 0x37, 0x87, 0xbb, 0x3f, 0x89, 0x23, 0x5d, 0xdc, 0xc8, 0x96, 0x1c, 0x76,
+    0xaa, 0xcc, 0x98, 0x35, 0xb3, 0x3c, 0x5e, 0xd5, 0x4d, 0xe0, 0xe7, 0xa5, 0x7e, 0x69, 0xc5, 0x15,
+    0xe5, 0x09, 0xbe, 0x43, 0xdd, 0xc2, 0x56, 0x2b, 0xc0, 0x99, 0x35, 0xa9, 0x6b, 0x0e, 0x71, 0xc5,
+    0x41, 0x6f, 0x0f, 0x3d, 0x2b, 0x5e, 0xce, 0x2c, 0x63, 0x8a, 0xcf, 0x86, 0xab, 0xca, 0x73, 0x5c,
+    0xe7, 0xa0, 0xeb, 0x59, 0x09, 0x1d, 0xb8, 0xc7, 0x4a, 0x6c, 0xb0, 0x60, 0x74, 0xad, 0x48, 0xe3,
+    0xf9, 0x69, 0x93, 0x45, 0xc7, 0x4a, 0xfb, 0xdc, 0xd3, 0xd9, 0xc7, 0x0f, 0x74, 0x6f, 0x87, 0xae,
+    0xee, 0x62, 0x48, 0x98, 0x34, 0xb1, 0x2f, 0x35, 0x76, 0x58, 0x79, 0xe9, 0x44, 0x50, 0x1c, 0xf4,
+    0xaf, 0xc5, 0xb1, 0xb8, 0xaa, 0x8b, 0x13, 0x64, 0x7d, 0x0d, 0x0a, 0xaa, 0xc4, 0xb6, 0xb1, 0x67,
+    0x1c, 0x56, 0x94, 0x56, 0xf9, 0x1d, 0x2a, 0x3b, 0x38, 0x71, 0x8e, 0x2b, 0x56, 0x18, 0xf8, 0xaf,
+    0xd2, 0xb8, 0x7a, 0x51, 0x9d, 0x25, 0xce, 0x68, 0xeb, 0xea, 0x50, 0x7b, 0x7c, 0x0e, 0x95, 0x56,
+    0x58, 0xf0, 0x6b, 0x6e, 0x48, 0xf8, 0xe9, 0x54, 0xa6, 0x87, 0x9e, 0x95, 0xe3, 0x71, 0x55, 0x45,
+    0x08, 0xbe, 0x43, 0xd4, 0xc2, 0x56, 0xbe, 0xe6, 0x72, 0x2f, 0x35, 0x7a, 0xd6, 0x3c, 0xf6, 0xa6,
+    0xa4, 0x1c, 0xf4, 0xad, 0x0b, 0x48, 0x7a, 0x71, 0x5f, 0x0b, 0x94, 0x62, 0x6a, 0x4a, 0xbd, 0xa4,
+    0x7b, 0x2a, 0xb2, 0xb1, 0x34, 0x16, 0xf9, 0x1d, 0x2a, 0x66, 0xb7, 0xe3, 0xa5, 0x5b, 0xb7, 0x8c,
+    0x63, 0xa5, 0x4e, 0xd1, 0xfc, 0xb5, 0xfa, 0xdc, 0x7d, 0x97, 0xd5, 0xae, 0x3a, 0x75, 0xdd, 0xcc,
+    0x59, 0x62, 0xc5, 0x42, 0x14, 0xe6, 0xb5, 0x67, 0x8b, 0xda, 0xab, 0x79, 0x07, 0x3d, 0x2b, 0xf2,
+    0x0e, 0x20, 0xc4, 0x4e, 0x15, 0x9f, 0x29, 0xf4, 0x18, 0x5a, 0xda, 0x0d, 0xb6, 0x8f, 0x24, 0x56,
+    0xad, 0xb4, 0x19, 0x1d, 0x2a, 0x0b, 0x58, 0x79, 0x15, 0xaf, 0x6b, 0x10, 0xc0, 0xaf, 0x77, 0x86,
+    0x2a, 0xf3, 0xdb, 0x9c, 0xeb, 0x95, 0x62, 0x11, 0x6f, 0xc7, 0x4a, 0x86, 0x68, 0x71, 0xda, 0xb6,
+    0x04, 0x7c, 0x55, 0x79, 0xe2, 0xcf, 0x6a, 0xfa, 0x0e, 0x20, 0x70, 0x8d, 0x16, 0xe2, 0x75, 0xe1,
+    0x6b, 0xea, 0x78, 0xd4, 0x29, 0xb6, 0xac, 0x28, 0xe2, 0x86, 0x4c, 0x1a, 0x54, 0x1c, 0xd7, 0x4c,
+    0xb3, 0xff, 0x00, 0xab, 0xfe, 0xee, 0xe7, 0xf1, 0xad, 0x29, 0x5f, 0x51, 0x1a, 0x3d, 0xdd, 0xa9,
+    0xbf, 0x66, 0xc9, 0xe9, 0x57, 0xa1, 0x8f, 0x75, 0x5d, 0x8a, 0xdb, 0x23, 0xa5, 0x64, 0xe8, 0xff,
+    0x00, 0x68, 0xfb, 0xc7, 0xa3, 0x4b, 0x11, 0xc8, 0x64, 0xc5, 0x6d, 0x8e, 0xd5, 0x72, 0x18, 0xf6,
+    0xf6, 0xab, 0xff, 0x00, 0x66, 0xc0, 0xe9, 0x4c, 0x68, 0xf6, 0xd6, 0x32, 0xa5, 0xfd, 0x9d, 0xef,
+    0x1e, 0x8d, 0x2c, 0x47, 0x38, 0x88, 0x38, 0xa5, 0x29, 0x9a, 0x14, 0x73, 0x56, 0x21, 0x4c, 0xd6,
+    0x0f, 0x3f, 0xfa, 0xc7, 0xee, 0xee, 0x7a, 0x34, 0xa5, 0x6d, 0x4a, 0xa6, 0xdf, 0x3d, 0xa9, 0xd1,
+    0xda, 0xe0, 0xf4, 0xad, 0x68, 0x6d, 0xb3, 0xda, 0xa7, 0x16, 0xb8, 0x1d, 0x2b, 0x37, 0x94, 0x7b,
+    0x5f, 0xde, 0x58, 0xf4, 0x69, 0x62, 0xed, 0xa1, 0x9d, 0x0c, 0x3b, 0x7b, 0x55, 0xc8, 0xc6, 0x05,
+    0x3d, 0xa1, 0xdb, 0xda, 0x90, 0x0c, 0x1a, 0xc2, 0x59, 0xa7, 0xf6, 0x7f, 0xbb, 0x73, 0xd1, 0xa5,
+    0x53, 0x98, 0x5d, 0xb9, 0xa6, 0x98, 0x33, 0xda, 0xa7, 0x89, 0x73, 0x57, 0xa1, 0x83, 0x77, 0x6a,
+    0xc9, 0xe2, 0xbf, 0xb4, 0xb4, 0x3d, 0x1a, 0x55, 0x79, 0x0c, 0xb4, 0xb5, 0xe7, 0xa5, 0x59, 0x86,
+    0x0d, 0xbd, 0xab, 0x51, 0x6d, 0x78, 0xe9, 0x43, 0x41, 0xb7, 0xb5, 0x63, 0x2c, 0xb7, 0xea, 0x9e,
+    0xf9, 0xe8, 0xd2, 0xc5, 0x73, 0x68, 0x41, 0x12, 0xe2, 0xa6, 0xc6, 0x45, 0x37, 0x6e, 0x0d, 0x49,
+    0x18, 0xcd, 0x63, 0x2e, 0x22, 0xe5, 0xfd, 0xdd, 0xcf, 0x46, 0x94, 0xba, 0x91, 0x98, 0x77, 0x76,
+    0xa4, 0x16, 0xb9, 0x3d, 0x2b, 0x4a, 0x08, 0x77, 0x76, 0xab, 0x71, 0xda, 0xf1, 0xd2, 0xb2, 0x78,
+    0x0f, 0xaf, 0x7b, 0xe7, 0xa3, 0x4b, 0x13, 0xca, 0x65, 0x43, 0x6f, 0x8e, 0xd5, 0x76, 0x14, 0xc5,
+    0x5a, 0x36, 0xf8, 0xed, 0x4c, 0x29, 0x8a, 0xc6, 0x55, 0x7f, 0xb3, 0x4f, 0x46, 0x95, 0x6e, 0x71,
+    0x54, 0x71, 0x48, 0xd1, 0x6e, 0xa7, 0x20, 0xe6, 0xad, 0xc1, 0x16, 0xea, 0xc1, 0xe7, 0x3f, 0x5e,
+    0xf7, 0x2e, 0x7a, 0x34, 0xa7, 0xca, 0x78, 0x94, 0xd1, 0x73, 0x4c, 0x8e, 0x33, 0x9e, 0x95, 0xa9,
+    0x2c, 0x19, 0x3d, 0x29, 0xb1, 0xdb, 0x73, 0xd2, 0x96, 0x67, 0xed, 0x25, 0x88, 0xba, 0x3f, 0x8d,
+    0xb0, 0xf5, 0xd5, 0x82, 0xce, 0x2c, 0xe3, 0x8a, 0xd6, 0xb7, 0x87, 0x8e, 0x95, 0x0d, 0xac, 0x38,
+    0xc7, 0x15, 0xa7, 0x02, 0x60, 0x0a, 0xfb, 0xee, 0x1b, 0xaf, 0x18, 0x41, 0x73, 0x9b, 0x3a, 0xd7,
+    0x7a, 0x15, 0xde, 0x1e, 0x2a, 0x9c, 0xf1, 0x60, 0xf4, 0xad, 0x96, 0x4c, 0x8a, 0xad, 0x2c, 0x39,
+    0xed, 0x58, 0xf1, 0x45, 0x78, 0xce, 0x0f, 0x90, 0xf4, 0x70, 0x95, 0xac, 0xcc, 0x81, 0x19, 0xcd,
+    0x5d, 0xb4, 0x8a, 0xa5, 0x16, 0xc7, 0x3d, 0x2a, 0xe5, 0xb4, 0x18, 0xc7, 0x15, 0xf9, 0xb6, 0x5d,
+    0xed, 0x23, 0x88, 0xbb, 0x3d, 0xc8, 0xd7, 0x56, 0x26, 0xb5, 0x87, 0x81, 0xc5, 0x5a, 0x30, 0x0c,
+    0x74, 0xa9, 0x2d, 0xd3, 0x02, 0xac, 0xed, 0xe2, 0xbf, 0x5e, 0xc3, 0x62, 0xa9, 0xac, 0x35, 0x98,
+    0xe1, 0x55, 0xdc, 0xc9, 0x9e, 0x2c, 0x55, 0x43, 0x19, 0xcf, 0x4a, 0xda, 0x9a, 0x2c, 0xf6, 0xaa,
+    0xe6, 0xdf, 0x9e, 0x95, 0xf9, 0x4f, 0x12, 0x4a, 0x53, 0xaa, 0xf9, 0x0f, 0x7b, 0x0b, 0x5f, 0x42,
+    0xb5, 0xb4, 0x5c, 0xd6, 0xbd, 0xa4, 0x3c, 0x0e, 0x2a, 0x1b, 0x7b, 0x7c, 0x1e, 0x95, 0xa9, 0x6b,
+    0x1e, 0x2b, 0xb7, 0x86, 0x2a, 0x3a, 0x72, 0x5c, 0xe7, 0x74, 0xab, 0x5c, 0x55, 0x80, 0x63, 0xa5,
+    0x43, 0x3c, 0x3c, 0x74, 0xad, 0x25, 0x51, 0x8a, 0x8e, 0x58, 0xb3, 0x5f, 0x5f, 0x9d, 0x62, 0x69,
+    0xca, 0x85, 0xa2, 0x74, 0x61, 0xaa, 0xbb, 0x98, 0x92, 0x46, 0x73, 0x52, 0x41, 0x19, 0xcf, 0x4a,
+    0xba, 0xf6, 0xf9, 0x3d, 0x2a, 0x48, 0x6d, 0xf9, 0xe9, 0x5f, 0x8c, 0xd6, 0x55, 0x3e, 0xb3, 0x73,
+    0xe8, 0x68, 0xd7, 0x56, 0x24, 0xb3, 0x87, 0xa7, 0x15, 0xa7, 0x14, 0x03, 0x1d, 0x2a, 0x3b, 0x58,
+    0xb1, 0x8e, 0x2b, 0x42, 0x35, 0xe2, 0xbf, 0x53, 0xc8, 0xb1, 0x30, 0x85, 0x1b, 0x48, 0xbf, 0x6d,
+    0xa9, 0x46, 0x58, 0x78, 0xe9, 0x54, 0xa5, 0x8b, 0x9e, 0x95, 0xb7, 0x22, 0x64, 0x55, 0x59, 0x20,
+    0xc9, 0xe9, 0x5f, 0x2d, 0xc5, 0x55, 0x7d, 0xa5, 0xf9, 0x0f, 0x5b, 0x07, 0x5a, 0xc6, 0x64, 0x71,
+    0x9d, 0xdd, 0x2b, 0x4e, 0xce, 0x2e, 0x9c, 0x52, 0x47, 0x6d, 0xcf, 0x4a, 0xd0, 0xb5, 0x87, 0x18,
+    0xe2, 0xbe, 0x57, 0x23, 0x73, 0x85, 0x6b, 0xc8, 0xf5, 0xfd, 0xbe, 0x87, 0x8d, 0xad, 0xbe, 0xee,
+    0xd5, 0x2a, 0x5a, 0xfb, 0x56, 0x8d, 0xb4, 0x19, 0xed, 0x56, 0xc5, 0xb7, 0x1d, 0x2b, 0xf6, 0x5a,
+    0x59, 0x62, 0xaf, 0x0f, 0x68, 0x7f, 0x13, 0x53, 0xc5, 0x59, 0xd8, 0xc8, 0x48, 0x36, 0xf6, 0xa9,
+    0x90, 0x62, 0xae, 0x4b, 0x0e, 0x3b, 0x55, 0x76, 0x5c, 0x1a, 0xf9, 0xfc, 0xc3, 0x1e, 0xf2, 0xf7,
+    0xca, 0x8f, 0x56, 0x85, 0x5e, 0x71, 0xca, 0x33, 0x52, 0x2c, 0x1b, 0xbb, 0x51, 0x02, 0xe4, 0xd6,
+    0x95, 0xb4, 0x39, 0xc7, 0x15, 0x8e, 0x0b, 0x1c, 0xf3, 0x07, 0x66, 0x7a, 0x30, 0xa9, 0xc8, 0x51,
+    0x5b, 0x4f, 0x6a, 0x99, 0x2d, 0xf6, 0xf6, 0xad, 0x64, 0xb6, 0xe3, 0xa5, 0x24, 0x90, 0x60, 0x74,
+    0xaf, 0x53, 0x13, 0x96, 0x2c, 0x3c, 0x3d, 0xa2, 0x3b, 0x68, 0xe2, 0xaf, 0xa1, 0x41, 0x17, 0x6d,
+    0x4a, 0xbc, 0xd2, 0xba, 0x60, 0xd3, 0xa2, 0x52, 0x4d, 0x7c, 0x9d, 0x6c, 0xfe, 0x54, 0xa7, 0xec,
+    0xee, 0x7a, 0xf4, 0x65, 0x75, 0x71, 0x56, 0x2d, 0xd5, 0x2a, 0xda, 0xe7, 0xb5, 0x5a, 0xb5, 0x8b,
+    0x38, 0xe2, 0xb4, 0x62, 0xb6, 0xc8, 0xe9, 0x5e, 0xd6, 0x0f, 0x0c, 0xb1, 0xd1, 0xe6, 0x67, 0x64,
+    0x31, 0x1c, 0xa6, 0x4a, 0x5b, 0x63, 0xb5, 0x4c, 0x89, 0xb6, 0xb4, 0x9e, 0xdf, 0x03, 0xa5, 0x57,
+    0x92, 0x3c, 0x1e, 0x95, 0xc5, 0x98, 0xff, 0x00, 0xc2, 0x72, 0xba, 0x3d, 0x2a, 0x15, 0xf9, 0xc8,
+    0xd2, 0xa4, 0x58, 0xf7, 0x53, 0x11, 0x79, 0xab, 0xd6, 0xd1, 0xe6, 0xbc, 0x5c, 0x3e, 0x74, 0xf1,
+    0x53, 0xe4, 0x6c, 0xf5, 0x61, 0x2e, 0x52, 0x05, 0xb6, 0xcf, 0x6a, 0x95, 0x2d, 0x71, 0xda, 0xb5,
+    0x20, 0xb7, 0xcf, 0x6a, 0x9c, 0xdb, 0xe0, 0x74, 0xaf, 0x7f, 0xfb, 0x26, 0x32, 0x87, 0xb4, 0xb1,
+    0xd7, 0x4b, 0x15, 0xad, 0x8c, 0xa4, 0x8b, 0x6f, 0x6a, 0x99, 0x6a, 0x79, 0x62, 0xc5, 0x44, 0x17,
+    0x9a, 0xf9, 0x7c, 0x6e, 0x6e, 0xf0, 0x52, 0xe4, 0x4c, 0xf5, 0xa8, 0x4f, 0x98, 0x7a, 0xae, 0xea,
+    0x91, 0x6d, 0xf3, 0xda, 0x9f, 0x6e, 0x99, 0x35, 0xa7, 0x6f, 0x06, 0x7b, 0x57, 0x46, 0x06, 0xaf,
+    0xf6, 0x8e, 0xe7, 0x7c, 0x6b, 0x72, 0x19, 0xa9, 0x6b, 0xed, 0x53, 0x24, 0x3b, 0x7b, 0x56, 0xb0,
+    0xb6, 0x18, 0xe9, 0x51, 0x4b, 0x0e, 0x3b, 0x57, 0x46, 0x37, 0x04, 0xb0, 0x51, 0xe7, 0x47, 0x7d,
+    0x0c, 0x4f, 0x31, 0xe4, 0x16, 0x91, 0x70, 0x38, 0xab, 0xa2, 0x2f, 0x97, 0xa5, 0x36, 0x04, 0xc5,
+    0x59, 0x51, 0xc5, 0x7e, 0x93, 0x81, 0xcc, 0xe1, 0x4e, 0x87, 0x2b, 0x67, 0xf1, 0x54, 0x6a, 0x36,
+    0xca, 0x13, 0xc5, 0xed, 0x54, 0xde, 0x13, 0x9e, 0x95, 0xb4, 0xf1, 0xe6, 0xa3, 0xfb, 0x36, 0x4f,
+    0x4a, 0xfc, 0xff, 0x00, 0x88, 0x93, 0xc4, 0xcd, 0xb8, 0x9e, 0xd6, 0x16, 0xbd, 0x8c, 0xeb, 0x78,
+    0x79, 0xe9, 0x5a, 0xf6, 0x71, 0x74, 0xe2, 0x92, 0x2b, 0x6c, 0x1e, 0x95, 0x7a, 0x08, 0xf1, 0xda,
+    0xb3, 0xc8, 0x13, 0xc3, 0x4e, 0xf2, 0x3d, 0x1f, 0x6f, 0xcc, 0x49, 0x1c, 0x43, 0x1d, 0x29, 0x93,
+    0x45, 0xc5, 0x5b, 0x41, 0xc5, 0x0c, 0x99, 0xaf, 0xb3, 0xcc, 0x73, 0x38, 0x55, 0xa1, 0xca, 0x99,
+    0xd1, 0x87, 0xa8, 0xd3, 0x31, 0xa5, 0x87, 0x9e, 0x94, 0xb0, 0xc3, 0xcf, 0x4a, 0xd3, 0x6b, 0x7c,
+    0x9e, 0x94, 0xf8, 0xed, 0x70, 0x7a, 0x57, 0xe4, 0x98, 0xbc, 0x2d, 0x49, 0xd7, 0xe6, 0x47, 0xbf,
+    0x47, 0x12, 0xac, 0x36, 0xce, 0x1e, 0x95, 0xa9, 0x0c, 0x43, 0x1d, 0x2a, 0x28, 0x21, 0xdb, 0xda,
+    0xae, 0xc4, 0x30, 0x2b, 0xef, 0xf2, 0x3c, 0x6c, 0x70, 0xd4, 0xed, 0x23, 0x6f, 0x6b, 0xcc, 0xc8,
+    0x64, 0x88, 0x63, 0xa5, 0x52, 0x9a, 0x1e, 0x7a, 0x56, 0xb9, 0x5c, 0xd4, 0x4d, 0x06, 0x7b, 0x57,
+    0x93, 0xc4, 0x98, 0x85, 0x8a, 0x4f, 0x90, 0xf4, 0xf0, 0x95, 0xb9, 0x4c, 0x84, 0x84, 0xe7, 0xa5,
+    0x68, 0xd9, 0xc3, 0xd2, 0xa6, 0x5b, 0x5e, 0x7a, 0x55, 0xb8, 0x20, 0xdb, 0xda, 0xbe, 0x37, 0x2c,
+    0xc3, 0xce, 0x8d, 0x6e, 0x69, 0x1e, 0xc4, 0x71, 0x17, 0x44, 0xd6, 0xf1, 0x0c, 0x54, 0xcd, 0x17,
+    0xcb, 0xd2, 0x9f, 0x12, 0xe0, 0x54, 0xd8, 0xc8, 0xaf, 0xd3, 0x23, 0x9a, 0xd3, 0x58, 0x7e, 0x5b,
+    0x9a, 0x53, 0x9b, 0xb9, 0x97, 0x3c, 0x5e, 0xd5, 0x5b, 0xc9, 0x39, 0xe9, 0x5b, 0x2f, 0x0e, 0xee,
+    0xd4, 0xd1, 0x6b, 0xcf, 0x4a, 0xfc, 0xb7, 0x3c, 0xa3, 0x3c, 0x45, 0x57, 0x28, 0x9e, 0xee, 0x1b,
+    0x11, 0x64, 0x54, 0xb5, 0x87, 0x91, 0x5b, 0x16, 0xb1, 0x70, 0x2a, 0x28, 0x6d, 0xf1, 0xda, 0xaf,
+    0xc0, 0x98, 0xaf, 0x67, 0x87, 0xaa, 0xfd, 0x56, 0xdc, 0xe7, 0x6b, 0xad, 0xcc, 0x2f, 0x95, 0xc7,
+    0x4a, 0xaf, 0x3c, 0x5e, 0xd5, 0xa0, 0x07, 0x14, 0xd7, 0x8b, 0x77, 0x6a, 0xf6, 0x73, 0xbc, 0x7c,
+    0x2b, 0xd2, 0xe5, 0x89, 0xd9, 0x86, 0xa9, 0x66, 0x7f, 0xff, 0xd9,
+};
+static const int TEST_JPEG_WIDTH = 192, TEST_JPEG_HEIGHT = 128;
@@ -0,0 +1,133 @@
+// Tests that an arrow key does not wait for a background decode (RPI_USE_PREEMPTIBLE_DECODE), what navigation_bench
+// measures. Built with the other tests (RPI_BUILD_TESTS), run with ctest or ./test_navigation. Exits with 1 if the
+// check fails, with 77 (skipped) without a display to open the window on.
+//
+// Writes a few big jpgs to a temporary folder and times loads in the direction the prefetch is not going: once the
+// prefetch is done, which is the time of one decode, and 10ms after the last load, while it is still decoding.
+// With the option the second one interrupts the prefetch and takes about as long, without it it waits for the
+// prefetch to finish first, up to twice as long. Decodes run on one thread, split decodes are not preemptible.
+
+#include "SDL_GL_window.h"
+#include "load_image.h"
+
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <jpeglib.h>
+
+#include <SDL3/SDL.h>
+
+
+#define IMAGES 6
+#define ROUNDS 6
+#define BUSY_DELAY_MS 10
+#define MAX_WAIT_FACTOR 1.3f // a load during a background decode may take this much longer than one without
+
+
+// A 4000x3000 jpg with enough detail that decoding it takes a while
+static bool write_jpeg(const std::string &path, int seed) {
+    const int width = 4000, height = 3000;
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, f);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    std::vector<unsigned char> row(width * 3);
+    uint32_t noise = seed * 2654435761u + 1;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const int y = cinfo.next_scanline;
+        for (int x = 0; x < width; x++) {
+            noise = noise * 1664525 + 1013904223;
+            row[x * 3 + 0] = ((x + seed * 40) & 0xff) ^ (noise >> 28);
+            row[x * 3 + 1] = ((y * 2 + seed * 90) & 0xff) ^ (noise >> 24 & 0xf);
+            row[x * 3 + 2] = ((x ^ y) + seed * 17) & 0xff;
+        }
+        JSAMPROW rows[1] = { row.data() };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return fclose(f) == 0;
+}
+
+// Keypress to loaded, -1 if the loader failed
+static float user_load(ImageLoader &loader, int dir) {
+    const auto start = std::chrono::steady_clock::now();
+    if (dir < 0) loader.load_prev_image(LoadPriority::USER);
+    else loader.load_next_image(LoadPriority::USER);
+    while (!loader.new_image_has_been_loaded()) {
+        if (!loader.update()) return -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    loader.switch_active_texture();
+    return ms;
+}
+
+// Median of the loads that turn around, delay_ms after the last load (0: once the prefetch is done). -1 on failure.
+static float turn_around_ms(ImageLoader &loader, int &dir, int delay_ms) {
+    std::vector<float> turns;
+    float last_ms = 100;
+    for (int i = 0; i < ROUNDS * 2; i++) {
+        // twice the time of a load is plenty for the prefetch of one image to finish
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms ? delay_ms : (int)(2 * last_ms) + 50));
+        const bool turn = i % 2 == 0;
+        if (turn) dir = -dir;
+        last_ms = user_load(loader, dir);
+        if (last_ms < 0) return -1;
+        if (turn) turns.push_back(last_ms);
+    }
+    std::sort(turns.begin(), turns.end());
+    return turns[turns.size() / 2];
+}
+
+
+int main() {
+    if (!SDL_Init(SDL_INIT_VIDEO) || !SDL_GetPrimaryDisplay()) {
+        printf("no display (%s), skipped\n", SDL_GetError());
+        return 77;
+    }
+
+    namespace fs = std::filesystem;
+    char folder_template[] = "/tmp/test_navigation.XXXXXX";
+    if (!mkdtemp(folder_template)) return 1;
+    const std::string folder = folder_template;
+    bool written = true;
+    for (int i = 0; i < IMAGES && written; i++) written = write_jpeg(folder + "/" + std::to_string(i) + ".jpg", i);
+
+    bool passed = false;
+    if (written) {
+        SDL_GL_window window;
+        ImageCacheConfig cache_config = { (size_t)512 * 1024 * 1024, 2, 1 }; // only the next image is prefetched
+        SidecarConfig sidecar_config = { "", 0 };
+        ImageLoader loader(folder, window.get_display_width(), window.get_display_height(), cache_config, sidecar_config, 1, "", "", "");
+        loader.set_upload_budget(0);
+        int dir = 1;
+        if (loader.init_is_successful() && user_load(loader, dir) >= 0) { // sets the direction the prefetch follows
+            const float idle_ms = turn_around_ms(loader, dir, 0);
+            const float busy_ms = turn_around_ms(loader, dir, BUSY_DELAY_MS);
+            passed = idle_ms > 0 && busy_ms > 0 && busy_ms <= idle_ms * MAX_WAIT_FACTOR;
+            printf("turning around: %.1f ms once the prefetch is done, %.1f ms while it decodes (at most %.1f)\n",
+                   idle_ms, busy_ms, idle_ms * MAX_WAIT_FACTOR);
+        }
+    }
+
+    std::error_code ec;
+    fs::remove_all(folder, ec);
+    printf(passed ? "passed\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
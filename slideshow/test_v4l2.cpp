@@ -0,0 +1,217 @@
+// Tests V4L2Decoder against MockV4L2Device (v4l2_mock_device.h), no codec needed.
+// Built with the other tests (RPI_BUILD_TESTS), run with ctest or ./test_v4l2. Exits with 1 if any check fails.
+//
+// Covers what the kernel driver does that the decoder has to get right: 1920x1080 comes back in 1920x1088 buffers and
+// is cropped to the picture, a new size reallocates the capture buffers while frames of the old size are still held,
+// held frames go back to the codec when freed on another thread, and a corrupt jpg or a codec that stops answering
+// fails the decode without breaking the next one.
+
+#include "load_image.h"
+#include "v4l2_mock_device.h"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <jpeglib.h>
+
+#include <SDL3/SDL.h>
+
+
+// copied out frames, in place of the pixel pool of load_image.cpp
+static int allocs = 0;
+static unsigned char *_alloc_pixeldata(size_t len) {
+    allocs++;
+    return (unsigned char*)malloc(len);
+}
+static void _release_pixeldata(unsigned char *pixeldata) {
+    allocs--;
+    free(pixeldata);
+}
+
+#include "loader_v4l2.cpp"
+
+DecodedImage::DecodedImage() = default;
+DecodedImage::~DecodedImage() { if (!mapping && decoder) decoder->free_pixeldata(pixeldata, pixeldata_len); }
+
+
+static int failures = 0;
+#define CHECK(cond) do { if (!(cond)) { printf("FAILED line %d: %s\n", __LINE__, #cond); failures++; } } while (0)
+
+
+// A jpg of width x height with a pattern that differs with seed
+static std::vector<unsigned char> make_jpeg(int width, int height, int seed) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char *out = nullptr;
+    unsigned long out_len = 0;
+    jpeg_mem_dest(&cinfo, &out, &out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    std::vector<unsigned char> row(width * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const int y = cinfo.next_scanline;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = (x + seed * 40) & 0xff;
+            row[x * 3 + 1] = (y * 2 + seed * 90) & 0xff;
+            row[x * 3 + 2] = ((x ^ y) + seed * 17) & 0xff;
+        }
+        JSAMPROW rows[1] = { row.data() };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    std::vector<unsigned char> jpg(out, out + out_len);
+    free(out);
+    return jpg;
+}
+
+// Valid headers, but the scan uses a huffman table that was never defined: libjpeg gives up when decoding starts
+static std::vector<unsigned char> make_corrupt_jpeg() {
+    std::vector<unsigned char> jpg = make_jpeg(640, 480, 0);
+    for (size_t i = 0; i + 5 < jpg.size(); i++) {
+        if (jpg[i] == 0xff && jpg[i + 1] == 0xda) { // SOS: length, component count, then component id and tables
+            jpg[i + 6] = 0x33;
+            break;
+        }
+    }
+    return jpg;
+}
+
+static int count_fds() {
+    int n = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    while (readdir(dir)) n++;
+    closedir(dir);
+    return n;
+}
+
+// Same pixels as a plain libjpeg decode, top down and tightly packed, and through the DMABUF if there is one
+static bool matches(const DecodedImage &img, const std::vector<unsigned char> &jpg) {
+    int width = 0, height = 0;
+    std::vector<unsigned char> ref((size_t)img.width * img.height * 4);
+    MockV4L2Device::decode_jpeg(jpg.data(), jpg.size(), nullptr, 0, width, height);
+    if (width != img.width || height != img.height || !img.top_down || img.pixeldata_len != ref.size()) return false;
+    MockV4L2Device::decode_jpeg(jpg.data(), jpg.size(), ref.data(), width * 4, width, height);
+    if (memcmp(ref.data(), img.pixeldata, ref.size()) != 0) return false;
+    if (img.dmabuf_fd < 0) return true;
+
+    const size_t len = img.dmabuf_offset + (size_t)img.dmabuf_pitch * img.height;
+    unsigned char *mapping = (unsigned char*)mmap(nullptr, len, PROT_READ, MAP_SHARED, img.dmabuf_fd, 0);
+    if (mapping == MAP_FAILED) return false;
+    bool same = true;
+    for (int y = 0; y < img.height && same; y++) {
+        same = memcmp(mapping + img.dmabuf_offset + (size_t)y * img.dmabuf_pitch, ref.data() + (size_t)y * width * 4, width * 4) == 0;
+    }
+    munmap(mapping, len);
+    return same;
+}
+
+static DecodedImagePtr decode(ImageDecoder *decoder, const std::vector<unsigned char> &jpg, const char *name) {
+    auto img = std::make_shared<DecodedImage>();
+    if (!decoder->decode(*img, jpg.data(), jpg.size(), name, 0, 0)) return nullptr;
+    img->decoder = decoder;
+    img->format = decoder->pixel_format();
+    img->path = name;
+    return img;
+}
+
+
+int main() {
+    const int fds_before = count_fds();
+    const auto hd1 = make_jpeg(1920, 1080, 1);      // 1088 lines in the codec
+    const auto hd2 = make_jpeg(1920, 1080, 2);
+    const auto uxga = make_jpeg(1600, 1200, 3);     // aligned both ways
+    const auto odd = make_jpeg(1000, 750, 4);       // padded pitch: always copied out
+    const auto corrupt = make_corrupt_jpeg();
+
+    {
+        auto device = std::make_unique<MockV4L2Device>();
+        MockV4L2Device *mock = device.get();
+        DecoderRegistry registry;
+        registry.add(std::make_unique<V4L2Decoder>(std::move(device)));
+        CHECK(registry.select());
+        ImageDecoder *decoder = registry.get_preferred();
+        CHECK(decoder && strcmp(decoder->name(), "v4l2") == 0);
+        if (!decoder) return 1;
+
+        // 1080p: cropped out of the 1088 line buffer, straight from the codec
+        auto a = decode(decoder, hd1, "hd1");
+        CHECK(a && a->width == 1920 && a->height == 1080);
+        CHECK(a && a->dmabuf_fd >= 0 && a->dmabuf_pitch == 1920 * 4 && a->dmabuf_offset == 0);
+        CHECK(a && matches(*a, hd1));
+        printf("1080p: %dx%d, dmabuf %s\n", a ? a->width : 0, a ? a->height : 0, a && a->dmabuf_fd >= 0 ? "yes" : "no");
+
+        // frames are held until too few capture buffers would stay queued, then they are copied out
+        std::vector<DecodedImagePtr> held = { a };
+        for (int i = 0; i < 6; i++) {
+            const auto &jpg = i % 2 ? hd1 : hd2;
+            auto img = decode(decoder, jpg, "held");
+            CHECK(img && matches(*img, jpg));
+            held.push_back(img);
+        }
+        int zero_copy = 0;
+        for (auto &img : held) zero_copy += img && img->dmabuf_fd >= 0;
+        CHECK(zero_copy == V4L2_CAPTURE_BUFFERS - V4L2_MIN_QUEUED_CAPTURE);
+        CHECK(allocs == (int)held.size() - zero_copy);
+        printf("%zu frames held: %d zero copy, %d copied out\n", held.size(), zero_copy, allocs);
+
+        // freed on another thread, like the cache does: the decoding thread queues them again
+        a = nullptr;
+        std::thread([&held] { held.clear(); }).join();
+        CHECK(allocs == 0);
+        auto b = decode(decoder, hd2, "hd2");
+        CHECK(b && b->dmabuf_fd >= 0 && matches(*b, hd2));
+
+        // a new size while b is held: its buffer outlives the reallocation
+        const int changes = mock->source_changes;
+        auto c = decode(decoder, uxga, "uxga");
+        CHECK(mock->source_changes == changes + 1);
+        CHECK(c && c->dmabuf_fd >= 0 && matches(*c, uxga));
+        CHECK(b && matches(*b, hd2));
+        auto d = decode(decoder, odd, "odd");
+        CHECK(d && d->dmabuf_fd < 0 && matches(*d, odd));
+        CHECK(c && matches(*c, uxga));
+        b = c = d = nullptr;
+        CHECK(allocs == 0);
+
+        // a corrupt jpg fails for good, the next one decodes
+        CHECK(!decode(decoder, corrupt, "corrupt"));
+        CHECK(!decoder->transient_failure);
+        auto e = decode(decoder, odd, "odd");
+        CHECK(e && matches(*e, odd));
+        e = nullptr;
+
+        // a codec that stops answering times out, which is not the file's fault, and works again afterwards
+        mock->hang = true;
+        const Uint64 start = SDL_GetTicks();
+        CHECK(!decode(decoder, hd1, "hang"));
+        const Uint64 waited = SDL_GetTicks() - start;
+        CHECK(waited >= V4L2_DECODE_TIMEOUT_MS && waited < V4L2_DECODE_TIMEOUT_MS + 1000);
+        CHECK(decoder->transient_failure);
+        mock->hang = false;
+        auto f = decode(decoder, hd1, "hd1");
+        CHECK(f && matches(*f, hd1));
+        f = nullptr;
+        printf("timed out after %llums, %d decodes, %d DMABUFs exported, %d source changes\n",
+               (unsigned long long)waited, mock->decodes, mock->exported, mock->source_changes);
+    }
+
+    // the decoder closed every DMABUF and unmapped every buffer
+    CHECK(allocs == 0);
+    CHECK(count_fds() == fds_before);
+
+    printf(failures ? "%d checks FAILED\n" : "all passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <cerrno>
+
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// Every syscall the V4L2 decoder makes on its device, so a software stand-in can take the place of the kernel driver.
+// Same conventions as the syscalls: -1 (MAP_FAILED for map) and errno on failure.
+class V4L2Device {
+public:
+    virtual ~V4L2Device() {}
+
+    virtual int open_device() = 0;
+    virtual void close_device() = 0;
+    virtual int xioctl(unsigned long request, void *arg) = 0;
+    virtual void *map(size_t length, off_t offset) = 0;
+    virtual int unmap(void *addr, size_t length) = 0;
+    virtual int wait(short events, short &revents, int timeout_ms) = 0; // poll() on the device
+};
+
+
+class KernelV4L2Device : public V4L2Device {
+public:
+    KernelV4L2Device(const std::string &device_path) : path(device_path) {}
+    ~KernelV4L2Device() override { close_device(); }
+
+    // non blocking: DQBUF must not wait, readiness comes from wait()
+    int open_device() override {
+        fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        return fd;
+    }
+
+    void close_device() override {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    int xioctl(unsigned long request, void *arg) override {
+        int ret;
+        do { ret = ioctl(fd, request, arg); } while (ret < 0 && errno == EINTR);
+        return ret;
+    }
+
+    void *map(size_t length, off_t offset) override { return mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset); }
+    int unmap(void *addr, size_t length) override { return munmap(addr, length); }
+
+    int wait(short events, short &revents, int timeout_ms) override {
+        struct pollfd pfd = { fd, events, 0 };
+        int ret;
+        do { ret = poll(&pfd, 1, timeout_ms); } while (ret < 0 && errno == EINTR);
+        revents = pfd.revents;
+        return ret;
+    }
+
+    const std::string path;
+
+private:
+    int fd = -1;
+};
@@ -0,0 +1,377 @@
+#pragma once
+
+#include "v4l2_device.h"
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <sys/mman.h>
+#include <jpeglib.h>
+
+
+// Software stand-in for the bcm2835-codec jpeg decoder, so V4L2Decoder runs on any Linux box, see test_v4l2.cpp.
+// Decodes with libjpeg to RGBA32 and behaves like the driver where the decoder depends on it: the capture buffers are
+// aligned to 32 pixels across and 16 lines down (1920x1080 comes back as 1920x1088, the compose rectangle is the
+// picture), a jpg of another size stops the capture queue with a source change event and a LAST buffer, a corrupt jpg
+// comes back with V4L2_BUF_FLAG_ERROR, and STOP drains with an EOS event. Buffers are memfds, EXPBUF dups them.
+// Frames are decoded whenever the decoder calls in, on its own thread.
+class MockV4L2Device : public V4L2Device {
+public:
+    bool hang = false;      // stop producing frames, like a codec that locked up
+    int decodes = 0;        // jpgs decoded into a capture buffer, corrupt ones included
+    int source_changes = 0;
+    int exported = 0;       // DMABUFs handed out by EXPBUF
+
+    // Reads the size of jpg, and decodes it to RGBA rows pitch bytes apart into dst unless that is null, the way the
+    // codec does. false if libjpeg gives up on it. Also the reference the tests compare frames against.
+    static bool decode_jpeg(const unsigned char *jpg, size_t jpg_len, unsigned char *dst, size_t pitch, int &width, int &height) {
+        struct jpeg_decompress_struct cinfo;
+        Error err;
+        cinfo.err = jpeg_std_error(&err.pub);
+        err.pub.error_exit = on_error;
+        err.pub.output_message = [](j_common_ptr) {}; // corrupt data warnings, the decoder logs what matters
+        if (setjmp(err.jump)) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+        jpeg_create_decompress(&cinfo);
+        jpeg_mem_src(&cinfo, jpg, jpg_len);
+        jpeg_read_header(&cinfo, TRUE);
+        width = cinfo.image_width;
+        height = cinfo.image_height;
+        if (dst) {
+            cinfo.out_color_space = JCS_EXT_RGBA;
+            jpeg_start_decompress(&cinfo);
+            while (cinfo.output_scanline < cinfo.output_height) {
+                JSAMPROW row = dst + cinfo.output_scanline * pitch;
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
+        }
+        jpeg_destroy_decompress(&cinfo);
+        return true;
+    }
+
+    ~MockV4L2Device() override {
+        for (auto &buf : output) close(buf.fd);
+        for (auto &buf : capture) close(buf.fd);
+    }
+
+    int open_device() override {
+        is_open = true;
+        return 0;
+    }
+
+    void close_device() override { is_open = false; }
+
+    void *map(size_t length, off_t offset) override {
+        const bool is_capture = offset & CAPTURE_OFFSET;
+        std::vector<Buffer> &queue = is_capture ? capture : output;
+        const size_t index = (offset & ~CAPTURE_OFFSET) / INDEX_OFFSET;
+        if (index >= queue.size() || length != queue[index].length) {
+            errno = EINVAL;
+            return MAP_FAILED;
+        }
+        return mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, queue[index].fd, 0);
+    }
+
+    int unmap(void *addr, size_t length) override { return munmap(addr, length); }
+
+    int wait(short events, short &revents, int timeout_ms) override {
+        process();
+        revents = 0;
+        if (!pending_events.empty()) revents |= POLLPRI;
+        if (!capture_done.empty() || (halted && capture_on)) revents |= POLLIN;
+        if (!output_done.empty()) revents |= POLLOUT;
+        revents &= events | POLLERR;
+        return revents ? 1 : 0; // never blocks: a hung codec times out as quickly as the decoder gives up polling
+    }
+
+    int xioctl(unsigned long request, void *arg) override {
+        if (!is_open) return fail(EBADF);
+        process();
+        switch (request) {
+        case VIDIOC_QUERYCAP:           return query_cap((struct v4l2_capability*)arg);
+        case VIDIOC_S_FMT:              return set_format((struct v4l2_format*)arg);
+        case VIDIOC_G_FMT:              return get_format((struct v4l2_format*)arg);
+        case VIDIOC_G_SELECTION:        return get_selection((struct v4l2_selection*)arg);
+        case VIDIOC_SUBSCRIBE_EVENT:    return 0;
+        case VIDIOC_DQEVENT:            return dequeue_event((struct v4l2_event*)arg);
+        case VIDIOC_REQBUFS:            return request_buffers((struct v4l2_requestbuffers*)arg);
+        case VIDIOC_QUERYBUF:           return query_buffer((struct v4l2_buffer*)arg);
+        case VIDIOC_EXPBUF:             return export_buffer((struct v4l2_exportbuffer*)arg);
+        case VIDIOC_QBUF:               return queue_buffer((struct v4l2_buffer*)arg);
+        case VIDIOC_DQBUF:              return dequeue_buffer((struct v4l2_buffer*)arg);
+        case VIDIOC_STREAMON:           return stream(*(int*)arg, true);
+        case VIDIOC_STREAMOFF:          return stream(*(int*)arg, false);
+        case VIDIOC_DECODER_CMD:        return decoder_command((struct v4l2_decoder_cmd*)arg);
+        }
+        return fail(ENOTTY);
+    }
+
+private:
+    static constexpr off_t CAPTURE_OFFSET = (off_t)1 << 28;  // mem_offset of the buffers, as QUERYBUF reports them
+    static constexpr off_t INDEX_OFFSET = (off_t)1 << 20;
+
+    struct Buffer {
+        int fd = -1;
+        size_t length = 0;
+        bool queued = false;    // owned by the codec
+        bool done = false;      // waiting to be dequeued
+        uint32_t flags = 0;
+        uint32_t bytesused = 0;
+        struct timeval timestamp = {};
+    };
+
+    struct Error {
+        struct jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+    static void on_error(j_common_ptr cinfo) { longjmp(((Error*)cinfo->err)->jump, 1); }
+
+    static int align(int value, int to) { return (value + to - 1) / to * to; }
+    static int fail(int error) {
+        errno = error;
+        return -1;
+    }
+
+    int pitch() { return align(coded_w, 32) * 4; }
+    int aligned_h() { return align(coded_h, 16); }
+
+    void finish(std::vector<Buffer> &queue, std::deque<int> &done, int index, uint32_t flags, uint32_t bytesused, struct timeval timestamp) {
+        Buffer &buf = queue[index];
+        buf.queued = false;
+        buf.done = true;
+        buf.flags = flags;
+        buf.bytesused = bytesused;
+        buf.timestamp = timestamp;
+        done.push_back(index);
+    }
+
+    // The size changed: a source change event, and the capture buffer after the last frame of the old size comes
+    // back empty with the LAST flag. The capture queue stays stopped until it is set up again.
+    void change_source(int width, int height) {
+        coded_w = width;
+        coded_h = height;
+        source_changes++;
+        struct v4l2_event event = {};
+        event.type = V4L2_EVENT_SOURCE_CHANGE;
+        event.u.src_change.changes = V4L2_EVENT_SRC_CH_RESOLUTION;
+        pending_events.push_back(event);
+        if (capture_on && !capture_queue.empty()) {
+            finish(capture, capture_done, capture_queue.front(), V4L2_BUF_FLAG_LAST, 0, {});
+            capture_queue.pop_front();
+        }
+        halted = true;
+    }
+
+    // What the codec does in the background, run whenever the decoder calls in
+    void process() {
+        if (hang) return;
+        while (output_on && !output_queue.empty()) {
+            const int in = output_queue.front();
+            Buffer &src = output[in];
+            unsigned char *jpg = (unsigned char*)mmap(nullptr, src.length, PROT_READ, MAP_SHARED, src.fd, 0);
+            int width = 0, height = 0;
+            bool ok = decode_jpeg(jpg, src.bytesused, nullptr, 0, width, height);
+            if (ok && (width != coded_w || height != coded_h)) {
+                if (!halted) change_source(width, height); // the jpg stays queued until the capture queue is set up again
+                munmap(jpg, src.length);
+                return;
+            }
+            if (!capture_on || halted || capture_queue.empty()) {
+                munmap(jpg, src.length);
+                return;
+            }
+
+            const int out = capture_queue.front();
+            capture_queue.pop_front();
+            Buffer &dst = capture[out];
+            unsigned char *frame = (unsigned char*)mmap(nullptr, dst.length, PROT_READ | PROT_WRITE, MAP_SHARED, dst.fd, 0);
+            memset(frame, 0xee, dst.length); // the alignment padding must never be shown
+            if (ok) ok = decode_jpeg(jpg, src.bytesused, frame, pitch(), width, height);
+            munmap(frame, dst.length);
+            munmap(jpg, src.length);
+            decodes++;
+
+            finish(capture, capture_done, out, ok ? 0 : V4L2_BUF_FLAG_ERROR, ok ? dst.length : 0, src.timestamp);
+            output_queue.pop_front();
+            finish(output, output_done, in, 0, 0, src.timestamp);
+        }
+
+        if (draining && capture_on && !capture_queue.empty() && output_queue.empty()) {
+            finish(capture, capture_done, capture_queue.front(), V4L2_BUF_FLAG_LAST, 0, {});
+            capture_queue.pop_front();
+            struct v4l2_event event = {};
+            event.type = V4L2_EVENT_EOS;
+            pending_events.push_back(event);
+            draining = false;
+            halted = true;
+        }
+    }
+
+    int query_cap(struct v4l2_capability *cap) {
+        snprintf((char*)cap->card, sizeof(cap->card), "mock-codec-decode");
+        cap->device_caps = V4L2_CAP_VIDEO_M2M_MPLANE | V4L2_CAP_STREAMING;
+        cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+        return 0;
+    }
+
+    void fill_capture_format(struct v4l2_format *fmt) {
+        struct v4l2_pix_format_mplane &pix = fmt->fmt.pix_mp;
+        pix.width = align(coded_w, 32);
+        pix.height = aligned_h();
+        pix.pixelformat = capture_fourcc;
+        pix.num_planes = 1;
+        pix.plane_fmt[0].bytesperline = capture_fourcc == V4L2_PIX_FMT_RGBA32 ? pitch() : align(coded_w, 32);
+        pix.plane_fmt[0].sizeimage = pix.plane_fmt[0].bytesperline * pix.height;
+    }
+
+    int set_format(struct v4l2_format *fmt) {
+        if (fmt->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+            if (!output.empty()) return fail(EBUSY);
+            output_size = std::max<uint32_t>(fmt->fmt.pix_mp.plane_fmt[0].sizeimage, 65536);
+            fmt->fmt.pix_mp.plane_fmt[0].sizeimage = output_size;
+            return 0;
+        }
+        if (fmt->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) return fail(EINVAL);
+        if (capture_on) return fail(EBUSY);
+        const uint32_t fourcc = fmt->fmt.pix_mp.pixelformat;
+        if (fourcc == V4L2_PIX_FMT_RGBA32 || fourcc == V4L2_PIX_FMT_YUV420) capture_fourcc = fourcc;
+        fill_capture_format(fmt);
+        return 0;
+    }
+
+    int get_format(struct v4l2_format *fmt) {
+        if (fmt->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) return fail(EINVAL);
+        fill_capture_format(fmt);
+        return 0;
+    }
+
+    int get_selection(struct v4l2_selection *sel) {
+        if (sel->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || sel->target != V4L2_SEL_TGT_COMPOSE) return fail(EINVAL);
+        sel->r = { 0, 0, (uint32_t)coded_w, (uint32_t)coded_h };
+        return 0;
+    }
+
+    int dequeue_event(struct v4l2_event *event) {
+        if (pending_events.empty()) return fail(ENOENT);
+        *event = pending_events.front();
+        pending_events.pop_front();
+        return 0;
+    }
+
+    // Old buffers lose their memfd, mappings of them stay valid like orphaned kernel buffers
+    int allocate(std::vector<Buffer> &queue, unsigned int count, size_t length) {
+        for (auto &buf : queue) close(buf.fd);
+        queue.assign(count, Buffer());
+        for (auto &buf : queue) {
+            buf.fd = memfd_create("mock-v4l2-buffer", MFD_CLOEXEC);
+            buf.length = length;
+            if (buf.fd < 0 || ftruncate(buf.fd, length) != 0) return -1;
+        }
+        return 0;
+    }
+
+    int request_buffers(struct v4l2_requestbuffers *req) {
+        if (req->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+            if (output_on && req->count) return fail(EBUSY);
+            output_queue.clear();
+            output_done.clear();
+            return allocate(output, req->count, output_size);
+        }
+        if (capture_on) return fail(EBUSY);
+        capture_queue.clear();
+        capture_done.clear();
+        return allocate(capture, req->count, (size_t)pitch() * aligned_h());
+    }
+
+    int query_buffer(struct v4l2_buffer *buf) {
+        const bool is_capture = buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        std::vector<Buffer> &queue = is_capture ? capture : output;
+        if (buf->index >= queue.size()) return fail(EINVAL);
+        buf->m.planes[0].length = queue[buf->index].length;
+        buf->m.planes[0].m.mem_offset = (is_capture ? CAPTURE_OFFSET : 0) + buf->index * INDEX_OFFSET;
+        return 0;
+    }
+
+    int export_buffer(struct v4l2_exportbuffer *expbuf) {
+        if (expbuf->index >= capture.size()) return fail(EINVAL);
+        expbuf->fd = dup(capture[expbuf->index].fd);
+        exported++;
+        return 0;
+    }
+
+    int queue_buffer(struct v4l2_buffer *buf) {
+        const bool is_capture = buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        std::vector<Buffer> &queue = is_capture ? capture : output;
+        if (buf->index >= queue.size() || queue[buf->index].queued || queue[buf->index].done) return fail(EINVAL);
+        Buffer &b = queue[buf->index];
+        b.queued = true;
+        b.flags = 0;
+        if (is_capture) {
+            capture_queue.push_back(buf->index);
+        } else {
+            b.bytesused = buf->m.planes[0].bytesused;
+            b.timestamp = buf->timestamp;
+            output_queue.push_back(buf->index);
+        }
+        process();
+        return 0;
+    }
+
+    int dequeue_buffer(struct v4l2_buffer *buf) {
+        const bool is_capture = buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        std::deque<int> &done = is_capture ? capture_done : output_done;
+        std::vector<Buffer> &queue = is_capture ? capture : output;
+        if (done.empty()) return fail(is_capture && halted ? EPIPE : EAGAIN);
+        const int index = done.front();
+        done.pop_front();
+        queue[index].done = false;
+        buf->index = index;
+        buf->flags = queue[index].flags;
+        buf->timestamp = queue[index].timestamp;
+        buf->m.planes[0].bytesused = queue[index].bytesused;
+        return 0;
+    }
+
+    int stream(int type, bool on) {
+        const bool is_capture = type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        if (!on) {
+            for (auto &buf : is_capture ? capture : output) buf.queued = buf.done = false;
+            (is_capture ? capture_queue : output_queue).clear();
+            (is_capture ? capture_done : output_done).clear();
+        }
+        if (is_capture) {
+            capture_on = on;
+            halted = false;
+        } else {
+            output_on = on;
+        }
+        process();
+        return 0;
+    }
+
+    int decoder_command(struct v4l2_decoder_cmd *cmd) {
+        if (cmd->cmd != V4L2_DEC_CMD_STOP) return fail(EINVAL);
+        draining = true;
+        process();
+        return 0;
+    }
+
+    bool is_open = false;
+    bool output_on = false, capture_on = false;
+    bool halted = false;        // capture queue stopped after a source change or a drain, until STREAMON
+    bool draining = false;
+    int coded_w = 32, coded_h = 32; // what the driver reports before it has seen a jpg
+    uint32_t capture_fourcc = V4L2_PIX_FMT_YUV420;
+    uint32_t output_size = 0;
+
+    std::vector<Buffer> output, capture;
+    std::deque<int> output_queue, capture_queue;    // queued, in the order the codec takes them
+    std::deque<int> output_done, capture_done;      // ready to be dequeued
+    std::deque<struct v4l2_event> pending_events;
+};
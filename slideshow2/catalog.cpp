@@ -0,0 +1,355 @@
+#include "catalog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+static const char CATALOG_MAGIC[4] = {'R', 'P', 'C', 'A'};
+static const uint32_t CATALOG_VERSION = 1;
+
+
+static int64_t to_ns(const struct timespec &ts) { return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec; }
+
+static bool folder_mtime(const std::string &folder, int64_t &mtime_ns) {
+    struct stat st;
+    if (stat(folder.c_str(), &st) != 0) return false;
+    mtime_ns = to_ns(st.st_mtim);
+    return true;
+}
+
+
+static uint32_t read_be32(const unsigned char *p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+// TIFF (inside EXIF) is big or little endian, as the camera likes
+static uint16_t tiff_u16(const unsigned char *p, bool le) { return le ? p[0] | (p[1] << 8) : (p[0] << 8) | p[1]; }
+static uint32_t tiff_u32(const unsigned char *p, bool le) { return le ? p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24) : read_be32(p); }
+
+// Value (or offset of the value, if it takes more than 4 bytes) of tag in the IFD at ifd, false if it is not there
+static bool tiff_tag(const unsigned char *tiff, size_t len, bool le, uint32_t ifd, uint16_t tag, uint32_t &count_out, uint32_t &value_out) {
+    if (ifd > len || len - ifd < 2) return false;
+    const int num_entries = tiff_u16(tiff + ifd, le);
+    for (int i = 0; i < num_entries; i++) {
+        const size_t pos = ifd + 2 + (size_t)i * 12;
+        if (pos + 12 > len) return false;
+        if (tiff_u16(tiff + pos, le) != tag) continue;
+        count_out = tiff_u32(tiff + pos + 4, le);
+        value_out = tiff_u32(tiff + pos + 8, le);
+        return true;
+    }
+    return false;
+}
+
+// "YYYY:MM:DD HH:MM:SS" of DateTimeOriginal, or of DateTime if the camera left that out
+static int64_t exif_capture_time(const unsigned char *tiff, size_t len) {
+    if (len < 8 || (memcmp(tiff, "II*\0", 4) != 0 && memcmp(tiff, "MM\0*", 4) != 0)) return 0;
+    const bool le = tiff[0] == 'I';
+    const uint32_t ifd0 = tiff_u32(tiff + 4, le);
+
+    uint32_t count = 0, value = 0, exif_ifd = 0;
+    bool found = tiff_tag(tiff, len, le, ifd0, 0x8769, count, exif_ifd) && tiff_tag(tiff, len, le, exif_ifd, 0x9003, count, value);
+    if (!found) found = tiff_tag(tiff, len, le, ifd0, 0x0132, count, value);
+    if (!found || count < 20 || value > len || len - value < 20) return 0;
+
+    char date[20];
+    memcpy(date, tiff + value, 19);
+    date[19] = 0;
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(date, "%4d:%2d:%2d %2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6 || tm.tm_year < 1900) return 0;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return timegm(&tm); // the camera's local time, as if it were UTC: good enough to order by
+}
+
+// Frame size and sampling from SOFn, capture time from the EXIF segment (APP1). Stops at the first scan.
+static void describe_jpeg(const unsigned char *p, size_t len, Catalog::Entry &entry) {
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (p[pos] != 0xFF) { pos++; continue; }
+        const unsigned char marker = p[pos + 1];
+        if (marker == 0xFF) { pos++; continue; }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) { pos += 2; continue; }
+
+        const size_t segment = (p[pos + 2] << 8) | p[pos + 3];
+        if (segment < 2 || segment > len - pos - 2) return;
+        const unsigned char *data = p + pos + 4;
+        if (marker == 0xE1 && segment >= 8 && memcmp(data, "Exif\0\0", 6) == 0) {
+            entry.capture_time = exif_capture_time(data + 6, segment - 8);
+        } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC && segment >= 11) {
+            entry.height = (data[1] << 8) | data[2];
+            entry.width = (data[3] << 8) | data[4];
+            entry.luma_sampling = data[7];
+        } else if (marker == 0xDA || marker == 0xD9) {
+            return;
+        }
+        pos += 2 + segment;
+    }
+}
+
+static void describe_image(const unsigned char *p, size_t len, Catalog::Entry &entry) {
+    if (len >= 3 && p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF) {
+        describe_jpeg(p, len, entry);
+        return;
+    }
+    uint32_t width = 0, height = 0;
+    if (len >= 24 && memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        width = read_be32(p + 16);
+        height = read_be32(p + 20);
+    } else if (len >= 12 && memcmp(p, "qoif", 4) == 0) {
+        width = read_be32(p + 4);
+        height = read_be32(p + 8);
+    }
+    if (width <= UINT16_MAX && height <= UINT16_MAX) {
+        entry.width = width;
+        entry.height = height;
+    }
+}
+
+
+
+Catalog::Catalog(const std::string &path, const std::string &folder) : file(path), prefix(folder) {
+    if (prefix.empty() || prefix.back() != '/') prefix += '/';
+    if (!file.empty()) open_file();
+}
+
+
+Catalog::~Catalog() {
+    close_file();
+}
+
+
+// Checks only what mapping it needs: the sizes add up and the names end. Records are checked as they are used.
+bool Catalog::open_file() {
+    fd = open(file.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false; // first run
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header)) {
+        void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mem != MAP_FAILED) {
+            map = (const unsigned char*)mem;
+            map_size = st.st_size;
+        }
+    }
+
+    const Header *header = (const Header*)map;
+    if (map && memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) == 0 && header->version == CATALOG_VERSION &&
+        map_size == sizeof(Header) + (size_t)header->count * sizeof(Entry) + header->names_size &&
+        (header->names_size == 0 ? header->count == 0 : map[map_size - 1] == 0)) {
+        count = header->count;
+        names_size = header->names_size;
+        return true;
+    }
+
+    printf("%s is not a catalog of this version, making a new one\n", file.c_str());
+    close_file();
+    return false;
+}
+
+
+void Catalog::close_file() {
+    if (map) munmap((void*)map, map_size);
+    if (fd >= 0) close(fd);
+    map = nullptr;
+    map_size = 0;
+    fd = -1;
+    count = 0;
+    names_size = 0;
+}
+
+
+bool Catalog::strip_prefix(const std::string &path, std::string_view &name_out) {
+    if (path.size() <= prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+    name_out = std::string_view(path).substr(prefix.size());
+    return true;
+}
+
+
+std::string_view Catalog::name(const Entry &entry) {
+    return entry.name_offset < names_size ? std::string_view(names() + entry.name_offset) : std::string_view();
+}
+
+
+int Catalog::find_name(std::string_view name_in) {
+    const Entry *begin = entries(), *end = entries() + count;
+    const Entry *pos = std::lower_bound(begin, end, name_in, [this](const Entry &e, std::string_view v) { return name(e) < v; });
+    return pos != end && name(*pos) == name_in ? pos - begin : -1;
+}
+
+
+bool Catalog::list(std::vector<std::string> &paths_out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t mtime_ns;
+    if (!map || !folder_mtime(prefix, mtime_ns) || mtime_ns != ((const Header*)map)->folder_mtime_ns) return false;
+
+    paths_out.clear();
+    paths_out.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const std::string_view n = name(entries()[i]);
+        if (n.empty()) return false; // damaged, the folder is scanned instead
+        paths_out.push_back(prefix + std::string(n));
+    }
+    return true;
+}
+
+
+void Catalog::set_files(const std::vector<std::string> &paths) {
+    if (file.empty()) return;
+    std::vector<std::string_view> new_names;
+    new_names.reserve(paths.size());
+    for (const auto &path : paths) {
+        std::string_view n;
+        if (strip_prefix(path, n)) new_names.push_back(n);
+    }
+    std::sort(new_names.begin(), new_names.end());
+    new_names.erase(std::unique(new_names.begin(), new_names.end()), new_names.end());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t mtime_ns;
+    if (map && folder_mtime(prefix, mtime_ns) && mtime_ns == ((const Header*)map)->folder_mtime_ns && new_names.size() == count) {
+        bool same = true;
+        for (uint32_t i = 0; i < count && same; i++) same = name(entries()[i]) == new_names[i];
+        if (same) return; // up to date, no need to wear the SD card
+    }
+    save(new_names);
+}
+
+
+void Catalog::update_files(const std::vector<std::string> &added, const std::vector<std::string> &removed) {
+    if (file.empty()) return;
+    std::vector<std::string_view> add, remove;
+    for (const auto &path : added) {
+        std::string_view n;
+        if (strip_prefix(path, n)) add.push_back(n);
+    }
+    for (const auto &path : removed) {
+        std::string_view n;
+        if (strip_prefix(path, n)) remove.push_back(n);
+    }
+    std::sort(remove.begin(), remove.end());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string_view> new_names;
+    new_names.reserve(count + add.size());
+    for (uint32_t i = 0; i < count; i++) {
+        const std::string_view n = name(entries()[i]);
+        if (!std::binary_search(remove.begin(), remove.end(), n)) new_names.push_back(n);
+    }
+    for (const auto &n : add) {
+        if (!std::binary_search(remove.begin(), remove.end(), n)) new_names.push_back(n);
+    }
+    std::sort(new_names.begin(), new_names.end());
+    new_names.erase(std::unique(new_names.begin(), new_names.end()), new_names.end());
+    save(new_names);
+}
+
+
+// The whole file, through a temporary one so a crash never leaves half of it. new_names may point into the old
+// mapping, it is only replaced at the end. Writing the file changes the folder when the catalog lives in it, so the
+// folder's mtime is stored last.
+void Catalog::save(const std::vector<std::string_view> &new_names) {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_VERSION;
+    header.count = new_names.size();
+    for (const auto &n : new_names) header.names_size += n.size() + 1;
+
+    const std::string tmp_path = file + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        printf("Cannot write %s, the catalog is not kept across restarts\n", tmp_path.c_str());
+        return;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint32_t name_offset = 0;
+    for (const auto &n : new_names) {
+        Entry entry;
+        const int pos = find_name(n);
+        if (pos >= 0) entry = entries()[pos];
+        else memset(&entry, 0, sizeof(entry));
+        entry.name_offset = name_offset;
+        name_offset += n.size() + 1;
+        written = fwrite(&entry, sizeof(entry), 1, f) == 1 && written;
+    }
+    for (const auto &n : new_names) written = fwrite(n.data(), 1, n.size(), f) == n.size() && fputc(0, f) == 0 && written;
+    written = fclose(f) == 0 && written;
+    if (!written || rename(tmp_path.c_str(), file.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return;
+    }
+
+    close_file();
+    if (!open_file() || !folder_mtime(prefix, header.folder_mtime_ns) ||
+        pwrite(fd, &header.folder_mtime_ns, sizeof(header.folder_mtime_ns), offsetof(Header, folder_mtime_ns)) != sizeof(header.folder_mtime_ns)) {
+        printf("Cannot write %s, the folder is scanned at the next start\n", file.c_str());
+    }
+}
+
+
+void Catalog::describe(const std::string &path, const unsigned char *data, size_t len, uint32_t decode_us) {
+    std::string_view n;
+    if (!strip_prefix(path, n)) return;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!map) return;
+    const int pos = find_name(n);
+    if (pos < 0) return; // not listed yet, it is described the next time
+
+    Entry entry = entries()[pos];
+    if (entry.size != (uint64_t)st.st_size || entry.mtime_ns != to_ns(st.st_mtim)) {
+        const uint32_t name_offset = entry.name_offset;
+        memset(&entry, 0, sizeof(entry));
+        entry.name_offset = name_offset;
+        entry.size = st.st_size;
+        entry.mtime_ns = to_ns(st.st_mtim);
+        describe_image(data, len, entry);
+    }
+    if (decode_us) entry.decode_us = decode_us;
+    if (memcmp(&entry, &entries()[pos], sizeof(entry)) == 0) return;
+    if (pwrite(fd, &entry, sizeof(entry), sizeof(Header) + (size_t)pos * sizeof(Entry)) != sizeof(entry)) return; // read only, or the drive is full: the next decode tries again
+}
+
+
+bool Catalog::find(const std::string &path, Entry &entry_out) {
+    std::string_view n;
+    if (!strip_prefix(path, n)) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    const int pos = map ? find_name(n) : -1;
+    if (pos < 0) return false;
+    entry_out = entries()[pos];
+    return true;
+}
+
+
+int64_t Catalog::before_own_write() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t mtime_ns;
+    if (!map || !folder_mtime(prefix, mtime_ns) || mtime_ns != ((const Header*)map)->folder_mtime_ns) return 0;
+    return mtime_ns;
+}
+
+
+// A file created by someone else during the write is covered up until the watcher reports it: while running, that is
+// the next update_files(), which stores the mtime again.
+void Catalog::after_own_write(int64_t before) {
+    if (before == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t mtime_ns;
+    if (!map || ((const Header*)map)->folder_mtime_ns != before || !folder_mtime(prefix, mtime_ns) || mtime_ns == before) return;
+    if (pwrite(fd, &mtime_ns, sizeof(mtime_ns), offsetof(Header, folder_mtime_ns)) != sizeof(mtime_ns)) return; // the folder is scanned at the next start
+}
+
+
+size_t Catalog::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
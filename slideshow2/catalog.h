@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+
+// What is known about the images of one folder, kept across restarts in one binary file that is mapped, not parsed:
+// a header, a fixed size record per image sorted by name, then the names. The file also remembers the mtime of the
+// folder, which changes whenever a file is added, removed or renamed in it, so while it matches the file list
+// comes straight from the catalog without listing the folder or touching a single image.
+// Records are described when an image is decoded anyway, and written in place right then. They only hold for the
+// size and mtime the image had at that time: a record of an image that changed since is described again.
+// Thread safe.
+class Catalog {
+public:
+    struct Entry {
+        uint64_t size;          // of the file when it was described, 0 if it was not described yet
+        int64_t mtime_ns;
+        int64_t capture_time;   // DateTimeOriginal from EXIF as seconds since 1970, camera local time. 0 if unknown.
+        uint32_t name_offset;   // into the names
+        uint32_t decode_us;     // the last full decode, 0 if unknown
+        uint16_t width, height; // of the file, not of the decoded frame. 0 if not a jpg, png or qoi.
+        uint8_t luma_sampling;  // sampling factors of a jpg's first component (H << 4 | V): 0x22 is 4:2:0, 0x11 4:4:4
+        uint8_t reserved[3];
+    };
+
+    // file: where the catalog is kept, empty disables it
+    Catalog(const std::string &file, const std::string &folder);
+    ~Catalog();
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // The images of the folder at the last save, false if the folder changed since or there is no catalog.
+    // One stat() of the folder, none of the images.
+    bool list(std::vector<std::string> &paths_out);
+
+    // The folder was scanned: these are all of its images now. Entries of the ones already known are kept.
+    void set_files(const std::vector<std::string> &paths);
+
+    // Images arrived in or left the folder
+    void update_files(const std::vector<std::string> &added, const std::vector<std::string> &removed);
+
+    // path was just decoded from data in decode_us (0 if unknown). Headers are only parsed if the image is new
+    // or changed since it was described last.
+    void describe(const std::string &path, const unsigned char *data, size_t len, uint32_t decode_us);
+
+    bool find(const std::string &path, Entry &entry_out);
+
+    // Around a write of one of our own files into the folder (quarantine, state): it changes the folder's mtime, not
+    // its images. If the catalog was up to date before the write it stays so, otherwise nothing happens.
+    // before_own_write() returns what to pass to after_own_write().
+    int64_t before_own_write();
+    void after_own_write(int64_t before);
+
+    size_t size();
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t count;
+        uint32_t names_size;
+        int64_t folder_mtime_ns;
+    };
+
+    bool open_file();
+    void close_file();
+    bool strip_prefix(const std::string &path, std::string_view &name_out);
+    const Entry *entries() { return (const Entry*)(map + sizeof(Header)); }
+    const char *names() { return (const char*)(map + sizeof(Header) + (size_t)count * sizeof(Entry)); }
+    std::string_view name(const Entry &entry);
+    int find_name(std::string_view name_in);
+    void save(const std::vector<std::string_view> &new_names); // mutex must be held
+
+private:
+    const std::string file;
+    std::string prefix; // folder with a trailing slash
+    std::mutex mutex;
+
+    int fd = -1;
+    const unsigned char *map = nullptr;
+    size_t map_size = 0;
+    uint32_t count = 0;
+    uint32_t names_size = 0;
+};
@@ -367,8 +367,9 @@ int DRM::drm_atomic_commit(uint32_t fb_id, uint32_t flags)
 		add_plane_property(this->plane, req, plane_id, "IN_FENCE_FD", this->kms_in_fence_fd);
 	}
 
-	int ret = drmModeAtomicCommit(this->fd, req, flags, NULL);
+	int ret = drmModeAtomicCommit(this->fd, req, flags, this);
 	if (ret) goto out;
+	if (flags & DRM_MODE_PAGE_FLIP_EVENT) this->flip_pending = true;
 
 	if (this->kms_in_fence_fd != -1) {
 		close(this->kms_in_fence_fd);
@@ -381,3 +382,19 @@ out:
 	return ret;
 }
 
+
+static void page_flip_handler(int, unsigned int, unsigned int tv_sec, unsigned int tv_usec, void *user_data)
+{
+	DRM *drm = (DRM*)user_data;
+	drm->flip_pending = false;
+	drm->last_flip_ns = (int64_t)tv_sec * 1000000000 + (int64_t)tv_usec * 1000;
+}
+
+
+void DRM::handle_events()
+{
+	drmEventContext ctx = {};
+	ctx.version = 2;
+	ctx.page_flip_handler = page_flip_handler;
+	drmHandleEvent(this->fd, &ctx);
+}
@@ -9,6 +9,8 @@ class DRM {
 public:
     DRM();
     int drm_atomic_commit(uint32_t fb_id, uint32_t flags);
+    // Call when fd is readable: reads the page flip events, see flip_pending
+    void handle_events();
 
 public:
     struct Plane {
@@ -39,6 +41,10 @@ public:
 	int kms_in_fence_fd;
 	int kms_out_fence_fd;
 
+	// a commit with DRM_MODE_PAGE_FLIP_EVENT is not on screen yet, the next frame waits for it
+	bool flip_pending = false;
+	int64_t last_flip_ns = 0; // CLOCK_MONOTONIC, when the last frame went on screen
+
 	drmModeModeInfo *mode;
 	uint32_t crtc_id;
 	uint32_t connector_id;
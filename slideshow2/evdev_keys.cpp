@@ -0,0 +1,77 @@
+#include "evdev_keys.h"
+
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <cerrno>
+#include <ctime>
+#include <cstdio>
+
+
+static const int USED_KEYS[] = { KEY_LEFT, KEY_RIGHT, KEY_SPACE };
+
+
+static bool has_bit(const unsigned long *bits, int bit) {
+    const int per_long = sizeof(long) * 8;
+    return (bits[bit / per_long] >> (bit % per_long)) & 1;
+}
+
+
+EvdevKeys::EvdevKeys() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (fs::directory_iterator it("/dev/input", ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string path = it->path().string();
+        if (!it->is_character_file(ec) || it->path().filename().string().rfind("event", 0) != 0) continue;
+
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue;
+        unsigned long key_bits[KEY_MAX / (sizeof(long) * 8) + 1] = {};
+        bool used = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) >= 0 &&
+                    std::any_of(std::begin(USED_KEYS), std::end(USED_KEYS), [&](int key) { return has_bit(key_bits, key); });
+        if (!used) {
+            close(fd);
+            continue;
+        }
+        int clock = CLOCK_MONOTONIC; // event times are CLOCK_REALTIME otherwise
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+        fds.push_back(fd);
+#ifdef DEBUG
+        printf("Found input device: %s\n", path.c_str());
+#endif
+    }
+    if (fds.empty()) printf("No keyboard or buttons found in /dev/input, the slideshow runs without controls\n");
+}
+
+
+EvdevKeys::~EvdevKeys() {
+    for (int fd : fds) close(fd);
+}
+
+
+bool EvdevKeys::read_keys(int fd, std::vector<Press> &presses_out) {
+    input_event events[64];
+    while (true) {
+        const ssize_t len = read(fd, events, sizeof(events));
+        if (len < 0 && errno == EINTR) continue;
+        if (len < 0 && errno == EAGAIN) return true;
+        if (len <= 0) return false; // ENODEV: unplugged
+        for (size_t i = 0; i < len / sizeof(input_event); i++) {
+            const input_event &ev = events[i];
+            if (ev.type != EV_KEY || ev.value != 1) continue; // 0 release, 2 auto repeat
+            if (std::find(std::begin(USED_KEYS), std::end(USED_KEYS), ev.code) == std::end(USED_KEYS)) continue;
+            presses_out.push_back({ ev.code, (int64_t)ev.input_event_sec * 1000000000 + (int64_t)ev.input_event_usec * 1000 });
+        }
+    }
+}
+
+
+void EvdevKeys::close_device(int fd) {
+    const auto it = std::find(fds.begin(), fds.end(), fd);
+    if (it == fds.end()) return;
+    fds.erase(it);
+    close(fd);
+}
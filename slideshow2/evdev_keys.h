@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Key presses from the evdev devices in /dev/input that have any of the keys the slideshow uses: keyboards, and
+// gpio-keys buttons mapped to those keycodes in the device tree. Read without SDL and without a tty: the fds are
+// waited on by the Reactor, read_keys() is called when one is readable. 
+// Devices plugged in later are not picked up.
+class EvdevKeys {
+public:
+    struct Press {
+        int code;           // KEY_LEFT, KEY_RIGHT or KEY_SPACE
+        int64_t time_ns;    // when the kernel got it, CLOCK_MONOTONIC like std::chrono::steady_clock
+    };
+
+    EvdevKeys();
+    ~EvdevKeys();
+    EvdevKeys(const EvdevKeys&) = delete;
+    EvdevKeys& operator=(const EvdevKeys&) = delete;
+
+    const std::vector<int> &get_fds() { return fds; }
+
+    // Appends the presses waiting on fd, auto repeat and releases are skipped. Returns false if the device is gone:
+    // remove fd from the Reactor, then close_device(fd). In that order, once closed the number can be reused.
+    bool read_keys(int fd, std::vector<Press> &presses_out);
+    void close_device(int fd);
+
+private:
+    std::vector<int> fds;
+};
@@ -0,0 +1,155 @@
+#include "file_index.h"
+
+#include <algorithm>
+#include <functional>
+
+
+FileIndex::FileIndex(const std::string &folder) : prefix(folder) {
+    if (prefix.empty() || prefix.back() != '/') prefix += '/';
+}
+
+
+bool FileIndex::strip_prefix(const std::string &path, std::string_view &name_out) const {
+    if (path.size() <= prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+    name_out = std::string_view(path).substr(prefix.size());
+    return true;
+}
+
+
+int FileIndex::find_name(std::string_view name_in) const {
+    if (table.empty()) return -1;
+    const size_t mask = table.size() - 1;
+    for (size_t slot = std::hash<std::string_view>()(name_in) & mask; table[slot]; slot = (slot + 1) & mask) {
+        if (name(table[slot] - 1) == name_in) return table[slot] - 1;
+    }
+    return -1;
+}
+
+
+int FileIndex::find(const std::string &path) const {
+    std::string_view n;
+    return strip_prefix(path, n) ? find_name(n) : -1;
+}
+
+
+int FileIndex::position(const std::string &path, bool &listed) const {
+    std::string_view n;
+    listed = false;
+    if (!strip_prefix(path, n)) return 0; // not from this folder at all, start over from the first file
+
+    const int pos = find_name(n);
+    listed = pos >= 0;
+    if (listed) return pos;
+    auto next = std::lower_bound(offsets.begin(), offsets.end(), n,
+                                 [this](uint32_t offset, std::string_view v) { return std::string_view(pool.data() + offset) < v; });
+    return std::distance(offsets.begin(), next);
+}
+
+
+void FileIndex::assign(const std::vector<std::string> &paths) {
+    std::vector<std::string_view> names;
+    names.reserve(paths.size());
+    for (const auto &path : paths) {
+        std::string_view n;
+        if (strip_prefix(path, n)) names.push_back(n);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::vector<uint8_t> name_flags(names.size(), 0);
+    for (size_t i = 0; i < names.size(); i++) { // files that were listed before keep their flag
+        const int pos = find_name(names[i]);
+        if (pos >= 0) name_flags[i] = flags[pos];
+    }
+    rebuild(names, name_flags);
+}
+
+
+bool FileIndex::update(const std::vector<std::string> &added, const std::vector<std::string> &removed) {
+    std::vector<std::string_view> add, remove;
+    for (const auto &path : added) {
+        std::string_view n;
+        if (strip_prefix(path, n)) add.push_back(n);
+    }
+    for (const auto &path : removed) {
+        std::string_view n;
+        if (strip_prefix(path, n)) remove.push_back(n);
+    }
+    std::sort(add.begin(), add.end());
+    add.erase(std::unique(add.begin(), add.end()), add.end());
+    std::sort(remove.begin(), remove.end());
+
+    // merge the two sorted lists, dropping the removed names
+    std::vector<std::string_view> names;
+    std::vector<uint8_t> name_flags;
+    names.reserve(size() + add.size());
+    name_flags.reserve(size() + add.size());
+    bool changed = false;
+    size_t i = 0, j = 0;
+    while (i < size() || j < add.size()) {
+        if (j == add.size() || (i < size() && name(i) < add[j])) {
+            if (std::binary_search(remove.begin(), remove.end(), name(i))) {
+                changed = true;
+            } else {
+                names.push_back(name(i));
+                name_flags.push_back(flags[i]);
+            }
+            i++;
+        } else if (i < size() && name(i) == add[j]) { // already listed
+            names.push_back(name(i));
+            name_flags.push_back(flags[i]);
+            i++;
+            j++;
+        } else {
+            names.push_back(add[j]);
+            name_flags.push_back(0);
+            changed = true;
+            j++;
+        }
+    }
+
+    if (!changed || names.empty()) return false;
+    rebuild(names, name_flags);
+    return true;
+}
+
+
+// names may point into pool, it is replaced only once everything is copied
+void FileIndex::rebuild(const std::vector<std::string_view> &names, const std::vector<uint8_t> &name_flags) {
+    size_t bytes = 0;
+    for (const auto &n : names) bytes += n.size() + 1;
+
+    std::vector<char> new_pool;
+    std::vector<uint32_t> new_offsets;
+    new_pool.reserve(bytes);
+    new_offsets.reserve(names.size());
+    for (const auto &n : names) {
+        new_offsets.push_back(new_pool.size());
+        new_pool.insert(new_pool.end(), n.begin(), n.end());
+        new_pool.push_back(0);
+    }
+    pool.swap(new_pool);
+    offsets.swap(new_offsets);
+    flags = name_flags;
+    rebuild_table();
+}
+
+
+void FileIndex::rebuild_table() {
+    size_t capacity = 16;
+    while (capacity < 2 * offsets.size()) capacity *= 2;
+    std::vector<uint32_t>(capacity, 0).swap(table);
+
+    const size_t mask = capacity - 1;
+    for (size_t pos = 0; pos < offsets.size(); pos++) {
+        size_t slot = std::hash<std::string_view>()(name(pos)) & mask;
+        while (table[slot]) slot = (slot + 1) & mask;
+        table[slot] = pos + 1;
+    }
+}
+
+
+size_t FileIndex::memory_bytes() const {
+    return sizeof(*this) + prefix.capacity() + pool.capacity() + offsets.capacity() * sizeof(uint32_t) +
+           flags.capacity() + table.capacity() * sizeof(uint32_t);
+}
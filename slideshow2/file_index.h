@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+// The images of one folder, sorted by name. Names live back to back in one pool instead of a std::string each,
+// and a hash table maps them to their position: about 40 bytes per file with the name, so 100k files take 4MB.
+// Not thread safe.
+class FileIndex {
+public:
+    FileIndex(const std::string &folder);
+
+    // Replace the whole list, paths inside the folder
+    void assign(const std::vector<std::string> &paths);
+
+    // Add and remove paths, the order stays sorted by name. Removing every file keeps the list as it was,
+    // an empty slideshow has nothing to show. Returns false if nothing changed.
+    bool update(const std::vector<std::string> &added, const std::vector<std::string> &removed);
+
+    size_t size() const { return offsets.size(); }
+    bool empty() const { return offsets.empty(); }
+
+    std::string path(size_t pos) const { return prefix + (pool.data() + offsets[pos]); }
+
+    // Position of path, -1 if it is not listed. O(1).
+    int find(const std::string &path) const;
+
+    // Position of path if it is listed, otherwise the position of the file that follows it by name, which
+    // can be size(). listed tells which. For a file that was just removed, that is where it was.
+    int position(const std::string &path, bool &listed) const;
+
+    // One flag per file that survives update(), for the loader to remember which sidecars it checked
+    bool checked(size_t pos) const { return flags[pos]; }
+    void set_checked(size_t pos, bool value) { flags[pos] = value; }
+
+    size_t memory_bytes() const;
+
+private:
+    std::string_view name(size_t pos) const { return std::string_view(pool.data() + offsets[pos]); }
+    bool strip_prefix(const std::string &path, std::string_view &name_out) const;
+    int find_name(std::string_view name_in) const;
+    void rebuild(const std::vector<std::string_view> &names, const std::vector<uint8_t> &name_flags);
+    void rebuild_table();
+
+private:
+    std::string prefix;             // folder with a trailing slash
+    std::vector<char> pool;         // names, each followed by a 0
+    std::vector<uint32_t> offsets;  // into pool, by position
+    std::vector<uint8_t> flags;     // by position
+    std::vector<uint32_t> table;    // open addressing, position + 1 or 0 if empty. At most half full.
+};
@@ -0,0 +1,67 @@
+#include "folder_watcher.h"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+
+FolderWatcher::FolderWatcher(const std::string &path) : folder(path) {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) add_watch();
+}
+
+
+FolderWatcher::~FolderWatcher() {
+    if (fd >= 0) close(fd); // removes the watch too
+}
+
+
+bool FolderWatcher::add_watch() {
+    wd = inotify_add_watch(fd, folder.c_str(), WATCH_MASK);
+    return wd >= 0;
+}
+
+
+// A hard link (ln, cp -l) arrives complete and is never written, so IN_CREATE is all there is of it
+bool FolderWatcher::is_hard_link(const char *name) const {
+    struct stat st;
+    return stat((folder + "/" + name).c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink > 1;
+}
+
+
+bool FolderWatcher::read_changes(std::vector<Change> &changes) {
+    if (fd < 0) return false;
+    bool complete = wd >= 0;
+
+    alignas(struct inotify_event) char buf[16384];
+    while (true) {
+        const ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) break; // EAGAIN: nothing more for now
+
+        for (ssize_t pos = 0; pos < len; ) {
+            const struct inotify_event *event = (const struct inotify_event*)(buf + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                complete = false;
+            } else if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
+                if (event->wd == wd) { // the folder itself is gone, a new one may show up under the name
+                    if (event->mask & IN_MOVE_SELF) inotify_rm_watch(fd, wd); // still there, elsewhere
+                    wd = -1;
+                }
+                complete = false;
+            } else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                if ((event->mask & IN_CREATE) && !is_hard_link(event->name)) continue; // complete once closed
+                changes.push_back({ (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) != 0, event->name });
+            }
+        }
+    }
+
+    if (wd < 0) add_watch();
+    return complete;
+}
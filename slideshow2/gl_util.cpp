@@ -90,6 +90,12 @@ static GLuint create_program() {
     return program;
 }
 
+#ifdef USE_RGB565
+    #define TEXTURE_PIXEL_TYPE GL_UNSIGNED_SHORT_5_6_5 // ImageLoader converts every frame to this, at the display size
+#else
+    #define TEXTURE_PIXEL_TYPE GL_UNSIGNED_BYTE
+#endif
+
 static GLuint create_texture(int w, int h) { 
     GLuint tex;
     glGenTextures(1, &tex);
@@ -98,7 +104,7 @@ static GLuint create_texture(int w, int h) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Allocate empty texture initially 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, TEXTURE_PIXEL_TYPE, nullptr);
 
     glBindTexture(GL_TEXTURE_2D, 0);
     return tex;
@@ -138,7 +144,8 @@ GL::GL(DRM &drm, GBM &gbm, EGL &egl) : drm_ref(drm), gbm_ref(gbm), egl_ref(egl)
     uFade = glGetUniformLocation(shaderProgram, "uFade");
     glClear(GL_COLOR_BUFFER_BIT);
 
-    flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_ATOMIC_ALLOW_MODESET;
+    // the flip event makes the DRM fd readable once the frame is on screen, the main loop renders the next one then
+    flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_ATOMIC_ALLOW_MODESET | DRM_MODE_PAGE_FLIP_EVENT;
 }
 
 
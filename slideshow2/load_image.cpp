@@ -3,8 +3,15 @@
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <unordered_map>
+#include <chrono>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <GLES2/gl2.h>
 #include <EGL/egl.h>
@@ -12,9 +19,10 @@
 
 
 bool _init_img_loader();
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height);
+bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int target_w, int target_h, int &width, int &height);
 void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len);
 void _loader_cleanup();
+bool _load_failed_transiently(); // the last _load_image failed for lack of memory, not because of the file
 
 #ifdef USE_STB_IMAGE
     #include <loader_stb.cpp>
@@ -33,26 +41,70 @@ void _loader_cleanup();
     #define LOADER_GL_PIXEL_FORMAT GL_RGB
 #endif
 
+#ifdef USE_RGB565
+    #include "rgb565.h"
+    #define LOADER_GL_PIXEL_TYPE GL_UNSIGNED_SHORT_5_6_5 // every frame is converted after decoding, see convert_to_rgb565
+#else
+    #define LOADER_GL_PIXEL_TYPE GL_UNSIGNED_BYTE
+#endif
+
 
 #ifdef DEBUG
     class ScopedTimer {
     public:
         ScopedTimer(const std::string &name) : _name(name) {
-            start = SDL_GetPerformanceCounter();
+            start = std::chrono::steady_clock::now();
         }
 
         ~ScopedTimer() {
-            end = SDL_GetPerformanceCounter();
-            printf("%s in %fs", _name.c_str(), (end - start) / 1000000000.0f); //nanoseconds to seconds
+            printf("%s in %fs\n", _name.c_str(), std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
         }
 
-        Uint64 start, end;
+        std::chrono::steady_clock::time_point start;
         const std::string _name;
     };
 #endif
 
 
-bool load_image(const std::string& path, GLenum texture_unit) { 
+static void free_decoded(DecodedImage &img) {
+    if (img.rgb565) free(img.pixeldata);
+    else _free_pixeldata(img.pixeldata, img.pixeldata_len);
+    img = DecodedImage();
+}
+
+
+#ifdef USE_RGB565
+// Runs on the worker thread. Resamples the frame to exactly target_w x target_h in RGB565, so it always fits the
+// display sized textures and uploads half the bytes. Bottom-up frames stay bottom-up.
+static bool convert_to_rgb565(DecodedImage &img, int target_w, int target_h) {
+    #ifdef DEBUG
+        ScopedTimer timer("converted to RGB565"); 
+    #endif
+
+    const size_t len = (size_t)target_w * target_h * 2;
+    unsigned char *pixeldata = (unsigned char*)malloc(len);
+    if (!pixeldata) {
+        printf("Out of memory\n");
+        return false;
+    }
+    const int bpp = LOADER_GL_PIXEL_FORMAT == GL_RGBA ? 4 : 3;
+    Rgb565Converter(img.width, img.height, bpp, target_w, target_h).convert(img.pixeldata, (uint16_t*)pixeldata);
+
+    _free_pixeldata(img.pixeldata, img.pixeldata_len);
+    img.pixeldata = pixeldata;
+    img.pixeldata_len = len;
+    img.width = target_w;
+    img.height = target_h;
+    img.rgb565 = true;
+    return true;
+}
+#endif
+
+
+// Runs on the worker thread, no GL calls allowed here.
+// Files that fail to decode are quarantined, and skipped without reading them from then on.
+static bool read_and_decode(const std::string& path, int target_w, int target_h, Quarantine &quarantine, Catalog &catalog, DecodedImage &img) { 
+    if (quarantine.contains(path)) return false;
     std::vector<unsigned char> filebuf;
 
     {
@@ -76,57 +128,184 @@ bool load_image(const std::string& path, GLenum texture_unit) {
         }
     }
 
-    int width = 0, height = 0;
-    unsigned char* pixeldata = nullptr;
-    size_t pixeldata_len = 0;    
-
+    const auto start = std::chrono::steady_clock::now();
     {
         #ifdef DEBUG
             ScopedTimer timer("decoded image"); 
         #endif
 
-        if (!_load_image(pixeldata, pixeldata_len, filebuf, path, width, height)) {
-            _free_pixeldata(pixeldata, pixeldata_len);
+        // the headers are read first, a file that is not a jpg or was cut short in them fails before any decoding
+        if (!_load_image(img.pixeldata, img.pixeldata_len, filebuf, path, target_w, target_h, img.width, img.height)) {
+            _free_pixeldata(img.pixeldata, img.pixeldata_len);
+            img = DecodedImage();
+            if (_load_failed_transiently()) printf("Could not decode %s for now, trying it again later\n", path.c_str());
+            else quarantine.add(path);
             return false;
         }
     }
 
-    {
-        #ifdef DEBUG
-            ScopedTimer timer("uploaded to GPU"); 
-        #endif
-        
-        if (!pixeldata || width <= 0 || height <= 0) {
-            printf("Invalid decoded data for GL upload ptr:%d w:%d h:%d", pixeldata, width, height);
-            return false;
-        }
-
-        glActiveTexture(texture_unit); // bind texture unit, texture is already bound inside it
-        //glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // avoid padding issues
-        glTexImage2D(GL_TEXTURE_2D, 0, LOADER_GL_PIXEL_FORMAT, width, height, 0, LOADER_GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, pixeldata); //glTexSubImage2D does not work on RPi
+    if (!img.pixeldata || img.width <= 0 || img.height <= 0) {
+        printf("Invalid decoded data for GL upload ptr:%p w:%d h:%d", img.pixeldata, img.width, img.height);
+        _free_pixeldata(img.pixeldata, img.pixeldata_len);
+        img = DecodedImage();
+        quarantine.add(path);
+        return false;
+    }
 
-        _free_pixeldata(pixeldata, pixeldata_len);
+#ifdef USE_RGB565
+    if (!convert_to_rgb565(img, target_w, target_h)) {
+        free_decoded(img);
+        return false;
     }
+#endif
 
+    img.path = path;
+    const auto decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    catalog.describe(path, filebuf.data(), filebuf.size(), decode_us);
     return true;
 }
 
 
+// The image on screen before the last restart, empty if unknown
+static std::string read_last_shown(const std::string &file) {
+    if (file.empty()) return "";
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return "";
+    char buf[4096];
+    ssize_t len = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+    if (len <= 0) return "";
+    std::string path(buf, len);
+    size_t end = path.find('\n');
+    return end == std::string::npos ? "" : path.substr(0, end); // no newline: cut short by a power loss
+}
+
+
+// Overwritten in place, not replaced: only creating it changes the mtime of the folder, which the catalog is told about
+static void write_last_shown(const std::string &file, const std::string &path, Catalog &catalog) {
+    if (file.empty() || path.empty()) return;
+    int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        const int64_t before = catalog.before_own_write();
+        fd = open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        catalog.after_own_write(before);
+    }
+    if (fd < 0) return;
+    const std::string line = path + "\n";
+    if (pwrite(fd, line.data(), line.size(), 0) == (ssize_t)line.size()) {
+        if (ftruncate(fd, line.size()) != 0) printf("Cannot truncate %s: %s\n", file.c_str(), strerror(errno));
+    }
+    close(fd);
+}
+
+
+// Runs on the GL thread
+static void upload_image(const DecodedImage &img, GLenum texture_unit) {
+    #ifdef DEBUG
+        ScopedTimer timer("uploaded to GPU"); 
+    #endif
 
-ImageLoader::ImageLoader(const std::string& path) : folder_path(path) { 
+    glActiveTexture(texture_unit); // bind texture unit, texture is already bound inside it
+    //glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // avoid padding issues
+    glTexImage2D(GL_TEXTURE_2D, 0, LOADER_GL_PIXEL_FORMAT, img.width, img.height, 0, LOADER_GL_PIXEL_FORMAT, LOADER_GL_PIXEL_TYPE, img.pixeldata); //glTexSubImage2D does not work on RPi
+}
+
+
+
+ImageLoader::ImageLoader(const std::string& path, int display_width, int display_height, const std::string &quarantine_file, const std::string &catalog_file, const std::string &state_file_path) : 
+    folder_path(path), display_w(display_width), display_h(display_height), img_files(path), watcher(path), catalog(catalog_file, path), quarantine(quarantine_file, catalog), state_file(state_file_path) { 
     init_success = true;
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
     if (!_init_img_loader()) { init_success = false; return; }
-    if (!load_file_list()) { init_success = false; return; }
-    if (!load_image(img_files[0], GL_TEXTURE0)) { init_success = false; return; }
+
+    // first image is loaded synchronously, there is nothing to show in the meantime anyway. Broken files are skipped.
+    // The one shown last before a restart comes first, then the list of the catalog, and only then the folder is
+    // listed: the first image that loads is shown. Unless the catalog was listed already, the rest of the list
+    // comes from it or from a scan of the folder in the background.
+    DecodedImage img;
+    const std::filesystem::path last_shown = read_last_shown(state_file);
+    const bool in_folder = !last_shown.empty() && last_shown.parent_path() / "" == std::filesystem::path(folder_path) / "";
+    bool loaded = in_folder && last_shown.extension() == ".jpg" && read_and_decode(last_shown.string(), display_w, display_h, quarantine, catalog, img);
+    if (loaded) first_image_source = "last shown";
+
+    std::vector<std::string> listed;
+    const bool from_catalog = !loaded && list_from_catalog(listed);
+    if (from_catalog) apply_file_list(listed);
+    for (size_t i = 0; from_catalog && !loaded && i < img_files.size(); i++) {
+        loaded = read_and_decode(img_files.path(i), display_w, display_h, quarantine, catalog, img);
+        if (loaded) first_image_source = "catalog";
+    }
+    if (!from_catalog && !loaded) {
+        loaded = find_first_image(img);
+        if (loaded) first_image_source = "first found";
+    }
+    if (!from_catalog && loaded) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            img_files.assign({ img.path });
+            resize_order();
+        }
+        scanner = std::thread(&ImageLoader::scan_in_background, this);
+    }
+    if (!loaded) {
+        printf("No image in %s could be loaded\n", folder_path.c_str());
+        init_success = false;
+        return;
+    }
+    upload_image(img, GL_TEXTURE0);
+    tex_loaded_filenames[0] = img.path;
+    free_decoded(img);
+
+    worker = std::thread(&ImageLoader::worker_loop, this);
+}
+
+ImageLoader::~ImageLoader() { 
+    if (scanner.joinable()) scanner.join();
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop_worker = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+    free_decoded(result);
+    _loader_cleanup(); 
+    if (event_fd >= 0) close(event_fd);
+}
+
+
+// Any thread: wakes the main loop, see get_event_fd
+void ImageLoader::signal_event() {
+    const uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0) {} // already readable if the counter is full
 }
 
-ImageLoader::~ImageLoader() { _loader_cleanup(); }
+
+// The list of the last run, if nothing was added to or removed from the folder since: no scan at all. Any thread.
+bool ImageLoader::list_from_catalog(std::vector<std::string> &paths_out) {
+    std::vector<std::string> paths;
+    if (!catalog.list(paths) || paths.empty()) return false;
+#ifdef DEBUG
+    printf("%zu files from the catalog, the folder did not change\n", paths.size());
+#endif
+    paths_out.swap(paths);
+    return true;
+}
 
 
 bool ImageLoader::load_file_list() {
-    namespace fs = std::filesystem;
     std::vector<std::string> imgs_found;
+    if (!scan_folder(imgs_found)) return false;
+    apply_file_list(imgs_found);
+    return true;
+}
+
+
+// Any thread, touches nothing but the folder
+bool ImageLoader::scan_folder(std::vector<std::string> &imgs_found) {
+    namespace fs = std::filesystem;
     try {
         if (fs::exists(folder_path) && fs::is_directory(folder_path)) {
             for (const auto& entry : fs::directory_iterator(folder_path)) {
@@ -149,61 +328,246 @@ bool ImageLoader::load_file_list() {
         printf("No files found in %s", folder_path.c_str());
         return false;
     }
+    return true;
+}
 
-    img_files = imgs_found;
+
+void ImageLoader::apply_file_list(const std::vector<std::string> &imgs_found) {
+    {
+        std::lock_guard<std::mutex> lock(mutex); // the worker may be walking the list right now
+        img_files.assign(imgs_found);
+        resize_order();
+    }
+    catalog.set_files(imgs_found);
+#ifdef DEBUG
+    printf("%zu files, the index takes %zu bytes\n", img_files.size(), img_files.memory_bytes());
+#endif
     //NOTE: back_texture_file_idx is now in an invalid state. but since it is read only at FADE_DONE, and 
     // FADE_DONE also invalidates new_image_loaded_since_fade, a new back_texture_file_idx will get assigned anyway.
+}
+
+
+// Startup without a catalog: the first jpg of the folder that loads, without listing the rest of it first
+bool ImageLoader::find_first_image(DecodedImage &img) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (fs::directory_iterator it(folder_path, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec) || it->path().extension() != ".jpg") continue;
+        if (read_and_decode(it->path().string(), display_w, display_h, quarantine, catalog, img)) return true;
+    }
+    return false;
+}
+
+
+// Runs on the scanner thread, finish_scan applies the result on the GL thread
+void ImageLoader::scan_in_background() {
+    std::vector<std::string> imgs_found;
+    const bool ok = list_from_catalog(imgs_found) || scan_folder(imgs_found);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scan_result = std::move(imgs_found);
+        scan_ok = ok;
+    }
+    scan_done = true;
+    signal_event();
+}
+
+
+// GL thread. Until the scan is done the list only holds the first image, folder changes wait in the watcher's queue.
+void ImageLoader::finish_scan() {
+    scanner.join();
+    scan_done = false;
+    std::vector<std::string> imgs_found;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        imgs_found = std::move(scan_result);
+        ok = scan_ok;
+    }
+    if (ok) apply_file_list(imgs_found);
+    printf("Listed %s in the background: %zu files\n", folder_path.c_str(), img_files.size());
+}
+
+
+// O(changes) instead of a walk over the whole folder
+bool ImageLoader::update_file_list() {
+    if (scan_done) finish_scan();
+    if (scanner.joinable()) return true; // still scanning, the changes are applied once it is done
+
+    std::vector<FolderWatcher::Change> changes;
+    if (!watcher.read_changes(changes)) return load_file_list(); // inotify queue overflow, or the folder was replaced
+
+    namespace fs = std::filesystem;
+    std::unordered_map<std::string, bool> updates; // path, added: the last change to a file counts
+    for (const auto &change : changes) {
+        const fs::path path = fs::path(folder_path) / change.name;
+        if (path.extension() == ".jpg") updates[path.string()] = change.added;
+    }
+    if (updates.empty()) return true;
+
+    std::vector<std::string> added, removed;
+    for (const auto &update : updates) (update.second ? added : removed).push_back(update.first);
+    std::lock_guard<std::mutex> lock(mutex); // the worker may be walking the list right now
+    if (!img_files.update(added, removed)) return true; // never empties the list, like load_file_list
+    resize_order();
+    catalog.update_files(added, removed);
     return true;
 }
 
 
-int ImageLoader::get_file_idx(const std::string &path) {
-    auto pos = std::find(img_files.begin(), img_files.end(), path);
-    return pos != img_files.end() ? std::distance(img_files.begin(), pos) : 0;
+// Index (see file_at) of the file step files after path (before it if negative). If path was removed meanwhile, its
+// neighbors are the ones next to the file that followed it by name.
+int ImageLoader::neighbor_idx(const std::string &path, int step) {
+    bool listed;
+    const int pos = img_files.position(path, listed);
+    const int idx = shuffle ? order_idx(pos % img_files.size()) : pos;
+    return listed || step < 0 ? idx + step : idx + step - 1;
+}
+
+
+// The file at idx of the order images are shown in, wrapping around: the file list itself, or shuffle_order over it.
+// The GL thread, or mutex must be held.
+std::string ImageLoader::file_at(int idx) {
+    const int n = img_files.size();
+    const int i = (idx % n + n) % n;
+    return img_files.path(shuffle ? shuffle_order.position(i) : i);
 }
 
 
-bool ImageLoader::load_image_to_back_texture(int file_idx) {
-    std::string path = img_files[file_idx];
+// Back from a position in img_files to an index of file_at
+int ImageLoader::order_idx(int pos) {
+    return shuffle ? shuffle_order.step(pos) : pos;
+}
+
 
-    bool success = load_image(path, current_active_texture == 1 ? GL_TEXTURE0 : GL_TEXTURE1);
-    if (success) {
-        tex_loaded_filenames[!current_active_texture] = path;
-        new_image_loaded = true;
+// GL thread with mutex held, after img_files changed
+void ImageLoader::resize_order() {
+    if (shuffle_order.size() != img_files.size()) shuffle_order.set_size(img_files.size());
+}
+
+
+void ImageLoader::set_shuffle(uint64_t seed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shuffle = true;
+    shuffle_order = ShuffleOrder(seed);
+    shuffle_order.set_size(img_files.size());
+}
+
+
+// GL thread. Small libraries go round in fewer steps than this remembers, nothing counts as recent there.
+bool ImageLoader::shown_recently(const std::string &path) {
+    if (img_files.size() <= 2 * SHUFFLE_RECENT) return false;
+    const size_t name_hash = std::hash<std::string>()(path);
+    return std::find(std::begin(recent_shown), std::end(recent_shown), name_hash) != std::end(recent_shown);
+}
+
+
+void ImageLoader::request_load(int start_idx, int step) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request.start_idx = start_idx;
+        request.step = step;
+        request.generation++; // supersedes whatever the worker is doing
+    }
+    request_pending = true;
+    new_image_loaded = false; // back texture is going to be overwritten
+    cv.notify_one();
+}
+
+
+void ImageLoader::load_next_image(bool skip_recent) { //search forwards until an image can be loaded
+    int idx = neighbor_idx(tex_loaded_filenames[current_active_texture], 1);
+    for (int skipped = 0; shuffle && skip_recent && skipped < SHUFFLE_RECENT; skipped++) {
+        if (!shown_recently(file_at(idx))) break;
+        idx++;
     }
-    return success;
+    request_load(idx, 1);
+}
+
+
+void ImageLoader::load_prev_image() { //search backwards until an image can be loaded
+    request_load(neighbor_idx(tex_loaded_filenames[current_active_texture], -1), -1);
 }
 
 
-bool ImageLoader::load_next_image() { //search forwards until an image can be loaded
-    int curr_file_idx = get_file_idx(tex_loaded_filenames[current_active_texture]);
+void ImageLoader::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
 
-    bool success = false;
-    int attempts = 0;
-    while (!success && attempts < img_files.size()) {
-        success = load_image_to_back_texture((curr_file_idx+1+attempts)%img_files.size());
-        attempts++;
+    while (true) {
+        cv.wait(lock, [this] { return stop_worker || request.generation != served_generation; });
+        if (stop_worker) break;
+
+        const LoadRequest req = request;
+        const int num_files = img_files.size();
+
+        DecodedImage img;
+        bool success = false;
+        bool superseded = false;
+        for (int attempts = 0; attempts < num_files && !success; attempts++) {
+            if (stop_worker || request.generation != req.generation) { superseded = true; break; }
+            if (img_files.empty()) break;
+
+            std::string path = file_at(req.start_idx + req.step*attempts);
+
+            lock.unlock(); // decode without holding the lock, the GL thread must never wait for us
+            success = read_and_decode(path, display_w, display_h, quarantine, catalog, img);
+            lock.lock();
+        }
+
+        served_generation = req.generation;
+        if (superseded || request.generation != req.generation) { 
+            free_decoded(img); // nobody wants this image anymore
+            continue;
+        }
+
+        free_decoded(result); // never consumed, drop it
+        result = img;
+        result_generation = req.generation;
+        result_success = success;
+        result_ready = true;
+        signal_event();
     }
-    
-    return success;
 }
 
 
-bool ImageLoader::load_prev_image() { //search backwards until an image can be loaded
-    int curr_file_idx = get_file_idx(tex_loaded_filenames[current_active_texture]);
+bool ImageLoader::update() {
+    uint64_t events;
+    if (read(event_fd, &events, sizeof(events)) < 0) {} // nothing was signaled
+    if (scan_done) finish_scan();
+    DecodedImage img;
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!result_ready) return true;
+
+        img = result;
+        success = result_success;
+        result = DecodedImage();
+        result_ready = false;
 
-    bool success = false;
-    int attempts = 0;
-    while (!success && attempts < img_files.size()) {
-        success = load_image_to_back_texture((curr_file_idx+img_files.size()-1-attempts)%img_files.size());
-        attempts++;
+        if (result_generation != request.generation) { // a newer request is already queued
+            free_decoded(img);
+            return true;
+        }
     }
-    
-    return success;
+    request_pending = false;
+
+    if (!success) return false;
+
+    upload_image(img, current_active_texture == 1 ? GL_TEXTURE0 : GL_TEXTURE1);
+    tex_loaded_filenames[!current_active_texture] = img.path;
+    new_image_loaded = true;
+    free_decoded(img);
+    return true;
 }
 
 
 void ImageLoader::switch_active_texture() {
     current_active_texture = !current_active_texture;
     new_image_loaded = false;
-}
\ No newline at end of file
+    write_last_shown(state_file, tex_loaded_filenames[current_active_texture], catalog);
+    if (shuffle) {
+        recent_shown[recent_next] = std::hash<std::string>()(tex_loaded_filenames[current_active_texture]);
+        recent_next = (recent_next + 1) % SHUFFLE_RECENT;
+    }
+}
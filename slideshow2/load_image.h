@@ -1,35 +1,133 @@
 #pragma once
 
+#include "quarantine.h"
+#include "folder_watcher.h"
+#include "file_index.h"
+#include "catalog.h"
+#include "shuffle.h"
+
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+
+struct DecodedImage {
+    unsigned char *pixeldata = nullptr;
+    size_t pixeldata_len = 0;
+    int width = 0, height = 0;
+    bool rgb565 = false; // converted by the loader (USE_RGB565), pixeldata is its own malloc'd buffer
+    std::string path;
+};
 
 
 class ImageLoader {
 public:
-    ImageLoader(const std::string& path);
+    // images are decoded at the smallest size that still covers display_width x display_height, if the loader can scale
+    // files that fail to decode are listed in quarantine_file and skipped until they change, see Quarantine
+    // catalog_file keeps the file list and what is known about each image across restarts, see Catalog
+    // state_file remembers the image on screen, it is shown first on the next start
+    ImageLoader(const std::string& path, int display_width, int display_height, const std::string &quarantine_file, const std::string &catalog_file, const std::string &state_file);
     ~ImageLoader();
     bool init_is_successful() { return init_success; }
+    // where the first image came from: "last shown", "catalog" or "first found"
+    const char *get_first_image_source() { return first_image_source; }
 
+    // Scan the whole folder. Keeps the previous list if the folder cannot be read or has no images.
     bool load_file_list();
+    // Apply the files that arrived in or left the folder since the last call, see FolderWatcher.
+    // Only scans the folder again if the watcher lost track of it.
+    bool update_file_list();
 
-    bool load_next_image();
-    bool load_prev_image();
+    // Go through the images in a pseudo-random order instead of by name, see ShuffleOrder. The same seed gives the
+    // same order, as long as the number of images stays the same.
+    void set_shuffle(uint64_t seed);
+
+    // Queue a decode on the worker thread, the result is uploaded by update()
+    // skip_recent: in shuffle mode, skip images shown lately (the automatic next image, not the arrow keys)
+    void load_next_image(bool skip_recent = true);
+    void load_prev_image();
+    bool load_in_progress() { return request_pending; }
     bool new_image_has_been_loaded() { return new_image_loaded; }
 
+    // Call from the GL thread. Uploads a decoded image to the back texture once the worker is done with it.
+    // Returns false if no image in the folder could be loaded, the request is over then and the textures are untouched.
+    bool update();
+    // eventfd that becomes readable when update() has something to do: a decoded image, or the background scan is
+    // done. update() resets it. The main loop sleeps on it instead of polling.
+    int get_event_fd() { return event_fd; }
+
     void switch_active_texture();
     float correct_fade_direction(float fade) { return current_active_texture ? (1 - fade) : fade; }
 
 private:
-    int get_file_idx(const std::string &path);
-    bool load_image_to_back_texture(int file_idx);
+    bool list_from_catalog(std::vector<std::string> &paths_out);
+    bool scan_folder(std::vector<std::string> &imgs_found);
+    void apply_file_list(const std::vector<std::string> &imgs_found);
+    bool find_first_image(DecodedImage &img);
+    void scan_in_background();
+    void finish_scan();
+    int neighbor_idx(const std::string &path, int step);
+    std::string file_at(int idx);
+    int order_idx(int pos);
+    void resize_order();
+    bool shown_recently(const std::string &path);
+    void request_load(int start_idx, int step);
+    void worker_loop();
+    void signal_event();
 
 private:
     bool init_success;
     const std::string folder_path;
-    std::vector<std::string> img_files;
+    const int display_w, display_h;
+    FileIndex img_files;                // written only by the GL thread, read by the worker under mutex
+    FolderWatcher watcher;              // started before the first scan
+    bool shuffle = false;               // indexes of requests go through shuffle_order
+    ShuffleOrder shuffle_order;         // written only by the GL thread, read by the worker under mutex
 
     bool current_active_texture = 0; // 0 = tex0, 1 = tex1
     std::string tex_loaded_filenames[2]; //currently loaded filename for tex0 and tex1
 
+    // hashes of the last paths shown in shuffle mode, the next image skips them. Within one order that never happens,
+    // but the order is another one when the library grows or shrinks.
+    static constexpr int SHUFFLE_RECENT = 64;
+    size_t recent_shown[SHUFFLE_RECENT] = {};
+    int recent_next = 0;
+
     bool new_image_loaded = false;
-};
\ No newline at end of file
+    bool request_pending = false;
+
+    Catalog catalog;       // thread safe, the worker describes images
+    Quarantine quarantine; // thread safe, the worker adds to it. After catalog, it keeps it up to date.
+    const std::string state_file; // written by the GL thread whenever an image comes on screen
+    const char *first_image_source = "";
+    int event_fd = -1;
+
+    std::thread scanner;                // lists the folder once the first image is up, from the catalog or a scan
+    std::atomic<bool> scan_done{false}; // the GL thread picks scan_result up in finish_scan
+    std::vector<std::string> scan_result;
+    bool scan_ok = false;
+
+    // worker thread handoff, everything below is protected by mutex
+    struct LoadRequest {
+        int start_idx = 0;
+        int step = 1; // +1 searches forwards, -1 backwards
+        unsigned int generation = 0;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop_worker = false;
+
+    LoadRequest request;
+    unsigned int served_generation = 0;
+
+    DecodedImage result;
+    unsigned int result_generation = 0;
+    bool result_ready = false;
+    bool result_success = false;
+};
@@ -9,6 +9,7 @@
 #define LOADER_GL_PIXEL_FORMAT GL_RGB
 
 static tjhandle g_tj;
+static bool g_out_of_memory = false; // set by the last _load_image
 
 
 bool _init_img_loader() {
@@ -17,17 +18,32 @@ bool _init_img_loader() {
 }
 
 
-bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int &width, int &height) {
+bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const std::vector<unsigned char> &filebuf_in, const std::string &path_in, int target_w, int target_h, int &width, int &height) {
     int subsamp, colorspace;
+    g_out_of_memory = false;
     if (tjDecompressHeader3(g_tj, filebuf_in.data(), filebuf_in.size(),
                             &width, &height, &subsamp, &colorspace) != 0) {
         printf("TurboJPEG header read failed: %s", tjGetErrorStr());
         return false;
     }
 
-    pixeldata_out = (unsigned char*)malloc(width*height*3*sizeof(unsigned char));
+    // let the IDCT do the downscaling: pick the smallest factor that still covers the display
+    if (target_w > 0 && target_h > 0) {
+        int num_factors;
+        tjscalingfactor *factors = tjGetScalingFactors(&num_factors);
+        int best_w = width, best_h = height;
+        for (int i = 0; factors && i < num_factors; i++) {
+            int w = TJSCALED(width, factors[i]), h = TJSCALED(height, factors[i]);
+            if (w >= target_w && h >= target_h && w < best_w) { best_w = w; best_h = h; }
+        }
+        width = best_w; height = best_h;
+    }
+
+    pixeldata_len_out = width*height*3*sizeof(unsigned char);
+    pixeldata_out = (unsigned char*)malloc(pixeldata_len_out);
     if (!pixeldata_out) {
         printf("Out of memory");
+        g_out_of_memory = true;
         return false;
     }
 
@@ -36,6 +52,7 @@ bool _load_image(unsigned char *&pixeldata_out, size_t &pixeldata_len_out, const
                     TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE | TJFLAG_BOTTOMUP) != 0) {
         printf("TurboJPEG decompress failed: %s", tjGetErrorStr());
         free(pixeldata_out);
+        pixeldata_out = nullptr; // the caller frees it again otherwise
         return false;
     }
 
@@ -47,4 +64,6 @@ void _free_pixeldata(unsigned char *pixeldata, size_t pixeldata_len) {
         free(pixeldata);
 }
 
-void _loader_cleanup() {}
\ No newline at end of file
+void _loader_cleanup() {}
+
+bool _load_failed_transiently() { return g_out_of_memory; }
\ No newline at end of file
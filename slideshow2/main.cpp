@@ -4,6 +4,8 @@
 #include "drm_util.h"
 #include "gbm_util.h"
 #include "egl_util.h"
+#include "reactor.h"
+#include "evdev_keys.h"
 
 #include <math.h>
 #include <string>
@@ -13,11 +15,19 @@
 #include <thread>
 #include <cassert>
 #include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
 
 #define DEFAULT_IMG_DISPLAY_TIME 5.0f 
 #define DEFAULT_IMG_FADE_TIME 0.5f
 #define DEFAULT_IMG_FOLDER_PATH "/tmp"
 #define DEFAULT_GPIO_LINE 23  // GPIO23
+#define DEFAULT_IMG_QUARANTINE_FILE ".quarantine" // inside IMG_FOLDER_PATH, lists the files that failed to decode
+#define DEFAULT_IMG_CATALOG_FILE ".catalog" // inside IMG_FOLDER_PATH, the file list and image metadata of the last run
+#define DEFAULT_IMG_SHUFFLE 0 // 1 shows the images in a pseudo-random order instead of by name
+#define DEFAULT_IMG_SHUFFLE_SEED_FILE ".shuffle_seed" // inside IMG_FOLDER_PATH, keeps the order across restarts
+#define DEFAULT_IMG_STATE_FILE ".last_shown" // inside IMG_FOLDER_PATH, the image on screen, shown first after a restart
 
 std::atomic<bool> stop_requested(false);
 using my_clock = std::chrono::high_resolution_clock;
@@ -30,12 +40,33 @@ void signal_handler(int signal) {
 
 
 
+static float ms_between(my_clock::time_point from, my_clock::time_point to) {
+    return std::chrono::duration<float, std::milli>(to - from).count();
+}
+
+
+// same clock as the timestamps of input and page flip events
+static int64_t monotonic_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+// ms until deadline_s, rounded up so the wait does not end just before it
+static int ms_until(float now_s, float deadline_s) {
+    return (int)ceilf((deadline_s - now_s) * 1000.0f);
+}
+
+
 int main(int, char**)
 {
+    const auto start_time = my_clock::now();
     enum State { DISPLAY, FADING };
     State curr_state = DISPLAY;
     float curr_state_time_spent = 0.0f;
     bool paused = false;
+    int navigation_dir = 0; // user asked for another image (-1 prev, 1 next), jump to it as soon as it is uploaded
 
     std::signal(SIGINT, signal_handler);
 
@@ -51,19 +82,74 @@ int main(int, char**)
     const char* env_led = getenv("LED_PAUSE_INDICATOR_GPIO");
     unsigned int led_pin = env_led != nullptr ? (unsigned int)std::stoul(env_led) : DEFAULT_GPIO_LINE;
 
+    const char* env_quarantine_path = getenv("IMG_QUARANTINE_PATH"); // empty: the list is not kept across restarts
+    const std::string quarantine_path = env_quarantine_path != nullptr ? env_quarantine_path : folder_path + "/" + DEFAULT_IMG_QUARANTINE_FILE;
+
+    const char* env_catalog_path = getenv("IMG_CATALOG_PATH"); // empty: the folder is scanned on every start
+    const std::string catalog_path = env_catalog_path != nullptr ? env_catalog_path : folder_path + "/" + DEFAULT_IMG_CATALOG_FILE;
+
+    const char* env_shuffle = getenv("IMG_SHUFFLE");
+    const bool shuffle = (env_shuffle != nullptr ? std::stoi(env_shuffle) : DEFAULT_IMG_SHUFFLE) != 0;
+    const char* env_shuffle_seed_path = getenv("IMG_SHUFFLE_SEED_PATH"); // empty: a new order on every start
+    const std::string shuffle_seed_path = env_shuffle_seed_path != nullptr ? env_shuffle_seed_path : folder_path + "/" + DEFAULT_IMG_SHUFFLE_SEED_FILE;
+
+    const char* env_state_path = getenv("IMG_STATE_PATH"); // empty: every start begins with the first image
+    const std::string state_path = env_state_path != nullptr ? env_state_path : folder_path + "/" + DEFAULT_IMG_STATE_FILE;
 
     DRM drm;
 	GBM gbm(drm);
 	EGL egl(gbm);
     GL gl(drm, gbm, egl);
+    const auto display_time = my_clock::now();
 
-    ImageLoader my_loader(folder_path);
+    // before the loader: a new seed file changes the folder, so it is in the mtime the catalog stores at this start
+    const uint64_t shuffle_seed = shuffle ? load_shuffle_seed(shuffle_seed_path) : 0;
+    ImageLoader my_loader(folder_path, gbm.width, gbm.height, quarantine_path, catalog_path, state_path);
     if (!my_loader.init_is_successful()) return 1;
+    const auto loader_time = my_clock::now();
+    if (shuffle) my_loader.set_shuffle(shuffle_seed);
 
     gl.render(0.0f);
 
+    // time to first frame, logged on every start: the figure to watch when startup gets slower
+    const auto first_frame_time = my_clock::now();
+    timespec boot_time;
+    clock_gettime(CLOCK_BOOTTIME, &boot_time);
+    printf("First image on screen after %.0f ms (display %.0f ms, loader %.0f ms, %s), %.1f s after boot\n",
+           ms_between(start_time, first_frame_time), ms_between(start_time, display_time), ms_between(display_time, loader_time),
+           my_loader.get_first_image_source(), boot_time.tv_sec + boot_time.tv_nsec / 1e9);
+
+    // everything the main loop waits for: keys, page flips, decoded images and the display timer
+    Reactor reactor;
+    EvdevKeys keys;
+    std::vector<EvdevKeys::Press> presses; // filled by the handlers during reactor.wait()
+#ifdef DEBUG
+    int64_t key_time_ns = 0;     // last navigation keypress, to time it until the image is on screen
+    int64_t key_handled_ns = 0;  // from the keypress until the main loop requested the image
+    int64_t key_shown_ns = 0;    // keypress of the frame that is waiting for its page flip
+#endif
+    for (int fd : keys.get_fds()) {
+        reactor.add(fd, [&, fd] {
+            if (keys.read_keys(fd, presses)) return;
+            reactor.remove(fd); // before the close, the fd number may be reused right after it
+            keys.close_device(fd);
+        });
+    }
+    reactor.add(drm.fd, [&] {
+        drm.handle_events();
+#ifdef DEBUG
+        if (key_shown_ns && !drm.flip_pending) {
+            printf("keypress to image on screen in %.1fms (handled after %.2fms)\n", (drm.last_flip_ns - key_shown_ns) / 1e6f, key_handled_ns / 1e6f);
+            key_shown_ns = 0;
+        }
+#endif
+    });
+    reactor.add(my_loader.get_event_fd(), [&] { 
+        uint64_t events; 
+        if (read(my_loader.get_event_fd(), &events, sizeof(events)) < 0) {} // update() checks what it was for
+    });
+
     auto prevTime = my_clock::now();    
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
     while (!stop_requested) // Main loop
     {
@@ -72,26 +158,83 @@ int main(int, char**)
         float ts = delta.count();
         prevTime = crntTime;
 
+        for (const auto &press : presses) {
+            switch (press.code)
+            {
+            case KEY_SPACE:
+                paused = !paused;
+                break;
+
+            case KEY_LEFT:
+                if (curr_state == FADING || navigation_dir == -1) break;
+                my_loader.load_prev_image();
+                navigation_dir = -1;
+#ifdef DEBUG
+                key_time_ns = press.time_ns;
+                key_handled_ns = monotonic_ns() - press.time_ns;
+#endif
+                break;
+
+            case KEY_RIGHT:
+                if (curr_state == FADING || navigation_dir == 1) break;
+                //maybe the next image has already been loaded automatically, or is being loaded. skip load then.
+                if (navigation_dir == -1 || (!my_loader.new_image_has_been_loaded() && !my_loader.load_in_progress())) {
+                    my_loader.load_next_image(false);
+                }
+                navigation_dir = 1;
+#ifdef DEBUG
+                key_time_ns = press.time_ns;
+                key_handled_ns = monotonic_ns() - press.time_ns;
+#endif
+                break;
+            }
+        }
+        presses.clear();
+
         switch (curr_state)
         {
         case DISPLAY:
+            if (!my_loader.update()) { // upload happens here and only here, never while fading
+                //nothing else could be loaded: keep showing this image, try again after another display time
+                navigation_dir = 0;
+                curr_state_time_spent = 0;
+            }
+
+            if (navigation_dir != 0 && my_loader.new_image_has_been_loaded()) {
+                navigation_dir = 0;
+                curr_state_time_spent = img_fade_time_s; //jump directly to next image, don't fade
+                curr_state = FADING;
+                break;
+            }
+
             if (!paused) {
                 curr_state_time_spent += ts;
-                if (curr_state_time_spent > img_display_time_s) {
+                if (curr_state_time_spent > img_display_time_s && my_loader.new_image_has_been_loaded()) {
                     curr_state_time_spent = 0;
                     curr_state = FADING;
                     break;
                 }
-                else if (!my_loader.new_image_has_been_loaded() && curr_state_time_spent > img_display_time_s / 2) {
-                    if(!my_loader.load_next_image()) return 1;
+                else if (!my_loader.new_image_has_been_loaded() && !my_loader.load_in_progress() && curr_state_time_spent > img_display_time_s / 2) {
+                    my_loader.load_next_image();
                 }
             }
-            //slow down but allow polling for events every 100ms
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            //sleep until a key is pressed, an image is decoded or the next step of this state is due
+            {
+                int timeout_ms = -1; // paused, or the loader wakes us
+                if (!paused && curr_state_time_spent < img_display_time_s / 2) timeout_ms = ms_until(curr_state_time_spent, img_display_time_s / 2);
+                else if (!paused && curr_state_time_spent <= img_display_time_s) timeout_ms = ms_until(curr_state_time_spent, img_display_time_s);
+                reactor.set_timer(timeout_ms);
+                reactor.wait(); // EINTR: a signal, stop_requested is checked next
+            }
             break;
 
         case FADING: 
             curr_state_time_spent += ts; 
+            if (drm.flip_pending) { // one frame per vblank, the page flip event wakes us for the next
+                reactor.set_timer(-1);
+                reactor.wait();
+                break;
+            }
             float image_fade_value = curr_state_time_spent / img_fade_time_s;
             bool done_fading = false;
             if (image_fade_value >= 1.0f) { 
@@ -103,7 +246,11 @@ int main(int, char**)
 
             if (done_fading) {
                 my_loader.switch_active_texture();
-                if (!my_loader.load_file_list()) return 1;
+#ifdef DEBUG
+                key_shown_ns = key_time_ns; // logged at its page flip
+                key_time_ns = 0;
+#endif
+                my_loader.update_file_list(); //only what changed since the last fade, keeps the previous list if the folder cannot be read right now
                 curr_state_time_spent = 0;
                 curr_state = DISPLAY;
             }
@@ -0,0 +1,98 @@
+#include "quarantine.h"
+
+#include <cstdio>
+#include <cinttypes>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static int64_t to_ns(const struct timespec &ts) { return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec; }
+
+
+Quarantine::Quarantine(const std::string &path, Catalog &folder_catalog) : file(path), catalog(folder_catalog) {
+    if (file.empty()) return;
+    FILE *f = fopen(file.c_str(), "r");
+    if (!f) return; // nothing failed yet
+
+    char line[4096];
+    bool changed = false;
+    while (fgets(line, sizeof(line), f)) {
+        Entry entry, now;
+        int offset = 0;
+        if (sscanf(line, "%" SCNu64 " %" SCNd64 " %n", &entry.size, &entry.mtime_ns, &offset) != 2 || offset == 0) continue;
+        std::string source = line + offset;
+        if (!source.empty() && source.back() == '\n') source.pop_back();
+
+        // files that were fixed or removed while we were not running
+        if (source.empty() || !stat_entry(source, now) || now.size != entry.size || now.mtime_ns != entry.mtime_ns) {
+            changed = true;
+            continue;
+        }
+        entries[source] = entry;
+    }
+    fclose(f);
+    if (changed) save();
+
+    if (!entries.empty()) printf("Quarantine %s: skipping %zu files until they change\n", file.c_str(), entries.size());
+}
+
+
+bool Quarantine::stat_entry(const std::string &path, Entry &entry) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    entry.size = st.st_size;
+    entry.mtime_ns = to_ns(st.st_mtim);
+    return true;
+}
+
+
+bool Quarantine::contains(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) return false;
+
+    Entry now;
+    if (stat_entry(path, now) && now.size == it->second.size && now.mtime_ns == it->second.mtime_ns) return true;
+
+    printf("%s changed, trying it again\n", path.c_str());
+    entries.erase(it);
+    save();
+    return false;
+}
+
+
+void Quarantine::add(const std::string &path) {
+    Entry entry;
+    if (!stat_entry(path, entry)) return; // gone, nothing to skip
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[path] = entry;
+    save();
+    printf("Quarantined %s, it is skipped until it changes\n", path.c_str());
+}
+
+
+size_t Quarantine::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+
+// The whole list every time, it only holds a few broken files. Through a temporary file so a crash never leaves half of it.
+void Quarantine::save() {
+    if (file.empty()) return;
+
+    const int64_t before = catalog.before_own_write();
+    const std::string tmp_path = file + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        printf("Cannot write %s, the quarantine is not kept across restarts\n", tmp_path.c_str());
+        return;
+    }
+    bool written = true;
+    for (const auto &e : entries)
+        written = fprintf(f, "%" PRIu64 " %" PRId64 " %s\n", e.second.size, e.second.mtime_ns, e.first.c_str()) > 0 && written;
+    written = fclose(f) == 0 && written;
+    if (!written || rename(tmp_path.c_str(), file.c_str()) != 0) unlink(tmp_path.c_str());
+    catalog.after_own_write(before);
+}
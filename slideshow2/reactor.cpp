@@ -0,0 +1,73 @@
+#include "reactor.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+
+#define MAX_EVENTS 16
+
+
+Reactor::Reactor() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0) {
+        printf("Cannot set up epoll: %s\n", strerror(errno));
+        return;
+    }
+    add(timer_fd, [this] {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {} // only here to end the wait
+    });
+}
+
+
+Reactor::~Reactor() {
+    if (timer_fd >= 0) close(timer_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+
+bool Reactor::add(int fd, std::function<void()> handler) {
+    if (epoll_fd < 0 || fd < 0) return false;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+    handlers[fd] = std::move(handler);
+    return true;
+}
+
+
+void Reactor::remove(int fd) {
+    if (handlers.erase(fd)) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+
+void Reactor::set_timer(int timeout_ms) {
+    itimerspec spec = {}; // all zero disarms
+    if (timeout_ms >= 0) {
+        spec.it_value.tv_sec = timeout_ms / 1000;
+        spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L + 1; // 0 would disarm it
+    }
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+
+int Reactor::wait() {
+    epoll_event events[MAX_EVENTS];
+    const int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1); // EINTR: a signal, the caller checks for it
+    int handled = 0;
+    for (int i = 0; i < count; i++) {
+        auto it = handlers.find(events[i].data.fd);
+        if (it == handlers.end()) continue; // removed by an earlier handler
+        const std::function<void()> handler = it->second; // a copy, the handler may remove itself
+        handler();
+        handled++;
+    }
+    return handled;
+}
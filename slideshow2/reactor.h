@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+
+
+// One epoll set for everything the main loop waits on: input devices, the DRM fd, the loader's eventfd, and a
+// timerfd for the next state change. Handlers run on the thread that calls wait(), one at a time.
+// Not thread safe, other threads wake it through an fd (see ImageLoader::get_event_fd).
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // handler runs whenever fd is readable, it must read it or it runs again right away
+    bool add(int fd, std::function<void()> handler);
+    // may be called from a handler, also for its own fd
+    void remove(int fd);
+
+    // wait() returns timeout_ms from now at the latest. < 0 disarms the timer. 
+    void set_timer(int timeout_ms);
+
+    // Blocks until at least one fd is ready (or a signal arrives) and runs the handlers of the ready ones.
+    // Returns the number of handlers that ran.
+    int wait();
+
+private:
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    std::unordered_map<int, std::function<void()>> handlers; // by fd
+};
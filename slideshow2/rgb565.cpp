@@ -0,0 +1,106 @@
+#include "rgb565.h"
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define RGB565_NEON
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+    #define RGB565_SSE2
+#endif
+
+
+// 4x4 Bayer matrix, 0..15
+static const unsigned char BAYER[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+
+// Thresholds below one step of the target precision: 0..7 for the 5 bit channels, 0..3 for green.
+// Added with saturation, then the low bits are dropped.
+static inline uint16_t pack_pixel(int r, int g, int b, int threshold) {
+    const int t5 = threshold >> 1, t6 = threshold >> 2;
+    r = std::min(255, r + t5);
+    g = std::min(255, g + t6);
+    b = std::min(255, b + t5);
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+
+Rgb565Converter::Rgb565Converter(int sw, int sh, int sbpp, int dw, int dh) :
+    src_w(sw), src_h(sh), src_bpp(sbpp), dst_w(dw), dst_h(dh),
+    src_offset(dw), red(dw), green(dw), blue(dw)
+{
+    for (int x = 0; x < dst_w; x++) src_offset[x] = (int)(((int64_t)x * 2 + 1) * src_w / (2 * (int64_t)dst_w)) * src_bpp;
+}
+
+
+void Rgb565Converter::convert_row(const unsigned char *src, int dst_row, uint16_t *dst) {
+    // gather and deinterleave, the only part that depends on the source layout
+    for (int x = 0; x < dst_w; x++) {
+        const unsigned char *p = src + src_offset[x];
+        red[x] = p[0];
+        green[x] = p[1];
+        blue[x] = p[2];
+    }
+
+    const unsigned char *thresholds = BAYER[dst_row & 3];
+    int x = 0;
+
+#if defined(RGB565_NEON)
+    uint8_t t5[16], t6[16];
+    for (int i = 0; i < 16; i++) { t5[i] = thresholds[i & 3] >> 1; t6[i] = thresholds[i & 3] >> 2; }
+    const uint8x16_t d5 = vld1q_u8(t5), d6 = vld1q_u8(t6);
+    for (; x + 16 <= dst_w; x += 16) {
+        const uint8x16_t r = vqaddq_u8(vld1q_u8(&red[x]), d5);
+        const uint8x16_t g = vqaddq_u8(vld1q_u8(&green[x]), d6);
+        const uint8x16_t b = vqaddq_u8(vld1q_u8(&blue[x]), d5);
+        // top bits of each channel shifted into place: rrrrrggg gggbbbbb
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(r), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(g), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 11);
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(r), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(g), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 11);
+        vst1q_u16(dst + x, lo);
+        vst1q_u16(dst + x + 8, hi);
+    }
+#elif defined(RGB565_SSE2)
+    const __m128i d5 = _mm_setr_epi8(thresholds[0] >> 1, thresholds[1] >> 1, thresholds[2] >> 1, thresholds[3] >> 1,
+                                     thresholds[0] >> 1, thresholds[1] >> 1, thresholds[2] >> 1, thresholds[3] >> 1,
+                                     thresholds[0] >> 1, thresholds[1] >> 1, thresholds[2] >> 1, thresholds[3] >> 1,
+                                     thresholds[0] >> 1, thresholds[1] >> 1, thresholds[2] >> 1, thresholds[3] >> 1);
+    const __m128i d6 = _mm_setr_epi8(thresholds[0] >> 2, thresholds[1] >> 2, thresholds[2] >> 2, thresholds[3] >> 2,
+                                     thresholds[0] >> 2, thresholds[1] >> 2, thresholds[2] >> 2, thresholds[3] >> 2,
+                                     thresholds[0] >> 2, thresholds[1] >> 2, thresholds[2] >> 2, thresholds[3] >> 2,
+                                     thresholds[0] >> 2, thresholds[1] >> 2, thresholds[2] >> 2, thresholds[3] >> 2);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_r = _mm_set1_epi16((short)0xF800), mask_g = _mm_set1_epi16(0x07E0);
+    for (; x + 16 <= dst_w; x += 16) {
+        const __m128i r = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)&red[x]), d5);
+        const __m128i g = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)&green[x]), d6);
+        const __m128i b = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)&blue[x]), d5);
+        // per 16 bit lane: (r << 8) & 0xF800 | (g << 3) & 0x07E0 | b >> 3
+        __m128i lo = _mm_and_si128(_mm_slli_epi16(_mm_unpacklo_epi8(r, zero), 8), mask_r);
+        lo = _mm_or_si128(lo, _mm_and_si128(_mm_slli_epi16(_mm_unpacklo_epi8(g, zero), 3), mask_g));
+        lo = _mm_or_si128(lo, _mm_srli_epi16(_mm_unpacklo_epi8(b, zero), 3));
+        __m128i hi = _mm_and_si128(_mm_slli_epi16(_mm_unpackhi_epi8(r, zero), 8), mask_r);
+        hi = _mm_or_si128(hi, _mm_and_si128(_mm_slli_epi16(_mm_unpackhi_epi8(g, zero), 3), mask_g));
+        hi = _mm_or_si128(hi, _mm_srli_epi16(_mm_unpackhi_epi8(b, zero), 3));
+        _mm_storeu_si128((__m128i*)(dst + x), lo);
+        _mm_storeu_si128((__m128i*)(dst + x + 8), hi);
+    }
+#endif
+
+    for (; x < dst_w; x++) dst[x] = pack_pixel(red[x], green[x], blue[x], thresholds[x & 3]);
+}
+
+
+void Rgb565Converter::convert(const unsigned char *src, uint16_t *dst) {
+    const size_t src_pitch = (size_t)src_w * src_bpp;
+    for (int y = 0; y < dst_h; y++) convert_row(src + src_row(y) * src_pitch, y, dst + (size_t)y * dst_w);
+}